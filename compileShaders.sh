@@ -1,7 +1,7 @@
-#!/bin/sh
+#!/bin/bash
 
-# loop through vert and frag file
-for i in shaders/*.{vert,frag}; do
+# loop through vert, frag and comp files
+for i in shaders/*.{vert,frag,comp}; do
   echo "Processing: " "$i" "${i}.spv";
   glslc "$i" -o "${i}.spv";
-done
\ No newline at end of file
+done
@@ -0,0 +1,33 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUv;
+layout(location = 2) flat in uint fragMaterialIndex;
+
+layout(location = 0) out vec4 outColor;
+
+// Must match MasterRenderSystem::MaterialData
+struct MaterialData {
+    vec4 baseColor;
+    uint textureIndex;
+};
+
+const uint NO_TEXTURE = 0xFFFFFFFF;
+const uint MATERIAL_BUFFER = 0; // the material buffer is always the first storage buffer
+
+// Bindless arrays, see MasterRenderSystem. Only the descriptors that were added are valid (partially bound).
+layout(set = 0, binding = 2) uniform sampler2D textures[];
+layout(std430, set = 0, binding = 3) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+} storageBuffers[];
+
+void main() {
+    MaterialData material = storageBuffers[MATERIAL_BUFFER].materials[fragMaterialIndex];
+    vec4 color = material.baseColor;
+    if (material.textureIndex != NO_TEXTURE) {
+        // The index is flat per object, but a draw doesn't have to be a single object.
+        color *= texture(textures[nonuniformEXT(material.textureIndex)], fragUv);
+    }
+    outColor = vec4(fragColor * color.rgb, 1.0);
+}
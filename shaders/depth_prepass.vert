@@ -0,0 +1,58 @@
+#version 450
+
+// Depth pre-pass, only the position stream is bound (see CvkModel::bindPositions) and there is no fragment shader.
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionViewMatrix;
+    vec3 directionToLight;
+} ubo;
+
+// Layers that are turning right now, see CvkLayerAnimation.hpp
+struct LayerData {
+    vec4 rotation; // quaternion
+    vec4 pivot;
+};
+layout(set = 0, binding = 1) uniform LayerUbo {
+    LayerData layers[32];
+    uint activeLayers;
+} layerUbo;
+
+// Must match ObjectData in CvkObjectBuffer.hpp
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 color;
+    uint flags;
+    uint meshIndex;
+    uint layerMask;
+    uint materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// The main pass tests depth with EQUAL, so both shaders have to produce bit-identical positions.
+// Same expression as simple_shader.vert + invariant on both sides guarantees that.
+invariant gl_Position;
+
+// Specialization constant, set per pipeline variant (see CvkPipelineVariants). Without it the layer loop is compiled
+// out, for scenes that never turn layers. Both vertex shaders of the depth pre-pass have to agree on it.
+layout(constant_id = 0) const bool ANIMATE_LAYERS = true;
+
+vec3 rotateByQuaternion(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    vec3 positionWorldSpace = (object.modelMatrix * vec4(position, 1.0)).xyz;
+    uint turning = ANIMATE_LAYERS ? object.layerMask & layerUbo.activeLayers : 0u;
+    while (turning != 0) {
+        LayerData layer = layerUbo.layers[findLSB(turning)];
+        positionWorldSpace = layer.pivot.xyz + rotateByQuaternion(layer.rotation, positionWorldSpace - layer.pivot.xyz);
+        turning &= turning - 1;
+    }
+    gl_Position = ubo.projectionViewMatrix * vec4(positionWorldSpace, 1.0);
+}
@@ -0,0 +1,71 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 color;
+layout(location = 2) in vec3 normal;
+layout(location = 3) in vec2 uv;
+
+layout(location = 0) out vec3 fragColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+    mat4 projectionViewMatrix;
+    vec3 directionToLight;
+} ubo;
+
+// Layers that are turning right now, see CvkLayerAnimation.hpp
+struct LayerData {
+    vec4 rotation; // quaternion
+    vec4 pivot;
+};
+layout(set = 0, binding = 1) uniform LayerUbo {
+    LayerData layers[32];
+    uint activeLayers;
+} layerUbo;
+
+// Per object data, written by the CPU once per frame. Must match ObjectData in CvkObjectBuffer.hpp
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    vec4 color;
+    uint flags;
+    uint meshIndex;
+    uint layerMask;
+    uint materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// Object indices grouped by mesh, filled by the CPU or by cull.comp when GPU culling is on.
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer {
+    uint objectIndices[];
+} instanceBuffer;
+
+const float AMBIENT = 0.02;
+const uint OBJECT_FLAG_USE_OBJECT_COLOR = 1;
+
+vec3 rotateByQuaternion(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    // gl_InstanceIndex already includes firstInstance, which the indirect command points at this mesh's slice.
+    ObjectData object = objectBuffer.objects[instanceBuffer.objectIndices[gl_InstanceIndex]];
+    vec3 positionWorldSpace = (object.modelMatrix * vec4(position, 1.0)).xyz;
+    vec3 normalWorldSpace = mat3(object.normalMatrix) * normal;
+    uint turning = object.layerMask & layerUbo.activeLayers;
+    while (turning != 0) {
+        LayerData layer = layerUbo.layers[findLSB(turning)];
+        positionWorldSpace = layer.pivot.xyz + rotateByQuaternion(layer.rotation, positionWorldSpace - layer.pivot.xyz);
+        normalWorldSpace = rotateByQuaternion(layer.rotation, normalWorldSpace);
+        turning &= turning - 1;
+    }
+    gl_Position = ubo.projectionViewMatrix * vec4(positionWorldSpace, 1.0);
+
+    normalWorldSpace = normalize(normalWorldSpace);
+
+    float lightIntensity = AMBIENT + max(dot(normalWorldSpace, ubo.directionToLight), 0);
+    vec3 baseColor = (object.flags & OBJECT_FLAG_USE_OBJECT_COLOR) != 0 ? object.color.rgb : color;
+    fragColor = lightIntensity * baseColor;
+}
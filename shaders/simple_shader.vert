@@ -9,27 +9,76 @@ layout(location = 3) in vec2 uv;
 // Output variable is built-in, but we can create more as required.
 // No association between Input and output locations, so location = 0 is different for 'in' and 'out'.
 layout(location = 0) out vec3 fragColor;
+// Only read by bindless_shader.frag, simple_shader.frag ignores them.
+layout(location = 1) out vec2 fragUv;
+layout(location = 2) flat out uint fragMaterialIndex;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
     mat4 projectionViewMatrix;
     vec3 directionToLight;
 } ubo;
 
-// Push constants expected. Must match the order from the main file.
-// Only one push constant block per shader entry, and max size is 128 Bytes.
-layout(push_constant) uniform Push {
+// Layers that are turning right now, see CvkLayerAnimation.hpp
+struct LayerData {
+    vec4 rotation; // quaternion
+    vec4 pivot;
+};
+layout(set = 0, binding = 1) uniform LayerUbo {
+    LayerData layers[32];
+    uint activeLayers;
+} layerUbo;
+
+// Per object data, used to be push constants but those max out at 128 Bytes.
+// Must match ObjectData in CvkObjectBuffer.hpp
+struct ObjectData {
     mat4 modelMatrix;
     mat4 normalMatrix;
-} push;
+    vec4 color;
+    uint flags;
+    uint meshIndex;
+    uint layerMask;
+    uint materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// Has to match depth_prepass.vert exactly, the main pass compares depth with EQUAL after a pre-pass.
+invariant gl_Position;
 
 const float AMBIENT = 0.02; 
+const uint OBJECT_FLAG_USE_OBJECT_COLOR = 1;
+
+// Specialization constant, set per pipeline variant (see CvkPipelineVariants). Without it the layer loop is compiled
+// out, for scenes that never turn layers. Both vertex shaders of the depth pre-pass have to agree on it.
+layout(constant_id = 0) const bool ANIMATE_LAYERS = true;
+
+vec3 rotateByQuaternion(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
 
 // Main function executes once for each vertex we have.
 void main() {
-    gl_Position = ubo.projectionViewMatrix * push.modelMatrix * vec4(position, 1.0);
+    // The draw passes the object's slot as firstInstance, which ends up in gl_InstanceIndex.
+    ObjectData object = objectBuffer.objects[gl_InstanceIndex];
+    vec3 positionWorldSpace = (object.modelMatrix * vec4(position, 1.0)).xyz;
+    vec3 normalWorldSpace = mat3(object.normalMatrix) * normal;
+    // Turning layers the object belongs to, usually none or one.
+    uint turning = ANIMATE_LAYERS ? object.layerMask & layerUbo.activeLayers : 0u;
+    while (turning != 0) {
+        LayerData layer = layerUbo.layers[findLSB(turning)];
+        positionWorldSpace = layer.pivot.xyz + rotateByQuaternion(layer.rotation, positionWorldSpace - layer.pivot.xyz);
+        normalWorldSpace = rotateByQuaternion(layer.rotation, normalWorldSpace);
+        turning &= turning - 1;
+    }
+    gl_Position = ubo.projectionViewMatrix * vec4(positionWorldSpace, 1.0);
 
-    vec3 normalWorldSpace = normalize(mat3(push.normalMatrix) * normal);
+    normalWorldSpace = normalize(normalWorldSpace);
 
     float lightIntensity = AMBIENT + max(dot(normalWorldSpace, ubo.directionToLight), 0);
-    fragColor = lightIntensity * color;
+    vec3 baseColor = (object.flags & OBJECT_FLAG_USE_OBJECT_COLOR) != 0 ? object.color.rgb : color;
+    fragColor = lightIntensity * baseColor;
+    fragUv = uv;
+    fragMaterialIndex = object.materialIndex;
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 450
+
+// Stretches the rendered part of the scene target (see CvkSceneTarget) over the whole swapchain image.
+layout(location = 0) in vec2 fragUv;
+layout(location = 0) out vec4 outColor;
+
+// set 0 is the global set every pipeline layout starts with (see MasterRenderSystem), unused here
+layout(set = 1, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform Push {
+    vec2 uvScale; // render extent / image extent
+    vec2 uvMax;   // last texel center of the rendered part, keeps the linear filter off the stale texels past it
+} push;
+
+void main() {
+    outColor = texture(sceneColor, min(fragUv * push.uvScale, push.uvMax));
+}
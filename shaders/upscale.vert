@@ -0,0 +1,9 @@
+#version 450
+
+// One triangle that covers the whole screen, no vertex buffer needed (draw 3 vertices).
+layout(location = 0) out vec2 fragUv;
+
+void main() {
+    fragUv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(fragUv * 2.0 - 1.0, 0.0, 1.0);
+}
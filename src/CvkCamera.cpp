@@ -77,4 +77,24 @@ void CvkCamera::setViewYXZ(glm::vec3 position, glm::vec3 rotation) {
     viewMatrix[3][2] = -glm::dot(w, position);
 }
 
+// Gribb-Hartmann extraction from the rows of projection * view.
+// Depth is 0 to 1 (GLM_FORCE_DEPTH_ZERO_TO_ONE), so the near plane is just the third row.
+std::array<glm::vec4, 6> CvkCamera::getFrustumPlanes() const {
+    const glm::mat4 m = projectionMatrix * viewMatrix;
+    auto row = [&m](int i) { return glm::vec4{m[0][i], m[1][i], m[2][i], m[3][i]}; };
+
+    std::array<glm::vec4, 6> planes{
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(2),
+        row(3) - row(2),
+    };
+    for (auto &plane : planes) {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+    return planes;
+}
+
 } // namespace cvk
\ No newline at end of file
@@ -5,6 +5,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
+// std
+#include <array>
+
 namespace cvk {
     class CvkCamera {
     public :
@@ -16,6 +19,10 @@ namespace cvk {
 
         const glm::mat4& getProjection() const { return projectionMatrix; }
         const glm::mat4& getView() const { return viewMatrix; }
+
+        // World space planes (xyz = inward normal, w = distance) in the order left, right, bottom, top, near, far.
+        // A point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+        std::array<glm::vec4, 6> getFrustumPlanes() const;
     private:
         glm::mat4 projectionMatrix{1.f};
         glm::mat4 viewMatrix{1.f};
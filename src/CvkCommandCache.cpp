@@ -0,0 +1,79 @@
+#include "CvkCommandCache.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <stdexcept>
+
+namespace cvk {
+
+CvkCommandCache::CvkCommandCache(CvkDevice &device) : cvkDevice{device} {
+    QueueFamilyIndices queueFamilyIndices = cvkDevice.findPhysicalQueueFamilies();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    poolInfo.flags = 0; // reset as a whole, and not transient since the buffers live for many frames
+
+    frames.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    for (auto &frame : frames) {
+        if (vkCreateCommandPool(cvkDevice.device(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create cached command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(cvkDevice.device(), &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cached command buffer!");
+        }
+    }
+}
+
+CvkCommandCache::~CvkCommandCache() {
+    for (auto &frame : frames) {
+        vkDestroyCommandPool(cvkDevice.device(), frame.commandPool, nullptr);
+    }
+}
+
+void CvkCommandCache::invalidate() {
+    for (auto &frame : frames) {
+        frame.valid = false;
+    }
+}
+
+// Re-recording is safe here, beginFrame already waited on this frame's fence so the old commands are done.
+VkCommandBuffer CvkCommandCache::get(
+int frameIndex,
+uint64_t revision,
+const VkCommandBufferInheritanceInfo &inheritanceInfo,
+const RecordFn &recordFn,
+bool *recorded) {
+    CachedFrame &frame = frames[frameIndex];
+    const bool stale = !frame.valid || frame.revision != revision;
+    if (recorded) { *recorded = stale; }
+    if (!stale) { return frame.commandBuffer; }
+
+    vkResetCommandPool(cvkDevice.device(), frame.commandPool, 0);
+
+    // No ONE_TIME_SUBMIT, the whole point is to submit it again. No SIMULTANEOUS_USE either, a frame's
+    // buffer is never pending twice.
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording cached command buffer!");
+    }
+    recordFn(frame.commandBuffer);
+    if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record cached command buffer!");
+    }
+
+    frame.revision = revision;
+    frame.valid = true;
+    return frame.commandBuffer;
+}
+
+} // namespace cvk
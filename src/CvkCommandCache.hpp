@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+
+// std
+#include <functional>
+#include <vector>
+
+namespace cvk {
+
+/*
+Keeps one pre-recorded secondary command buffer per frame in flight and replays it for as long as the
+revision it was recorded at is still current. Callers bump the revision whenever whatever they recorded
+changes (scene, visible set, swapchain), so a static scene costs one vkCmdExecuteCommands per frame.
+
+Cached per frame in flight and not per swapchain image, since the recorded descriptor sets (UBO, objects)
+are per frame in flight. The inheritance info leaves the framebuffer out, so any image can replay them.
+*/
+class CvkCommandCache {
+public:
+    using RecordFn = std::function<void(VkCommandBuffer commandBuffer)>;
+
+    CvkCommandCache(CvkDevice &device);
+    ~CvkCommandCache();
+
+    CvkCommandCache(const CvkCommandCache &) = delete;
+    CvkCommandCache &operator=(const CvkCommandCache &) = delete;
+
+    // Returns this frame's secondary command buffer. It is only re-recorded (through recordFn) when revision
+    // differs from the one it was last recorded at, in which case recorded is set to true.
+    VkCommandBuffer get(
+        int frameIndex,
+        uint64_t revision,
+        const VkCommandBufferInheritanceInfo &inheritanceInfo,
+        const RecordFn &recordFn,
+        bool *recorded = nullptr);
+
+    // Forces a re-record on the next get() of every frame.
+    void invalidate();
+
+private:
+    struct CachedFrame {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t revision = 0;
+        bool valid = false;
+    };
+
+    CvkDevice &cvkDevice;
+    std::vector<CachedFrame> frames;
+};
+
+} // namespace cvk
@@ -0,0 +1,56 @@
+#include "CvkComputePipeline.hpp"
+#include "CvkPipeline.hpp"
+#include "CvkShaderLibrary.hpp"
+
+//std
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace cvk {
+
+CvkComputePipeline::CvkComputePipeline(
+    CvkDevice& device,
+    const std::string& compFilepath,
+    VkPipelineLayout pipelineLayout) : cvkDevice{device} {
+        createComputePipeline(compFilepath, pipelineLayout);
+}
+
+CvkComputePipeline::~CvkComputePipeline() {
+    vkDestroyPipeline(cvkDevice.device(), computePipeline, nullptr);
+}
+
+void CvkComputePipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout) {
+    assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline:: no pipelineLayout provided");
+
+    // Same as CvkPipeline, the module is only held while the pipeline gets created.
+    VkShaderModule compShaderModule = cvkDevice.shaderLibrary().acquire(compFilepath);
+
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStage.module = compShaderModule;
+    shaderStage.pName = "main";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStage;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    auto startTime = std::chrono::steady_clock::now();
+    VkResult result = vkCreateComputePipelines(cvkDevice.device(), cvkDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &computePipeline);
+    cvkDevice.shaderLibrary().release(compShaderModule);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create compute pipeline");
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    cvkDevice.reportPipelineCreation(compFilepath, std::chrono::duration<double, std::milli>(endTime - startTime).count());
+}
+
+void CvkComputePipeline::bind(VkCommandBuffer commandBuffer) {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+}
+
+} // namespace cvk
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+
+#include <string>
+#include <vector>
+
+namespace cvk {
+
+// Compute counterpart of CvkPipeline, a single shader stage and no fixed function state.
+class CvkComputePipeline {
+public:
+    CvkComputePipeline(
+        CvkDevice& device,
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout);
+
+    ~CvkComputePipeline();
+    CvkComputePipeline(const CvkComputePipeline&) = delete;
+    CvkComputePipeline &operator=(const CvkComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer commandBuffer);
+private:
+    void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+
+    CvkDevice& cvkDevice;
+    VkPipeline computePipeline;
+};
+
+} // namespace cvk
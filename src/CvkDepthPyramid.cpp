@@ -0,0 +1,251 @@
+#include "CvkDepthPyramid.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+static constexpr uint32_t REDUCE_WORKGROUP_SIZE = 8; // local_size_x/y in shaders/hiz_reduce.comp
+
+CvkDepthPyramid::CvkDepthPyramid(CvkDevice &device) : cvkDevice{device} {
+    createSampler();
+    createDescriptors();
+    createReducePipeline();
+    createImage({2, 2});
+}
+
+CvkDepthPyramid::~CvkDepthPyramid() {
+    destroyImage();
+    vkDestroyPipelineLayout(cvkDevice.device(), reducePipelineLayout, nullptr);
+    vkDestroySampler(cvkDevice.device(), sampler, nullptr);
+}
+
+// Only ever read with texelFetch, so nearest and clamping just keep the sampler as cheap as possible.
+void CvkDepthPyramid::createSampler() {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+    if (vkCreateSampler(cvkDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+}
+
+// Every set is allocated once up front and only overwritten later, a resize just points them at the new views.
+void CvkDepthPyramid::createDescriptors() {
+    const uint32_t setCount = CvkSwapchain::MAX_FRAMES_IN_FLIGHT + MAX_LEVELS + 1;
+    descriptorPool = CvkDescriptorPool::Builder(cvkDevice)
+        .setMaxSets(setCount)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setCount)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount)
+        .build();
+    reduceSetLayout = CvkDescriptorSetLayout::Builder(cvkDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+    readSetLayout = CvkDescriptorSetLayout::Builder(cvkDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+        .build();
+
+    depthSourceSets.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    levelSets.resize(MAX_LEVELS);
+    bool allocated = descriptorPool->allocateDescriptorSet(readSetLayout->getDescriptorSetLayout(), readSet);
+    for (auto &set : depthSourceSets) {
+        allocated = allocated && descriptorPool->allocateDescriptorSet(reduceSetLayout->getDescriptorSetLayout(), set);
+    }
+    for (uint32_t level = 1; level < MAX_LEVELS; level++) {
+        allocated = allocated && descriptorPool->allocateDescriptorSet(reduceSetLayout->getDescriptorSetLayout(), levelSets[level]);
+    }
+    if (!allocated) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+    }
+}
+
+void CvkDepthPyramid::createReducePipeline() {
+    VkDescriptorSetLayout setLayout = reduceSetLayout->getDescriptorSetLayout();
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    if (vkCreatePipelineLayout(cvkDevice.device(), &pipelineLayoutInfo, nullptr, &reducePipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create depth pyramid Pipeline Layout!");
+    }
+    reducePipeline = std::make_unique<CvkComputePipeline>(cvkDevice, "shaders/hiz_reduce.comp", reducePipelineLayout);
+}
+
+void CvkDepthPyramid::createImage(VkExtent2D depthExtent) {
+    sourceExtent = depthExtent;
+    extent = {std::max(1u, (depthExtent.width + 1) / 2), std::max(1u, (depthExtent.height + 1) / 2)};
+    levelCount = 1;
+    while (levelCount < MAX_LEVELS && (std::max(extent.width, extent.height) >> levelCount) > 0) { levelCount++; }
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = extent.width;
+    imageInfo.extent.height = extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = levelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+    cvkDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(cvkDevice.device(), &viewInfo, nullptr, &fullView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid image view!");
+    }
+    levelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        if (vkCreateImageView(cvkDevice.device(), &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid level view!");
+        }
+    }
+
+    // GENERAL for good, cleared to the far plane so the placeholder never claims to occlude anything.
+    VkCommandBuffer commandBuffer = cvkDevice.beginSingleTimeCommands();
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+    VkClearColorValue farPlane{};
+    farPlane.float32[0] = 1.f;
+    vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &barrier.subresourceRange);
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+    cvkDevice.endSingleTimeCommands(commandBuffer);
+
+    VkDescriptorImageInfo readInfo{sampler, fullView, VK_IMAGE_LAYOUT_GENERAL};
+    CvkDescriptorWriter(*readSetLayout, *descriptorPool)
+        .writeImage(0, &readInfo)
+        .overwrite(readSet);
+    for (uint32_t level = 1; level < levelCount; level++) {
+        VkDescriptorImageInfo sourceInfo{sampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+        CvkDescriptorWriter(*reduceSetLayout, *descriptorPool)
+            .writeImage(0, &sourceInfo)
+            .writeImage(1, &destinationInfo)
+            .overwrite(levelSets[level]);
+    }
+    built = false;
+}
+
+void CvkDepthPyramid::destroyImage() {
+    for (auto view : levelViews) {
+        vkDestroyImageView(cvkDevice.device(), view, nullptr);
+    }
+    levelViews.clear();
+    vkDestroyImageView(cvkDevice.device(), fullView, nullptr);
+    vkDestroyImage(cvkDevice.device(), image, nullptr);
+    vkFreeMemory(cvkDevice.device(), imageMemory, nullptr);
+}
+
+void CvkDepthPyramid::resize(VkExtent2D depthExtent) {
+    if (depthExtent.width == sourceExtent.width && depthExtent.height == sourceExtent.height) { return; }
+    // The other frame in flight may still sample the old image.
+    vkDeviceWaitIdle(cvkDevice.device());
+    destroyImage();
+    createImage(depthExtent);
+}
+
+void CvkDepthPyramid::build(VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView) {
+    // This frame's set was last used by the submission that beginFrame already waited on.
+    VkDescriptorImageInfo depthInfo{sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+    VkDescriptorImageInfo destinationInfo{VK_NULL_HANDLE, levelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+    CvkDescriptorWriter(*reduceSetLayout, *descriptorPool)
+        .writeImage(0, &depthInfo)
+        .writeImage(1, &destinationInfo)
+        .overwrite(depthSourceSets[frameIndex]);
+
+    // Earlier dispatches (culling) may still be reading the previous pyramid.
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    reducePipeline->bind(commandBuffer);
+    VkImageMemoryBarrier levelBarrier{};
+    levelBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    levelBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    levelBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    levelBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    levelBarrier.image = image;
+    levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    for (uint32_t level = 0; level < levelCount; level++) {
+        VkDescriptorSet set = level == 0 ? depthSourceSets[frameIndex] : levelSets[level];
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            reducePipelineLayout,
+            0,
+            1,
+            &set,
+            0,
+            nullptr);
+        const uint32_t width = std::max(1u, extent.width >> level);
+        const uint32_t height = std::max(1u, extent.height >> level);
+        vkCmdDispatch(
+            commandBuffer,
+            (width + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE,
+            (height + REDUCE_WORKGROUP_SIZE - 1) / REDUCE_WORKGROUP_SIZE,
+            1);
+
+        // The next level (or the culling after the last one) reads what was just written.
+        levelBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1};
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+    }
+    built = true;
+}
+
+} // namespace cvk
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CvkComputePipeline.hpp"
+#include "CvkDescriptors.hpp"
+#include "CvkDevice.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace cvk {
+
+/*
+Hierarchical-Z pyramid for occlusion culling. Level 0 is half the depth buffer's resolution and every texel of
+every level holds the farthest depth of the area it covers, so a single texel fetch tells if anything in that
+area could be in front of an object. Built by hiz_reduce.comp, one dispatch per level.
+
+The image stays in GENERAL layout, levels are written as storage images and read back through a sampler.
+Until the first resize() it is a 1x1 placeholder, so its descriptor set is always valid to bind.
+*/
+class CvkDepthPyramid {
+public:
+    static constexpr uint32_t MAX_LEVELS = 16;
+
+    CvkDepthPyramid(CvkDevice &device);
+    ~CvkDepthPyramid();
+
+    CvkDepthPyramid(const CvkDepthPyramid &) = delete;
+    CvkDepthPyramid &operator=(const CvkDepthPyramid &) = delete;
+
+    // Reallocates the pyramid for a new depth buffer size, waits for the device when it does. Has to be called
+    // before anything that binds getDescriptorSet() is recorded into the current frame.
+    void resize(VkExtent2D depthExtent);
+    // depthView must be in DEPTH_STENCIL_READ_ONLY_OPTIMAL layout with its writes already made visible to compute.
+    // Ends with a barrier that makes the pyramid readable by later compute dispatches.
+    void build(VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView);
+
+    // False until the first build after creation or a resize.
+    bool isValid() const { return built; }
+    // A single combined image sampler at binding 0, covering every level. Sample it with texelFetch.
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return readSetLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getDescriptorSet() const { return readSet; }
+
+private:
+    void createSampler();
+    void createDescriptors();
+    void createReducePipeline();
+    void createImage(VkExtent2D depthExtent);
+    void destroyImage();
+
+    CvkDevice &cvkDevice;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView fullView = VK_NULL_HANDLE;
+    std::vector<VkImageView> levelViews;
+    VkExtent2D sourceExtent{0, 0};
+    VkExtent2D extent{0, 0};
+    uint32_t levelCount = 0;
+    bool built = false;
+
+    std::unique_ptr<CvkDescriptorPool> descriptorPool;
+    std::unique_ptr<CvkDescriptorSetLayout> reduceSetLayout;
+    std::unique_ptr<CvkDescriptorSetLayout> readSetLayout;
+    std::vector<VkDescriptorSet> depthSourceSets; // per frame in flight, level 0 reads that frame's depth buffer
+    std::vector<VkDescriptorSet> levelSets;       // level i reads level i - 1, index 0 unused
+    VkDescriptorSet readSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout reducePipelineLayout = VK_NULL_HANDLE;
+    std::unique_ptr<CvkComputePipeline> reducePipeline;
+};
+
+} // namespace cvk
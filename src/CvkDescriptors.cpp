@@ -13,7 +13,8 @@ CvkDescriptorSetLayout::Builder &CvkDescriptorSetLayout::Builder::addBinding(
 uint32_t binding,
 VkDescriptorType descriptorType,
 VkShaderStageFlags stageFlags,
-uint32_t count) {
+uint32_t count,
+VkDescriptorBindingFlagsEXT flags) {
     assert(bindings.count(binding) == 0 && "Binding already in use");
     VkDescriptorSetLayoutBinding layoutBinding{};
     layoutBinding.binding = binding;
@@ -21,21 +22,27 @@ uint32_t count) {
     layoutBinding.descriptorCount = count;
     layoutBinding.stageFlags = stageFlags;
     bindings[binding] = layoutBinding;
+    if (flags != 0) { bindingFlags[binding] = flags; }
     return *this;
 }
 
 std::unique_ptr<CvkDescriptorSetLayout> CvkDescriptorSetLayout::Builder::build() const {
-    return std::make_unique<CvkDescriptorSetLayout>(cvkDevice, bindings);
+    return std::make_unique<CvkDescriptorSetLayout>(cvkDevice, bindings, bindingFlags);
 }
 
 // *************** Descriptor Set Layout *********************
 
 CvkDescriptorSetLayout::CvkDescriptorSetLayout(
-CvkDevice &cvkDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+CvkDevice &cvkDevice,
+std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> &bindingFlags)
 : cvkDevice{cvkDevice}, bindings{bindings} {
     std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+    std::vector<VkDescriptorBindingFlagsEXT> setLayoutBindingFlags{}; // same order as setLayoutBindings
     for (auto kv : bindings) {
         setLayoutBindings.push_back(kv.second);
+        auto flags = bindingFlags.find(kv.first);
+        setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
     }
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -43,6 +50,20 @@ CvkDevice &cvkDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>
     descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
     descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+    // Only chained when needed, so layouts without flags don't depend on VK_EXT_descriptor_indexing.
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo{};
+    if (!bindingFlags.empty()) {
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+        bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+        descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        for (auto flags : setLayoutBindingFlags) {
+            if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT) {
+                descriptorSetLayoutInfo.flags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+            }
+        }
+    }
+
     if (vkCreateDescriptorSetLayout(
         cvkDevice.device(),
         &descriptorSetLayoutInfo,
@@ -137,18 +158,18 @@ CvkDescriptorWriter::CvkDescriptorWriter(CvkDescriptorSetLayout &setLayout, CvkD
 : setLayout{setLayout}, pool{pool} {}
 
 CvkDescriptorWriter &CvkDescriptorWriter::writeBuffer(
-uint32_t binding, VkDescriptorBufferInfo *bufferInfo) {
+uint32_t binding, VkDescriptorBufferInfo *bufferInfo, uint32_t arrayElement) {
     assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
 
     auto &bindingDescription = setLayout.bindings[binding];
 
-    // TODO : Expand this to handle Descriptor Arrays
-    assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+    assert(arrayElement < bindingDescription.descriptorCount && "Array element out of the binding's range");
 
     VkWriteDescriptorSet write{};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write.descriptorType = bindingDescription.descriptorType;
     write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
     write.pBufferInfo = bufferInfo;
     write.descriptorCount = 1;
 
@@ -157,17 +178,18 @@ uint32_t binding, VkDescriptorBufferInfo *bufferInfo) {
 }
 
 CvkDescriptorWriter &CvkDescriptorWriter::writeImage(
-uint32_t binding, VkDescriptorImageInfo *imageInfo) {
+uint32_t binding, VkDescriptorImageInfo *imageInfo, uint32_t arrayElement) {
     assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
 
     auto &bindingDescription = setLayout.bindings[binding];
 
-    assert(bindingDescription.descriptorCount == 1 && "Binding single descriptor info, but binding expects multiple");
+    assert(arrayElement < bindingDescription.descriptorCount && "Array element out of the binding's range");
 
     VkWriteDescriptorSet write{};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write.descriptorType = bindingDescription.descriptorType;
     write.dstBinding = binding;
+    write.dstArrayElement = arrayElement;
     write.pImageInfo = imageInfo;
     write.descriptorCount = 1;
 
@@ -19,16 +19,22 @@ public:
             uint32_t binding,
             VkDescriptorType descriptorType,
             VkShaderStageFlags stageFlags,
-            uint32_t count = 1); // Each binding can have an array of descriptors (same type)
+            uint32_t count = 1, // Each binding can have an array of descriptors (same type)
+            // VK_EXT_descriptor_indexing flags, e.g. for bindless arrays. Any UPDATE_AFTER_BIND binding makes the
+            // whole layout one for pools created with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT.
+            VkDescriptorBindingFlagsEXT bindingFlags = 0);
         std::unique_ptr<CvkDescriptorSetLayout> build() const;
 
     private:
         CvkDevice &cvkDevice;
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+        std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> bindingFlags{};
     };
 
     CvkDescriptorSetLayout(
-        CvkDevice &cvkDevice, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+        CvkDevice &cvkDevice,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlagsEXT> &bindingFlags = {});
     ~CvkDescriptorSetLayout();
     CvkDescriptorSetLayout(const CvkDescriptorSetLayout &) = delete;
     CvkDescriptorSetLayout &operator=(const CvkDescriptorSetLayout &) = delete;
@@ -89,8 +95,10 @@ class CvkDescriptorWriter {
 public:
     CvkDescriptorWriter(CvkDescriptorSetLayout &setLayout, CvkDescriptorPool &pool);
 
-    CvkDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo);
-    CvkDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo);
+    // arrayElement picks one descriptor of an array binding, all of them have to be written unless the
+    // binding is partially bound.
+    CvkDescriptorWriter &writeBuffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo, uint32_t arrayElement = 0);
+    CvkDescriptorWriter &writeImage(uint32_t binding, VkDescriptorImageInfo *imageInfo, uint32_t arrayElement = 0);
 
     bool build(VkDescriptorSet &set);
     void overwrite(VkDescriptorSet &set);
@@ -1,8 +1,12 @@
 #include "CvkDevice.hpp"
+#include "CvkShaderLibrary.hpp"
 
 // std headers
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <set>
 #include <unordered_set>
 
@@ -50,13 +54,20 @@ void DestroyDebugUtilsMessengerEXT(
 CvkDevice::CvkDevice(CvkWindow &window) : window{window} {
   createInstance();       // Initializes Vulkan Library. Connection between Application and Vulkan.
   setupDebugMessenger();  // Set up validation layers for Vulkan related Error checking in debug mode.
-  createSurface();        // Connection between the App Window and Vulkan's ability to display results.
+  if (!window.isHeadless()) {
+    createSurface();      // Connection between the App Window and Vulkan's ability to display results.
+  }
   pickPhysicalDevice();   // Physical device (GPU) that we will be using to run the Application. 
   createLogicalDevice();  // Describes what features of our physical device we want to use.
   createCommandPool();
+  createPipelineCache();
+  shaderLibrary_ = std::make_unique<CvkShaderLibrary>(*this);
 }
 
 CvkDevice::~CvkDevice() {
+  shaderLibrary_.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device_, pipelineCache_, nullptr);
   vkDestroyCommandPool(device_, commandPool, nullptr);
   vkDestroyDevice(device_, nullptr);
 
@@ -64,10 +75,91 @@ CvkDevice::~CvkDevice() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface_, nullptr);
+  if (surface_ != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface_, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
 }
 
+void CvkDevice::createPipelineCache() {
+  // A missing, truncated or foreign file just means starting cold, the driver validates the rest of the data.
+  std::vector<char> initialData;
+  std::ifstream file{PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary};
+  if (file.is_open()) {
+    initialData.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(initialData.data(), initialData.size());
+    if (!file || !isPipelineCacheCompatible(initialData)) {
+      std::cout << "Pipeline cache " << PIPELINE_CACHE_FILE << " doesn't match this device, starting cold\n";
+      initialData.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = initialData.size();
+  cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+  if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache_) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  pipelineCacheWarm_ = !initialData.empty();
+  if (pipelineCacheWarm_) {
+    std::cout << "Loaded pipeline cache (" << initialData.size() << " bytes)\n";
+  }
+}
+
+bool CvkDevice::isPipelineCacheCompatible(const std::vector<char> &data) const {
+  VkPipelineCacheHeaderVersionOne header{};
+  if (data.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+  return header.headerSize >= sizeof(header) && header.headerSize <= data.size() &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+         std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Written next to the file and renamed over it, so a crash halfway through never leaves a torn cache behind.
+// Runs from the destructor, so failures are only logged.
+void CvkDevice::savePipelineCache() {
+  std::cout << "Created " << pipelinesCreated_ << " pipelines in " << pipelineCreationMilliseconds_ << " ms ("
+            << (pipelineCacheWarm_ ? "warm" : "cold") << " pipeline cache)\n";
+
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, nullptr) != VK_SUCCESS || size == 0) {
+    return;
+  }
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device_, pipelineCache_, &size, data.data()) != VK_SUCCESS) {
+    std::cerr << "failed to read back the pipeline cache\n";
+    return;
+  }
+
+  const std::string tempPath = std::string{PIPELINE_CACHE_FILE} + ".tmp";
+  {
+    std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+    file.write(data.data(), size);
+    if (!file) {
+      std::cerr << "failed to write " << tempPath << "\n";
+      return;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, PIPELINE_CACHE_FILE, error);
+  if (error) {
+    std::cerr << "failed to replace " << PIPELINE_CACHE_FILE << ": " << error.message() << "\n";
+    std::filesystem::remove(tempPath, error);
+  }
+}
+
+void CvkDevice::reportPipelineCreation(const std::string &name, double milliseconds) {
+  std::lock_guard<std::mutex> lock{pipelineStatsMutex_};
+  pipelinesCreated_++;
+  pipelineCreationMilliseconds_ += milliseconds;
+  std::cout << "Pipeline " << name << " created in " << milliseconds << " ms\n";
+}
+
 void CvkDevice::createInstance() {
   if (enableValidationLayers && !checkValidationLayerSupport()) {
     throw std::runtime_error("validation layers requested, but not available!");
@@ -104,6 +196,9 @@ void CvkDevice::createInstance() {
   if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
     throw std::runtime_error("failed to create instance!");
   }
+  properties2Enabled_ = std::find_if(extensions.begin(), extensions.end(), [](const char *extension) {
+    return strcmp(extension, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+  }) != extensions.end();
 
   hasGflwRequiredInstanceExtensions();
 }
@@ -149,18 +244,53 @@ void CvkDevice::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  VkPhysicalDeviceFeatures supportedFeatures;
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
   VkPhysicalDeviceFeatures deviceFeatures = {};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
+  // Needed for GPU-driven rendering, where a single indirect call draws every model range.
+  deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+  enabledFeatures_ = deviceFeatures;
+
+  auto extensions = getEnabledDeviceExtensions();
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures{};
+  descriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  queryBindlessSupport(descriptorIndexingFeatures);
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  queryDynamicRenderingSupport(dynamicRenderingFeatures);
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+  pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  queryGraphicsPipelineLibrarySupport(pipelineLibraryFeatures);
+
+  // Only the feature structs of what is actually supported go into the chain.
+  void *featureChain = nullptr;
+  if (bindlessSupported_) {
+    descriptorIndexingFeatures.pNext = featureChain;
+    featureChain = &descriptorIndexingFeatures;
+  }
+  if (dynamicRenderingSupported_) {
+    dynamicRenderingFeatures.pNext = featureChain;
+    featureChain = &dynamicRenderingFeatures;
+  }
+  if (graphicsPipelineLibrarySupported_) {
+    pipelineLibraryFeatures.pNext = featureChain;
+    featureChain = &pipelineLibraryFeatures;
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = featureChain;
 
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // might not really be necessary anymore because device specific validation layers
   // have been deprecated
@@ -177,6 +307,170 @@ void CvkDevice::createLogicalDevice() {
 
   vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
   vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+
+  loadDeviceFunctions();
+}
+
+std::vector<const char *> CvkDevice::getEnabledDeviceExtensions() {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(
+      physicalDevice,
+      nullptr,
+      &extensionCount,
+      availableExtensions.data());
+
+  std::vector<const char *> extensions = requiredDeviceExtensions();
+  for (const char *optional : optionalDeviceExtensions) {
+    // depend on the instance extension
+    if ((strcmp(optional, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0 ||
+         strcmp(optional, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) == 0 ||
+         strcmp(optional, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) &&
+        !properties2Enabled_) {
+      continue;
+    }
+    for (const auto &extension : availableExtensions) {
+      if (strcmp(optional, extension.extensionName) == 0) {
+        extensions.push_back(optional);
+        break;
+      }
+    }
+  }
+
+  enabledExtensions_.assign(extensions.begin(), extensions.end());
+  std::cout << "enabled device extensions:" << std::endl;
+  for (const auto &extension : enabledExtensions_) {
+    std::cout << "\t" << extension << std::endl;
+  }
+  return extensions;
+}
+
+bool CvkDevice::isExtensionEnabled(const char *extensionName) const {
+  return std::find(enabledExtensions_.begin(), enabledExtensions_.end(), extensionName) !=
+         enabledExtensions_.end();
+}
+
+void CvkDevice::loadDeviceFunctions() {
+  if (isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+    cmdDrawIndexedIndirectCount_ = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+        device_,
+        "vkCmdDrawIndexedIndirectCountKHR");
+  }
+  if (dynamicRenderingSupported_) {
+    cmdBeginRendering_ = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(device_, "vkCmdBeginRenderingKHR");
+    cmdEndRendering_ = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(device_, "vkCmdEndRenderingKHR");
+    dynamicRenderingSupported_ = cmdBeginRendering_ != nullptr && cmdEndRendering_ != nullptr;
+  }
+}
+
+void CvkDevice::queryBindlessSupport(VkPhysicalDeviceDescriptorIndexingFeaturesEXT &enabledFeatures) {
+  if (!isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) ||
+      !isExtensionEnabled(VK_KHR_MAINTENANCE3_EXTENSION_NAME)) {
+    return;
+  }
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceFeatures2KHR");
+  auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceProperties2KHR");
+  if (getFeatures2 == nullptr || getProperties2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported{};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2KHR features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  bindlessSupported_ = supported.shaderSampledImageArrayNonUniformIndexing &&
+                       supported.descriptorBindingSampledImageUpdateAfterBind &&
+                       supported.descriptorBindingStorageBufferUpdateAfterBind &&
+                       supported.descriptorBindingUpdateUnusedWhilePending &&
+                       supported.descriptorBindingPartiallyBound && supported.runtimeDescriptorArray;
+  if (!bindlessSupported_) {
+    return;
+  }
+  enabledFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  enabledFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  enabledFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+  enabledFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  enabledFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+  enabledFeatures.runtimeDescriptorArray = VK_TRUE;
+
+  descriptorIndexingProperties_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2KHR properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties2.pNext = &descriptorIndexingProperties_;
+  getProperties2(physicalDevice, &properties2);
+  descriptorIndexingProperties_.pNext = nullptr;
+}
+
+void CvkDevice::queryDynamicRenderingSupport(VkPhysicalDeviceDynamicRenderingFeaturesKHR &enabledFeatures) {
+  for (const char *extension : {
+           VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+           VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+           VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+           VK_KHR_MULTIVIEW_EXTENSION_NAME,
+           VK_KHR_MAINTENANCE2_EXTENSION_NAME}) {
+    if (!isExtensionEnabled(extension)) {
+      return;
+    }
+  }
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceFeatures2KHR");
+  if (getFeatures2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDeviceDynamicRenderingFeaturesKHR supported{};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+  VkPhysicalDeviceFeatures2KHR features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  dynamicRenderingSupported_ = supported.dynamicRendering;
+  enabledFeatures.dynamicRendering = supported.dynamicRendering;
+}
+
+void CvkDevice::queryGraphicsPipelineLibrarySupport(
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT &enabledFeatures) {
+  if (!isExtensionEnabled(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) ||
+      !isExtensionEnabled(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+    return;
+  }
+  auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceFeatures2KHR");
+  auto getProperties2 = (PFN_vkGetPhysicalDeviceProperties2KHR)vkGetInstanceProcAddr(
+      instance,
+      "vkGetPhysicalDeviceProperties2KHR");
+  if (getFeatures2 == nullptr || getProperties2 == nullptr) {
+    return;
+  }
+
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supported{};
+  supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  VkPhysicalDeviceFeatures2KHR features2{};
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &supported;
+  getFeatures2(physicalDevice, &features2);
+
+  VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT libraryProperties{};
+  libraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+  VkPhysicalDeviceProperties2KHR properties2{};
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties2.pNext = &libraryProperties;
+  getProperties2(physicalDevice, &properties2);
+
+  graphicsPipelineLibrarySupported_ =
+      supported.graphicsPipelineLibrary && libraryProperties.graphicsPipelineLibraryFastLinking;
+  enabledFeatures.graphicsPipelineLibrary = graphicsPipelineLibrarySupported_;
 }
 
 void CvkDevice::createCommandPool() {
@@ -200,8 +494,9 @@ bool CvkDevice::isDeviceSuitable(VkPhysicalDevice device) {
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // Headless rendering never presents, so there is no surface to check against.
+  bool swapChainAdequate = isHeadless();
+  if (extensionsSupported && !isHeadless()) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
   }
@@ -261,19 +556,39 @@ bool CvkDevice::checkValidationLayerSupport() {
 }
 
 std::vector<const char *> CvkDevice::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-  std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+  if (!isHeadless()) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers) {
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
   }
+  for (const char *optional : optionalInstanceExtensions) {
+    if (isInstanceExtensionAvailable(optional)) {
+      extensions.push_back(optional);
+    }
+  }
 
   return extensions;
 }
 
+bool CvkDevice::isInstanceExtensionAvailable(const char *extensionName) {
+  uint32_t extensionCount = 0;
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+  for (const auto &extension : extensions) {
+    if (strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void CvkDevice::hasGflwRequiredInstanceExtensions() {
   uint32_t extensionCount = 0;
   vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -297,6 +612,15 @@ void CvkDevice::hasGflwRequiredInstanceExtensions() {
   }
 }
 
+std::vector<const char *> CvkDevice::requiredDeviceExtensions() const {
+  // Without a surface there is nothing to present to, which also lets devices without
+  // VK_KHR_swapchain (e.g. lavapipe in a build container) through.
+  if (isHeadless()) {
+    return {};
+  }
+  return deviceExtensions;
+}
+
 bool CvkDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
   uint32_t extensionCount;
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
@@ -308,7 +632,8 @@ bool CvkDevice::checkDeviceExtensionSupport(VkPhysicalDevice device) {
       &extensionCount,
       availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+  auto required = requiredDeviceExtensions();
+  std::set<std::string> requiredExtensions(required.begin(), required.end());
 
   for (const auto &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -333,7 +658,12 @@ QueueFamilyIndices CvkDevice::findQueueFamilies(VkPhysicalDevice device) {
       indices.graphicsFamilyHasValue = true;
     }
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    if (isHeadless()) {
+      // "presenting" is a copy on the graphics queue
+      presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+    } else {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+    }
     if (queueFamily.queueCount > 0 && presentSupport) {
       indices.presentFamily = i;
       indices.presentFamilyHasValue = true;
@@ -3,11 +3,15 @@
 #include "CvkWindow.hpp"
 
 // std lib headers
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace cvk {
 
+class CvkShaderLibrary;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -40,11 +44,45 @@ class CvkDevice {
   CvkDevice &operator=(CvkDevice &&) = delete;
 
   VkCommandPool getCommandPool() { return commandPool; }
+  VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  // No surface and no VK_KHR_swapchain, CvkSwapchain renders into images of its own.
+  bool isHeadless() const { return window.isHeadless(); }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
 
+  // Features and optional extensions that were actually enabled on the logical device.
+  const VkPhysicalDeviceFeatures &enabledFeatures() const { return enabledFeatures_; }
+  bool isExtensionEnabled(const char *extensionName) const;
+  // VK_EXT_descriptor_indexing with everything bindless descriptors need: partially bound, update-after-bind
+  // arrays and non-uniform indexing of sampled images. The limits are only filled in when this is true.
+  bool supportsBindless() const { return bindlessSupported_; }
+  const VkPhysicalDeviceDescriptorIndexingPropertiesEXT &descriptorIndexingProperties() const {
+    return descriptorIndexingProperties_;
+  }
+  // VK_KHR_dynamic_rendering: render passes begin with vkCmdBeginRenderingKHR on plain image views, no
+  // VkRenderPass or VkFramebuffer needed. The function pointers are nullptr when this is false.
+  bool supportsDynamicRendering() const { return dynamicRenderingSupported_; }
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering() const { return cmdBeginRendering_; }
+  PFN_vkCmdEndRenderingKHR cmdEndRendering() const { return cmdEndRendering_; }
+  // VK_EXT_graphics_pipeline_library with fast linking: pipelines can be built as separately compiled parts
+  // and linked cheaply, see CvkPipelineLibrary. Without fast linking the parts would buy nothing, so this is
+  // false then as well.
+  bool supportsGraphicsPipelineLibrary() const { return graphicsPipelineLibrarySupported_; }
+  // Passed to every pipeline creation. Starts out with what PIPELINE_CACHE_FILE holds if it was written by this
+  // very device and driver (same vendor, device and cache UUID), and is written back when the device is destroyed.
+  VkPipelineCache pipelineCache() const { return pipelineCache_; }
+  // Logs how long a pipeline took to create, the totals are logged on shutdown to compare cold and warm starts.
+  // Thread safe, pipelines get created on CvkPipelineBuilder's threads.
+  void reportPipelineCreation(const std::string &name, double milliseconds);
+  static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+  // Where pipelines get their shader modules from.
+  CvkShaderLibrary &shaderLibrary() { return *shaderLibrary_; }
+
+  // nullptr when VK_KHR_draw_indirect_count is not available on this device.
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount() const { return cmdDrawIndexedIndirectCount_; }
+
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
   QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
@@ -79,15 +117,26 @@ class CvkDevice {
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
+  void savePipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
   std::vector<const char *> getRequiredExtensions();
+  bool isInstanceExtensionAvailable(const char *extensionName);
   bool checkValidationLayerSupport();
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isPipelineCacheCompatible(const std::vector<char> &data) const;
+  std::vector<const char *> requiredDeviceExtensions() const;
+  std::vector<const char *> getEnabledDeviceExtensions();
+  void loadDeviceFunctions();
+  // Fills in the features to enable, sets bindlessSupported_ and the limits.
+  void queryBindlessSupport(VkPhysicalDeviceDescriptorIndexingFeaturesEXT &enabledFeatures);
+  void queryDynamicRenderingSupport(VkPhysicalDeviceDynamicRenderingFeaturesKHR &enabledFeatures);
+  void queryGraphicsPipelineLibrarySupport(VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT &enabledFeatures);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
@@ -97,12 +146,44 @@ class CvkDevice {
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkPhysicalDeviceFeatures enabledFeatures_{};
+  std::vector<std::string> enabledExtensions_;
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount_ = nullptr;
+  bool properties2Enabled_ = false; // VK_KHR_get_physical_device_properties2, the instance stays at Vulkan 1.0
+  bool bindlessSupported_ = false;
+  VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptorIndexingProperties_{};
+  bool dynamicRenderingSupported_ = false;
+  PFN_vkCmdBeginRenderingKHR cmdBeginRendering_ = nullptr;
+  PFN_vkCmdEndRenderingKHR cmdEndRendering_ = nullptr;
+  bool graphicsPipelineLibrarySupported_ = false;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
+  std::unique_ptr<CvkShaderLibrary> shaderLibrary_;
+  bool pipelineCacheWarm_ = false; // started from a compatible PIPELINE_CACHE_FILE
+  std::mutex pipelineStatsMutex_;
+  uint32_t pipelinesCreated_ = 0;
+  double pipelineCreationMilliseconds_ = 0.0;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
   const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // Enabled when the physical device supports them, the engine falls back gracefully otherwise.
+  const std::vector<const char *> optionalDeviceExtensions = {
+      VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE3_EXTENSION_NAME,  // required by VK_EXT_descriptor_indexing
+      VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+      // VK_KHR_dynamic_rendering and the chain it depends on
+      VK_KHR_MULTIVIEW_EXTENSION_NAME,
+      VK_KHR_MAINTENANCE2_EXTENSION_NAME,
+      VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+      VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+      VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+      // VK_EXT_graphics_pipeline_library and the extension it builds on
+      VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+      VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME};
+  const std::vector<const char *> optionalInstanceExtensions = {
+      VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME};
 };
 
 }  // namespace cvk
\ No newline at end of file
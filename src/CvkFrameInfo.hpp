@@ -10,12 +10,49 @@ namespace cvk {
 Frame Info makes it easier for render systems etc. to access external information.
 */
 
+// Counters the render systems fill in while recording, MainApp prints them with --stats.
+struct FrameStats {
+    uint32_t visibleObjects = 0;
+    uint32_t culledObjects = 0;
+    // Part of culledObjects that passed the frustum test but was hidden behind other objects (Hi-Z).
+    uint32_t occludedObjects = 0;
+
+    uint32_t drawCalls = 0;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorSetBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    // Binds that would have been recorded without redundancy checks, compare with the three above.
+    uint32_t requestedBinds = 0;
+
+    // Secondary command buffers that had to be (re)recorded, 0 when a cached one was replayed.
+    uint32_t recordedCommandBuffers = 0;
+
+    uint32_t totalBinds() const { return pipelineBinds + descriptorSetBinds + vertexBufferBinds; }
+
+    // Merges the counters of e.g. one secondary command buffer into the frame's stats.
+    FrameStats &operator+=(const FrameStats &other) {
+        visibleObjects += other.visibleObjects;
+        culledObjects += other.culledObjects;
+        occludedObjects += other.occludedObjects;
+        drawCalls += other.drawCalls;
+        pipelineBinds += other.pipelineBinds;
+        descriptorSetBinds += other.descriptorSetBinds;
+        vertexBufferBinds += other.vertexBufferBinds;
+        requestedBinds += other.requestedBinds;
+        recordedCommandBuffers += other.recordedCommandBuffers;
+        return *this;
+    }
+};
+
 struct FrameInfo {
     int frameIndex;
     float frameTime;
     VkCommandBuffer commandBuffer;
     CvkCamera &camera;
     VkDescriptorSet globalDescriptorSet;
+    // Set by MasterRenderSystem while globalDescriptorSet is bound at set 0, systems then only bind from set 1 on.
+    bool globalSetBound = false;
+    FrameStats stats{};
 };
 
 }; // namespace cvk
\ No newline at end of file
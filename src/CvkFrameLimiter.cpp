@@ -0,0 +1,69 @@
+#include "CvkFrameLimiter.hpp"
+
+// std
+#include <cassert>
+#include <cmath>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+namespace cvk {
+
+CvkFrameLimiter::CvkFrameLimiter(double framesPerSecond) {
+#ifdef _WIN32
+    timeBeginPeriod(1);
+#endif
+    setFramesPerSecond(framesPerSecond);
+    nextFrame = Clock::now();
+}
+
+CvkFrameLimiter::~CvkFrameLimiter() {
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void CvkFrameLimiter::setFramesPerSecond(double framesPerSecond) {
+    assert(framesPerSecond > 0.0 && "Frame limiter needs a positive frame rate!");
+    this->framesPerSecond = framesPerSecond;
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+}
+
+void CvkFrameLimiter::wait() {
+    const auto start = Clock::now();
+    if (start < nextFrame) {
+        sleepUntil(nextFrame);
+    }
+    const auto now = Clock::now();
+    lastWaitMilliseconds = std::chrono::duration<double, std::milli>(now - start).count();
+    // Late frames (or the first one after an idle stretch in --on-demand) start a fresh schedule, a full period
+    // from now. Only a frame that actually waited keeps to the old one.
+    nextFrame = start < nextFrame ? nextFrame + period : now + period;
+}
+
+void CvkFrameLimiter::sleepUntil(Clock::time_point deadline) {
+    double remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+    while (remaining > sleepEstimate) {
+        const auto sleepStart = Clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        const double observed = std::chrono::duration<double>(Clock::now() - sleepStart).count();
+        remaining = std::chrono::duration<double>(deadline - Clock::now()).count();
+
+        sleepCount++;
+        const double delta = observed - sleepMean;
+        sleepMean += delta / sleepCount;
+        sleepM2 += delta * (observed - sleepMean);
+        sleepEstimate = sleepMean + std::sqrt(sleepM2 / (sleepCount - 1));
+    }
+    // Less than a sleep is left, spin it away.
+    while (Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace cvk
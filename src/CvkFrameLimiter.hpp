@@ -0,0 +1,51 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+
+namespace cvk {
+
+/*
+Caps the frame rate by sleeping right before a frame samples its input. Waiting there rather than after present
+keeps the input a frame renders as fresh as possible: the spare time is spent before polling, not between polling
+and the GPU picking the frame up.
+
+A plain sleep_for overshoots by up to a scheduler tick, so wait() sleeps 1 ms at a time only while the time left is
+longer than such a sleep was seen to take (mean plus one standard deviation), and spins the rest with yields. That
+keeps it within a few microseconds of the target while the CPU idles for most of the wait. On Windows the timer
+resolution is raised to 1 ms for as long as a limiter exists, otherwise a 1 ms sleep can take 15.
+*/
+class CvkFrameLimiter {
+public:
+    explicit CvkFrameLimiter(double framesPerSecond);
+    ~CvkFrameLimiter();
+
+    CvkFrameLimiter(const CvkFrameLimiter &) = delete;
+    CvkFrameLimiter &operator=(const CvkFrameLimiter &) = delete;
+
+    // Blocks until the current frame's time slot is over. A frame that overran its slot doesn't get the time back
+    // by rushing the next ones, the next slot simply starts now.
+    void wait();
+    void setFramesPerSecond(double framesPerSecond);
+    double getFramesPerSecond() const { return framesPerSecond; }
+    // How long the last wait() blocked.
+    double getLastWaitMilliseconds() const { return lastWaitMilliseconds; }
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void sleepUntil(Clock::time_point deadline);
+
+    double framesPerSecond;
+    Clock::duration period;
+    Clock::time_point nextFrame;
+    double lastWaitMilliseconds = 0.0;
+
+    // Running mean and variance (Welford) of how long a 1 ms sleep takes, in seconds.
+    double sleepEstimate = 5e-3;
+    double sleepMean = 5e-3;
+    double sleepM2 = 0.0;
+    uint64_t sleepCount = 1;
+};
+
+} // namespace cvk
@@ -0,0 +1,156 @@
+#include "CvkFrustumCuller.hpp"
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CVK_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CVK_CULL_SSE
+#endif
+
+// std
+#include <cmath>
+
+namespace cvk {
+
+static constexpr uint32_t CULL_LANES = 8; // widest path, arrays are padded to this
+
+const char *CvkFrustumCuller::simdPath() {
+#if defined(CVK_CULL_AVX)
+    return "AVX";
+#elif defined(CVK_CULL_SSE)
+    return "SSE";
+#else
+    return "scalar";
+#endif
+}
+
+void CvkFrustumCuller::cull(
+const CvkCamera &camera,
+std::vector<CvkGameObject> &gameObjects,
+const CvkLayerAnimation &layerAnimation,
+std::vector<uint32_t> &visibleObjects) {
+    packBounds(gameObjects, layerAnimation.getUbo());
+    visibleObjects.clear();
+    testBounds(camera.getFrustumPlanes(), visibleObjects);
+}
+
+// Transforms every model AABB into world space (Arvo's method: the new half extent is |M| * extent),
+// which stays tight for the cubes no matter how they are rotated.
+void CvkFrustumCuller::packBounds(std::vector<CvkGameObject> &gameObjects, const CvkLayerAnimation::LayerUbo &layers) {
+    const size_t capacity = (gameObjects.size() + CULL_LANES - 1) / CULL_LANES * CULL_LANES;
+    for (auto *component : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) {
+        component->resize(capacity);
+    }
+    objectIndices.resize(capacity);
+
+    boundsCount = 0;
+    for (uint32_t i = 0; i < gameObjects.size(); i++) {
+        auto &obj = gameObjects[i];
+        if (obj.model == nullptr) { continue; }
+
+        const auto &bounds = obj.model->getBounds();
+        const glm::vec3 localCenter = (bounds.aabbMin + bounds.aabbMax) * .5f;
+        const glm::vec3 localExtent = (bounds.aabbMax - bounds.aabbMin) * .5f;
+        const glm::mat4 modelMatrix = obj.transform.mat4();
+
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(localCenter, 1.f));
+        glm::vec3 extent{0.f};
+        for (int axis = 0; axis < 3; axis++) {
+            extent += glm::abs(glm::vec3(modelMatrix[axis])) * localExtent[axis];
+        }
+
+        // The transform is still the one from before the turn, the vertex shaders rotate the object around the
+        // layer's pivot. The sphere around the pivot that contains the box covers every angle of the turn.
+        uint32_t turning = obj.layerMask & layers.activeLayers;
+        for (uint32_t layer = 0; turning != 0; layer++, turning >>= 1) {
+            if ((turning & 1) == 0) { continue; }
+            const glm::vec3 pivot{layers.layers[layer].pivot};
+            extent = glm::vec3(glm::length(center - pivot) + glm::length(extent));
+            center = pivot;
+        }
+
+        centerX[boundsCount] = center.x;
+        centerY[boundsCount] = center.y;
+        centerZ[boundsCount] = center.z;
+        extentX[boundsCount] = extent.x;
+        extentY[boundsCount] = extent.y;
+        extentZ[boundsCount] = extent.z;
+        objectIndices[boundsCount] = i;
+        boundsCount++;
+    }
+}
+
+// A box is outside when it is fully behind any plane: dot(n, c) + w < -dot(|n|, e).
+void CvkFrustumCuller::testBounds(const std::array<glm::vec4, 6> &planes, std::vector<uint32_t> &visibleObjects) const {
+    uint32_t i = 0;
+#if defined(CVK_CULL_AVX)
+    for (; i + 8 <= boundsCount; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(&centerX[i]);
+        const __m256 cy = _mm256_loadu_ps(&centerY[i]);
+        const __m256 cz = _mm256_loadu_ps(&centerZ[i]);
+        const __m256 ex = _mm256_loadu_ps(&extentX[i]);
+        const __m256 ey = _mm256_loadu_ps(&extentY[i]);
+        const __m256 ez = _mm256_loadu_ps(&extentZ[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto &plane : planes) {
+            __m256 distance = _mm256_set1_ps(plane.w);
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.x), cx));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.y), cy));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane.z), cz));
+            __m256 radius = _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), ex);
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), ey));
+            radius = _mm256_add_ps(radius, _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        const int mask = _mm256_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 8; lane++) {
+            if (mask & (1 << lane)) { visibleObjects.push_back(objectIndices[i + lane]); }
+        }
+    }
+#elif defined(CVK_CULL_SSE)
+    for (; i + 4 <= boundsCount; i += 4) {
+        const __m128 cx = _mm_loadu_ps(&centerX[i]);
+        const __m128 cy = _mm_loadu_ps(&centerY[i]);
+        const __m128 cz = _mm_loadu_ps(&centerZ[i]);
+        const __m128 ex = _mm_loadu_ps(&extentX[i]);
+        const __m128 ey = _mm_loadu_ps(&extentY[i]);
+        const __m128 ez = _mm_loadu_ps(&extentZ[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto &plane : planes) {
+            __m128 distance = _mm_set1_ps(plane.w);
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.x), cx));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.y), cy));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane.z), cz));
+            __m128 radius = _mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), ex);
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), ey));
+            radius = _mm_add_ps(radius, _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), ez));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        const int mask = _mm_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            if (mask & (1 << lane)) { visibleObjects.push_back(objectIndices[i + lane]); }
+        }
+    }
+#endif
+    // Scalar tail, and the whole thing when there is no SIMD path.
+    for (; i < boundsCount; i++) {
+        bool inside = true;
+        for (const auto &plane : planes) {
+            const float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+            const float radius = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i];
+            if (distance + radius < 0.f) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) { visibleObjects.push_back(objectIndices[i]); }
+    }
+}
+
+} // namespace cvk
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CvkCamera.hpp"
+#include "CvkGameObject.hpp"
+#include "CvkLayerAnimation.hpp"
+
+// std
+#include <vector>
+
+namespace cvk {
+
+/*
+CPU frustum culling. The world space bounds of all objects are packed structure-of-arrays style
+(one array per component), so the plane tests run 8 objects at a time with AVX, 4 at a time with SSE,
+or one by one on anything else. Which one is picked at compile time, see CVK_ENABLE_AVX in CMakeLists.txt.
+*/
+class CvkFrustumCuller {
+public:
+    // Fills visibleObjects with the indices (into gameObjects) of every object that touches the camera frustum.
+    // Objects without a model are never visible. Objects of a turning layer are tested with the box around all the
+    // places the turn can take them.
+    void cull(
+        const CvkCamera &camera,
+        std::vector<CvkGameObject> &gameObjects,
+        const CvkLayerAnimation &layerAnimation,
+        std::vector<uint32_t> &visibleObjects);
+
+    static const char *simdPath();
+private:
+    void packBounds(std::vector<CvkGameObject> &gameObjects, const CvkLayerAnimation::LayerUbo &layers);
+    void testBounds(const std::array<glm::vec4, 6> &planes, std::vector<uint32_t> &visibleObjects) const;
+
+    // World space AABBs as center + half extent, padded to a multiple of 8 entries.
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<uint32_t> objectIndices;
+    uint32_t boundsCount = 0;
+};
+
+} // namespace cvk
@@ -37,6 +37,10 @@ public:
     std::shared_ptr<CvkModel> model;
     glm::vec3 color{};
     TransformComponent transform{};
+    // Bit i set: the object turns along with layer i of CvkLayerAnimation.
+    uint32_t layerMask = 0;
+    // See MasterRenderSystem::addMaterial, 0 is the default white material.
+    uint32_t materialIndex = 0;
 private:
     id_t id;
     CvkGameObject(id_t obj_id) : id{obj_id} {}
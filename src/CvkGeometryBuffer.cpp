@@ -0,0 +1,77 @@
+#include "CvkGeometryBuffer.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+CvkGeometryBuffer::CvkGeometryBuffer(CvkDevice &device, const std::vector<const CvkModel*> &models)
+: cvkDevice{device} {
+    uint32_t totalVertices = 0;
+    uint32_t totalIndices = 0;
+    for (auto model : models) {
+        if (contains(model)) { continue; }
+        if (!model->hasIndices()) {
+            // Indirect indexed draws need an index range for every mesh.
+            throw std::runtime_error("Geometry buffer only supports indexed models!");
+        }
+        MeshRange range{};
+        range.firstIndex = totalIndices;
+        range.indexCount = model->getIndexCount();
+        range.vertexOffset = static_cast<int32_t>(totalVertices);
+        meshIndices[model] = static_cast<uint32_t>(meshRanges.size());
+        meshRanges.push_back(range);
+        meshModels.push_back(model);
+
+        totalVertices += model->getVertexCount();
+        totalIndices += model->getIndexCount();
+    }
+    assert(totalVertices > 0 && "Cannot create a geometry buffer without models");
+
+    const VkDeviceSize vertexSize = sizeof(CvkModel::Vertex);
+    const VkDeviceSize indexSize = sizeof(uint32_t);
+    vertexBuffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        vertexSize,
+        totalVertices,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    indexBuffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        indexSize,
+        totalIndices,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // The models already live in DEVICE_LOCAL memory, so copy GPU to GPU in a single submission
+    // instead of going through another staging buffer.
+    VkCommandBuffer commandBuffer = cvkDevice.beginSingleTimeCommands();
+    for (auto &[model, meshIndex] : meshIndices) {
+        const MeshRange &range = meshRanges[meshIndex];
+
+        VkBufferCopy vertexRegion{};
+        vertexRegion.srcOffset = 0;
+        vertexRegion.dstOffset = range.vertexOffset * vertexSize;
+        vertexRegion.size = model->getVertexCount() * vertexSize;
+        vkCmdCopyBuffer(commandBuffer, model->getVertexBuffer(), vertexBuffer->getBuffer(), 1, &vertexRegion);
+
+        VkBufferCopy indexRegion{};
+        indexRegion.srcOffset = 0;
+        indexRegion.dstOffset = range.firstIndex * indexSize;
+        indexRegion.size = range.indexCount * indexSize;
+        vkCmdCopyBuffer(commandBuffer, model->getIndexBuffer(), indexBuffer->getBuffer(), 1, &indexRegion);
+    }
+    cvkDevice.endSingleTimeCommands(commandBuffer);
+}
+
+CvkGeometryBuffer::~CvkGeometryBuffer() { }
+
+void CvkGeometryBuffer::bind(VkCommandBuffer commandBuffer) {
+    VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+} // namespace cvk
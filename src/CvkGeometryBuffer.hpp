@@ -0,0 +1,53 @@
+#pragma once
+
+#include "CvkBuffer.hpp"
+#include "CvkDevice.hpp"
+#include "CvkModel.hpp"
+
+// std
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace cvk {
+
+/*
+Packs the vertices and indices of several models into one vertex buffer and one index buffer.
+Every model becomes a "mesh range" inside these buffers, so the whole scene can be drawn with a
+single bind and indirect draw commands that only differ by their offsets.
+*/
+class CvkGeometryBuffer {
+public:
+    struct MeshRange {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t vertexOffset;
+    };
+
+    CvkGeometryBuffer(CvkDevice &device, const std::vector<const CvkModel*> &models);
+    ~CvkGeometryBuffer();
+
+    CvkGeometryBuffer(const CvkGeometryBuffer &) = delete;
+    CvkGeometryBuffer &operator=(const CvkGeometryBuffer &) = delete;
+
+    bool contains(const CvkModel *model) const { return meshIndices.count(model) == 1; }
+    // Dense index of a model in [0, getMeshCount()), handy for bucketing objects per mesh.
+    uint32_t getMeshIndex(const CvkModel *model) const { return meshIndices.at(model); }
+    const MeshRange &getMeshRange(uint32_t meshIndex) const { return meshRanges[meshIndex]; }
+    const CvkModel &getMeshModel(uint32_t meshIndex) const { return *meshModels[meshIndex]; }
+    uint32_t getMeshCount() const { return static_cast<uint32_t>(meshRanges.size()); }
+
+    void bind(VkCommandBuffer commandBuffer);
+
+private:
+    CvkDevice &cvkDevice;
+
+    std::unique_ptr<CvkBuffer> vertexBuffer;
+    std::unique_ptr<CvkBuffer> indexBuffer;
+
+    std::vector<MeshRange> meshRanges;
+    std::vector<const CvkModel*> meshModels;
+    std::unordered_map<const CvkModel*, uint32_t> meshIndices;
+};
+
+} // namespace cvk
@@ -0,0 +1,70 @@
+#include "CvkGpuTimer.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <stdexcept>
+
+namespace cvk {
+
+CvkGpuTimer::CvkGpuTimer(CvkDevice &device) : cvkDevice{device} {
+    pending.assign(CvkSwapchain::MAX_FRAMES_IN_FLIGHT, false);
+
+    // Only timestampValidBits of a result are meaningful, 0 means the queue has no timestamps at all.
+    QueueFamilyIndices queueFamilyIndices = cvkDevice.findPhysicalQueueFamilies();
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(cvkDevice.getPhysicalDevice(), &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(cvkDevice.getPhysicalDevice(), &familyCount, families.data());
+    const uint32_t validBits = families[queueFamilyIndices.graphicsFamily].timestampValidBits;
+    if (validBits == 0) { return; }
+    validBitsMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    nanosecondsPerTick = cvkDevice.properties.limits.timestampPeriod;
+
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * CvkSwapchain::MAX_FRAMES_IN_FLIGHT;
+    if (vkCreateQueryPool(cvkDevice.device(), &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    supported = true;
+}
+
+CvkGpuTimer::~CvkGpuTimer() {
+    vkDestroyQueryPool(cvkDevice.device(), queryPool, nullptr);
+}
+
+bool CvkGpuTimer::collect(int frameIndex, double &milliseconds) {
+    if (!supported || !pending[frameIndex]) { return false; }
+
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(
+        cvkDevice.device(),
+        queryPool,
+        2 * frameIndex,
+        2,
+        sizeof(timestamps),
+        timestamps,
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) { return false; } // VK_NOT_READY, e.g. the frame was never submitted
+
+    pending[frameIndex] = false;
+    const uint64_t ticks = (timestamps[1] - timestamps[0]) & validBitsMask;
+    milliseconds = static_cast<double>(ticks) * nanosecondsPerTick * 1e-6;
+    return true;
+}
+
+void CvkGpuTimer::begin(VkCommandBuffer commandBuffer, int frameIndex) {
+    if (!supported) { return; }
+    vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameIndex, 2);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 2 * frameIndex);
+}
+
+void CvkGpuTimer::end(VkCommandBuffer commandBuffer, int frameIndex) {
+    if (!supported) { return; }
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frameIndex + 1);
+    pending[frameIndex] = true;
+}
+
+} // namespace cvk
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+
+// std
+#include <vector>
+
+namespace cvk {
+
+/*
+Measures how long the GPU spends on a frame's command buffer with two timestamp queries per frame in flight.
+Results are read back the next time the same frame index comes around, beginFrame has waited on its fence
+by then, so reading never stalls.
+*/
+class CvkGpuTimer {
+public:
+    CvkGpuTimer(CvkDevice &device);
+    ~CvkGpuTimer();
+
+    CvkGpuTimer(const CvkGpuTimer &) = delete;
+    CvkGpuTimer &operator=(const CvkGpuTimer &) = delete;
+
+    // False if the graphics queue can't write timestamps, begin/end/collect are no-ops then.
+    bool isSupported() const { return supported; }
+
+    // Call after beginFrame and before begin(). Returns false if frameIndex has no finished measurement yet.
+    bool collect(int frameIndex, double &milliseconds);
+    // Both have to be recorded outside of a render pass, around everything that should be measured.
+    void begin(VkCommandBuffer commandBuffer, int frameIndex);
+    void end(VkCommandBuffer commandBuffer, int frameIndex);
+
+private:
+    CvkDevice &cvkDevice;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    bool supported = false;
+    double nanosecondsPerTick = 1.0;
+    uint64_t validBitsMask = ~0ull;
+    std::vector<bool> pending; // per frame in flight, true while a measurement waits to be collected
+};
+
+} // namespace cvk
@@ -0,0 +1,63 @@
+#include "CvkLayerAnimation.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+uint32_t CvkLayerAnimation::addLayer(const glm::vec3 &pivot, const glm::vec3 &axis) {
+    if (axes.size() >= MAX_LAYERS) {
+        throw std::runtime_error("Too many animation layers!");
+    }
+    const uint32_t layer = static_cast<uint32_t>(axes.size());
+    axes.push_back(glm::normalize(axis));
+    ubo.layers[layer].pivot = glm::vec4(pivot, 1.f);
+    return layer;
+}
+
+bool CvkLayerAnimation::startTurn(uint32_t layer, float angle, float duration) {
+    assert(layer < axes.size() && "Turning a layer that doesn't exist!");
+    if (turning) { return false; }
+    turning = true;
+    turnLayer = layer;
+    turnAngle = angle;
+    turnDuration = duration;
+    turnElapsed = 0.f;
+    ubo.activeLayers = 1u << layer;
+    return true;
+}
+
+bool CvkLayerAnimation::update(float frameTime) {
+    if (!turning) { return false; }
+    turnElapsed += frameTime;
+    if (turnDuration <= 0.f || turnElapsed >= turnDuration) {
+        // Lands exactly on the angle, the shaders stop applying it and the caller bakes it instead.
+        turning = false;
+        finished = true;
+        finishedTurn.layer = turnLayer;
+        finishedTurn.rotation = glm::angleAxis(turnAngle, axes[turnLayer]);
+        finishedTurn.pivot = glm::vec3(ubo.layers[turnLayer].pivot);
+        setRotation(turnLayer, glm::quat{1.f, 0.f, 0.f, 0.f}); // identity, w first
+        ubo.activeLayers = 0;
+        return true;
+    }
+    // smoothstep, so the turn eases in and out
+    const float t = turnElapsed / turnDuration;
+    const float eased = t * t * (3.f - 2.f * t);
+    setRotation(turnLayer, glm::angleAxis(turnAngle * eased, axes[turnLayer]));
+    return true;
+}
+
+bool CvkLayerAnimation::consumeFinishedTurn(FinishedTurn &turn) {
+    if (!finished) { return false; }
+    finished = false;
+    turn = finishedTurn;
+    return true;
+}
+
+void CvkLayerAnimation::setRotation(uint32_t layer, const glm::quat &rotation) {
+    ubo.layers[layer].rotation = {rotation.x, rotation.y, rotation.z, rotation.w};
+}
+
+} // namespace cvk
@@ -0,0 +1,79 @@
+#pragma once
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace cvk {
+
+/*
+Layer turns of the puzzle, animated on the GPU. A layer is a pivot and an axis, objects belong to layers through
+CvkGameObject::layerMask. While a layer turns, only its rotation (a quaternion) changes, the vertex shaders rotate
+every object of the layer with it. So a turn costs one small uniform upload per frame, none of the objects'
+transforms are touched until the turn is over and its rotation gets baked into them once.
+
+Culling doesn't know the angle either, CvkFrustumCuller and shaders/cull.comp test a turning object with the sphere
+around its layer's pivot that it sweeps through during the whole turn.
+*/
+class CvkLayerAnimation {
+public:
+    static constexpr uint32_t MAX_LAYERS = 32; // one bit of layerMask each
+
+    // What the vertex shaders see at set 0, binding 1 (std140). Must match LayerUbo in shaders/simple_shader.vert,
+    // shaders/depth_prepass.vert, shaders/indirect_shader.vert and shaders/cull.comp.
+    struct LayerData {
+        glm::vec4 rotation{0.f, 0.f, 0.f, 1.f}; // quaternion, xyz = vector part
+        glm::vec4 pivot{0.f};                    // xyz
+    };
+    struct LayerUbo {
+        LayerData layers[MAX_LAYERS];
+        uint32_t activeLayers = 0; // bit i is set while layers[i] is turning, the others are ignored
+        uint32_t padding[3]{};
+    };
+
+    // A turn that reached its angle, to be baked into the transforms of the layer's objects.
+    struct FinishedTurn {
+        uint32_t layer;
+        glm::quat rotation;
+        glm::vec3 pivot;
+    };
+
+    // Returns the new layer's index.
+    uint32_t addLayer(const glm::vec3 &pivot, const glm::vec3 &axis);
+    uint32_t getLayerCount() const { return static_cast<uint32_t>(axes.size()); }
+
+    // Turns a layer by angle (radians) within duration seconds. Turns run one at a time, so this returns false
+    // while another one is still going.
+    bool startTurn(uint32_t layer, float angle, float duration);
+    bool isTurning() const { return turning; }
+
+    // Advances the running turn, returns true if a layer moved (the frame has to be drawn).
+    bool update(float frameTime);
+    // The finished turn is no longer applied by the shaders, so the caller has to bake it in the same frame.
+    // Returns false if no turn finished since the last call.
+    bool consumeFinishedTurn(FinishedTurn &turn);
+
+    const LayerUbo &getUbo() const { return ubo; }
+private:
+    void setRotation(uint32_t layer, const glm::quat &rotation);
+
+    LayerUbo ubo{};
+    std::vector<glm::vec3> axes;
+
+    bool turning = false;
+    uint32_t turnLayer = 0;
+    float turnAngle = 0.f;
+    float turnDuration = 0.f;
+    float turnElapsed = 0.f;
+
+    bool finished = false;
+    FinishedTurn finishedTurn{};
+};
+
+} // namespace cvk
@@ -25,17 +25,24 @@ struct hash<cvk::CvkModel::Vertex> {
 
 namespace cvk {
 
-CvkModel::CvkModel(CvkDevice &device, const CvkModel::Builder &builder) : cvkDevice{device} {
+CvkModel::CvkModel(CvkDevice &device, const CvkModel::Builder &builder, bool positionStream) : cvkDevice{device} {
+    static uint32_t nextId = 0;
+    id = nextId++;
     createVertexBuffers(builder.vertices);
     createIndexBuffers(builder.indices);
+    if (positionStream) { createPositionBuffers(builder.vertices); }
+    bounds = builder.computeBounds();
 }
 
 CvkModel::~CvkModel() { }
 
-std::unique_ptr<CvkModel> CvkModel::createModelFromFile(CvkDevice &device, const std::string &filepath) {
+std::unique_ptr<CvkModel> CvkModel::createModelFromFile(
+CvkDevice &device,
+const std::string &filepath,
+bool positionStream) {
     Builder builder{};
     builder.loadModel(filepath);
-    return std::make_unique<CvkModel>(device, builder);
+    return std::make_unique<CvkModel>(device, builder, positionStream);
 }
 
 void CvkModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
@@ -69,8 +76,9 @@ void CvkModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
         cvkDevice,
         vertexSize,
         vertexCount,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        // that last one is so that you can transfer the staging buffer and have this be the destination.
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        // TRANSFER_DST is so that you can transfer the staging buffer and have this be the destination.
+        // TRANSFER_SRC lets CvkGeometryBuffer copy this model into a shared buffer.
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT // Far more efficient in GPU
     );
     // 5. Copy Staging Buffer to DEVICE_LOCAL Vertex Buffer.
@@ -101,18 +109,49 @@ void CvkModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
         cvkDevice,
         indexSize,
         indexCount,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
     );
 
     cvkDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
 }
 
-void CvkModel::draw(VkCommandBuffer commandBuffer) {
+void CvkModel::createPositionBuffers(const std::vector<Vertex> &vertices) {
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].position;
+    }
+    VkDeviceSize bufferSize = sizeof(positions[0]) * positions.size();
+
+    // Same Process as Vertex Buffer, refer above.
+    uint32_t positionSize = sizeof(positions[0]);
+    CvkBuffer stagingBuffer {
+        cvkDevice,
+        positionSize,
+        vertexCount,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    };
+
+    stagingBuffer.map();
+    stagingBuffer.writeToBuffer((void *)positions.data());
+
+    positionBuffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        positionSize,
+        vertexCount,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+
+    cvkDevice.copyBuffer(stagingBuffer.getBuffer(), positionBuffer->getBuffer(), bufferSize);
+}
+
+void CvkModel::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
     if (hasIndexBuffer) {
-        vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+        vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, firstInstance);
     } else {
-        vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+        vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
     }
 }
 void CvkModel::bind(VkCommandBuffer commandBuffer) {
@@ -124,6 +163,16 @@ void CvkModel::bind(VkCommandBuffer commandBuffer) {
     }
 }
 
+void CvkModel::bindPositions(VkCommandBuffer commandBuffer) {
+    assert(positionBuffer != nullptr && "Model was created without a position stream!");
+    VkBuffer buffers[] = {positionBuffer->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+    if (hasIndexBuffer) {
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+}
+
 std::vector<VkVertexInputBindingDescription> CvkModel::Vertex::getBindingDescriptions() {
     std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
     bindingDescriptions[0].binding = 0;
@@ -144,6 +193,18 @@ std::vector<VkVertexInputAttributeDescription> CvkModel::Vertex::getAttributeDes
     return attributeDescriptions;
 }
 
+std::vector<VkVertexInputBindingDescription> CvkModel::getPositionBindingDescriptions() {
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(glm::vec3);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    return bindingDescriptions;
+}
+
+std::vector<VkVertexInputAttributeDescription> CvkModel::getPositionAttributeDescriptions() {
+    return {{0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0}};
+}
+
 void CvkModel::Builder::loadModel(const std::string &filepath) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -198,4 +259,24 @@ void CvkModel::Builder::loadModel(const std::string &filepath) {
     }
 }
 
+// The sphere is centered on the AABB, not minimal but cheap and good enough for culling.
+CvkModel::Bounds CvkModel::Builder::computeBounds() const {
+    Bounds result{};
+    if (vertices.empty()) { return result; }
+
+    result.aabbMin = vertices[0].position;
+    result.aabbMax = vertices[0].position;
+    for (const auto &vertex : vertices) {
+        result.aabbMin = glm::min(result.aabbMin, vertex.position);
+        result.aabbMax = glm::max(result.aabbMax, vertex.position);
+    }
+    const glm::vec3 center = (result.aabbMin + result.aabbMax) * .5f;
+    float radius = 0.f;
+    for (const auto &vertex : vertices) {
+        radius = glm::max(radius, glm::length(vertex.position - center));
+    }
+    result.sphere = glm::vec4(center, radius);
+    return result;
+}
+
 } //namespace cvk
\ No newline at end of file
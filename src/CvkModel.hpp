@@ -33,38 +33,78 @@ public:
         }
     };
 
+    // Model space bounds, used for culling.
+    struct Bounds {
+        glm::vec3 aabbMin{0.f};
+        glm::vec3 aabbMax{0.f};
+        glm::vec4 sphere{0.f}; // xyz = center, w = radius
+    };
+
     // Temporary helper object to store Vertex and Index information until it can be copied into memory
     struct Builder {
         std::vector<Vertex> vertices{};
         std::vector<uint32_t> indices{};
 
         void loadModel(const std::string &filepath);
+        Bounds computeBounds() const;
     };
 
-    CvkModel(CvkDevice &device, const CvkModel::Builder &builder);
+    // positionStream also uploads the position-only copy bindPositions() needs, only a depth pre-pass uses it.
+    CvkModel(CvkDevice &device, const CvkModel::Builder &builder, bool positionStream = false);
     ~CvkModel();
     
     CvkModel(const CvkModel &) = delete;
     CvkModel &operator=(const CvkModel &) = delete;
 
-    static std::unique_ptr<CvkModel> createModelFromFile(CvkDevice &device, const std::string &filepathh);
+    // Vertex input of the position stream, a single vec3 at location 0.
+    static std::vector<VkVertexInputBindingDescription> getPositionBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getPositionAttributeDescriptions();
+
+    static std::unique_ptr<CvkModel> createModelFromFile(
+        CvkDevice &device,
+        const std::string &filepathh,
+        bool positionStream = false);
 
     void bind(VkCommandBuffer commandBuffer);
-    void draw(VkCommandBuffer commandBuffer);
+    // Binds the tightly packed position-only copy of the vertices (plus the index buffer), for depth only passes.
+    // The model has to be created with positionStream.
+    void bindPositions(VkCommandBuffer commandBuffer);
+    // firstInstance shows up as gl_InstanceIndex, which the shaders use to index the object buffer.
+    void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+    // Raw access, used when packing several models into one shared geometry buffer.
+    VkBuffer getVertexBuffer() const { return vertexBuffer->getBuffer(); }
+    VkBuffer getIndexBuffer() const { return hasIndexBuffer ? indexBuffer->getBuffer() : VK_NULL_HANDLE; }
+    uint32_t getVertexCount() const { return vertexCount; }
+    uint32_t getIndexCount() const { return indexCount; }
+    bool hasIndices() const { return hasIndexBuffer; }
+
+    // Unique per model, used in render queue sort keys.
+    uint32_t getId() const { return id; }
+
+    const Bounds &getBounds() const { return bounds; }
+    // Model space bounding sphere: xyz = center, w = radius.
+    const glm::vec4 &getBoundingSphere() const { return bounds.sphere; }
 
 private:
     void createVertexBuffers(const std::vector<Vertex> &vertices);
     void createIndexBuffers(const std::vector<uint32_t> &indices);
+    void createPositionBuffers(const std::vector<Vertex> &vertices);
 
     CvkDevice &cvkDevice;
+    uint32_t id;
 
     std::unique_ptr<CvkBuffer> vertexBuffer;
     uint32_t vertexCount;
+    // 12 instead of 44 bytes per vertex, a depth pre-pass only fetches what it needs. Null without positionStream.
+    std::unique_ptr<CvkBuffer> positionBuffer;
 
     std::unique_ptr<CvkBuffer> indexBuffer;
     uint32_t indexCount;
 
     bool hasIndexBuffer = false;
+
+    Bounds bounds{};
 };
 
 } // namespace cvk
\ No newline at end of file
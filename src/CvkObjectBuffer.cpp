@@ -0,0 +1,68 @@
+#include "CvkObjectBuffer.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <algorithm>
+
+namespace cvk {
+
+ObjectData ObjectData::fromGameObject(CvkGameObject &obj) {
+    ObjectData data{};
+    data.modelMatrix = obj.transform.mat4();
+    data.normalMatrix = obj.transform.normalMatrix();
+    data.color = glm::vec4(obj.color, 1.f);
+    data.layerMask = obj.layerMask;
+    data.materialIndex = obj.materialIndex;
+    // color defaults to zero, treat that as "not set" and keep the vertex colors.
+    if (obj.color != glm::vec3(0.f)) { data.flags |= OBJECT_FLAG_USE_OBJECT_COLOR; }
+    return data;
+}
+
+CvkObjectBuffer::CvkObjectBuffer(CvkDevice &device, VkShaderStageFlags stageFlags) : cvkDevice{device} {
+    pool = CvkDescriptorPool::Builder(cvkDevice)
+        .setMaxSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+    setLayout = CvkDescriptorSetLayout::Builder(cvkDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stageFlags)
+        .build();
+
+    descriptorSets.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    buffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < CvkSwapchain::MAX_FRAMES_IN_FLIGHT; i++) {
+        ensureCapacity(i, 1);
+    }
+}
+
+ObjectData *CvkObjectBuffer::map(int frameIndex, uint32_t objectCount) {
+    ensureCapacity(frameIndex, std::max(objectCount, 1u));
+    return static_cast<ObjectData*>(buffers[frameIndex]->getMappedMemory());
+}
+
+// Grows by doubling, the old buffer is no longer in use once that frame's fence was waited on.
+void CvkObjectBuffer::ensureCapacity(int frameIndex, uint32_t objectCount) {
+    auto &buffer = buffers[frameIndex];
+    if (buffer && buffer->getInstanceCount() >= objectCount) { return; }
+
+    uint32_t capacity = buffer ? buffer->getInstanceCount() : 1;
+    while (capacity < objectCount) { capacity *= 2; }
+    // HOST_COHERENT, since the whole buffer is rewritten every frame anyways.
+    buffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        sizeof(ObjectData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer->map();
+
+    auto bufferInfo = buffer->descriptorInfo();
+    CvkDescriptorWriter writer(*setLayout, *pool);
+    writer.writeBuffer(0, &bufferInfo);
+    if (descriptorSets[frameIndex] == VK_NULL_HANDLE) {
+        writer.build(descriptorSets[frameIndex]);
+    } else {
+        writer.overwrite(descriptorSets[frameIndex]);
+    }
+}
+
+} // namespace cvk
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "CvkBuffer.hpp"
+#include "CvkDescriptors.hpp"
+#include "CvkDevice.hpp"
+#include "CvkGameObject.hpp"
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace cvk {
+
+// Bits of ObjectData::flags
+enum ObjectFlags : uint32_t {
+    OBJECT_FLAG_USE_OBJECT_COLOR = 1u << 0, // shade with ObjectData::color instead of the vertex colors
+};
+
+// Per object data as the shaders see it (std430, 160 byte stride). Must match ObjectData in
+// shaders/simple_shader.vert, shaders/indirect_shader.vert and shaders/cull.comp.
+struct ObjectData {
+    glm::mat4 modelMatrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+    glm::vec4 color{1.f};
+    uint32_t flags{0};
+    uint32_t meshIndex{0}; // only used by IndirectRenderSystem
+    uint32_t layerMask{0}; // see CvkLayerAnimation
+    uint32_t materialIndex{0}; // into MasterRenderSystem's material buffer, only read in bindless mode
+
+    static ObjectData fromGameObject(CvkGameObject &obj);
+};
+static_assert(sizeof(ObjectData) == 160, "ObjectData has to match the std430 layout in the shaders");
+
+/*
+Per-frame storage buffer of ObjectData, one descriptor set (a single storage buffer at binding 0) per frame
+in flight. Shaders index it with gl_InstanceIndex, so a draw selects its object through firstInstance and
+nothing per object has to go through push constants anymore.
+*/
+class CvkObjectBuffer {
+public:
+    CvkObjectBuffer(CvkDevice &device, VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT);
+
+    CvkObjectBuffer(const CvkObjectBuffer &) = delete;
+    CvkObjectBuffer &operator=(const CvkObjectBuffer &) = delete;
+
+    // Makes room for objectCount objects in this frame's buffer and returns its mapped memory.
+    // May replace the buffer, so call it before the frame's descriptor set is bound.
+    ObjectData *map(int frameIndex, uint32_t objectCount);
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+
+private:
+    void ensureCapacity(int frameIndex, uint32_t objectCount);
+
+    CvkDevice &cvkDevice;
+
+    std::unique_ptr<CvkDescriptorPool> pool;
+    std::unique_ptr<CvkDescriptorSetLayout> setLayout;
+    std::vector<VkDescriptorSet> descriptorSets;
+    std::vector<std::unique_ptr<CvkBuffer>> buffers;
+};
+
+} // namespace cvk
@@ -0,0 +1,105 @@
+#include "CvkParallelRecorder.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace cvk {
+
+// Below this many items per chunk the cost of an extra secondary buffer outweighs the parallelism.
+static constexpr uint32_t MIN_ITEMS_PER_CHUNK = 64;
+// A few chunks per thread, so one slow chunk doesn't leave the other workers idle.
+static constexpr uint32_t CHUNKS_PER_THREAD = 2;
+
+CvkParallelRecorder::CvkParallelRecorder(CvkDevice &device, CvkThreadPool &threadPool)
+: cvkDevice{device}, threadPool{threadPool} {
+    QueueFamilyIndices queueFamilyIndices = cvkDevice.findPhysicalQueueFamilies();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    frameData.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    for (auto &threads : frameData) {
+        threads.resize(threadPool.getThreadCount());
+        for (auto &threadData : threads) {
+            if (vkCreateCommandPool(cvkDevice.device(), &poolInfo, nullptr, &threadData.commandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create worker command pool!");
+            }
+        }
+    }
+}
+
+CvkParallelRecorder::~CvkParallelRecorder() {
+    // Destroying a pool frees its command buffers as well.
+    for (auto &threads : frameData) {
+        for (auto &threadData : threads) {
+            vkDestroyCommandPool(cvkDevice.device(), threadData.commandPool, nullptr);
+        }
+    }
+}
+
+uint32_t CvkParallelRecorder::getChunkCount(uint32_t itemCount) const {
+    const uint32_t maxChunks = threadPool.getThreadCount() * CHUNKS_PER_THREAD;
+    const uint32_t wantedChunks = (itemCount + MIN_ITEMS_PER_CHUNK - 1) / MIN_ITEMS_PER_CHUNK;
+    return std::max(1u, std::min(maxChunks, wantedChunks));
+}
+
+VkCommandBuffer CvkParallelRecorder::acquireCommandBuffer(ThreadFrameData &threadData) {
+    if (threadData.usedCount == threadData.commandBuffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandPool = threadData.commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(cvkDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        threadData.commandBuffers.push_back(commandBuffer);
+    }
+    return threadData.commandBuffers[threadData.usedCount++];
+}
+
+const std::vector<VkCommandBuffer> &CvkParallelRecorder::record(
+int frameIndex,
+const VkCommandBufferInheritanceInfo &inheritanceInfo,
+uint32_t itemCount,
+const RecordFn &recordFn) {
+    auto &threads = frameData[frameIndex];
+    for (auto &threadData : threads) {
+        vkResetCommandPool(cvkDevice.device(), threadData.commandPool, 0);
+        threadData.usedCount = 0;
+    }
+
+    const uint32_t chunkCount = getChunkCount(itemCount);
+    const uint32_t chunkSize = (itemCount + chunkCount - 1) / chunkCount;
+    chunkCommandBuffers.assign(chunkCount, VK_NULL_HANDLE);
+
+    threadPool.run(chunkCount, [&](uint32_t threadIndex, uint32_t chunkIndex) {
+        VkCommandBuffer commandBuffer = acquireCommandBuffer(threads[threadIndex]);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+
+        const uint32_t begin = std::min(itemCount, chunkIndex * chunkSize);
+        const uint32_t end = std::min(itemCount, begin + chunkSize);
+        recordFn(commandBuffer, chunkIndex, begin, end);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+        }
+        chunkCommandBuffers[chunkIndex] = commandBuffer;
+    });
+    return chunkCommandBuffers;
+}
+
+} // namespace cvk
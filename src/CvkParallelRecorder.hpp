@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+#include "CvkThreadPool.hpp"
+
+// std
+#include <functional>
+#include <vector>
+
+namespace cvk {
+
+/*
+Records a range of work into secondary command buffers on a CvkThreadPool. Command pools are not thread
+safe, so every worker thread gets its own VkCommandPool per frame in flight. A frame's pools are reset as a
+whole at the start of its recording, which is fine since beginFrame already waited on that frame's fence.
+*/
+class CvkParallelRecorder {
+public:
+    // Records items [begin, end) into commandBuffer, which is already begun as a render pass continuation.
+    using RecordFn = std::function<void(VkCommandBuffer commandBuffer, uint32_t chunkIndex, uint32_t begin, uint32_t end)>;
+
+    CvkParallelRecorder(CvkDevice &device, CvkThreadPool &threadPool);
+    ~CvkParallelRecorder();
+
+    CvkParallelRecorder(const CvkParallelRecorder &) = delete;
+    CvkParallelRecorder &operator=(const CvkParallelRecorder &) = delete;
+
+    // How many chunks record() will split itemCount items into, so callers can size per-chunk scratch data.
+    uint32_t getChunkCount(uint32_t itemCount) const;
+
+    // Splits [0, itemCount) into chunks and records each one into its own secondary command buffer.
+    // Returns the buffers in chunk order, ready for vkCmdExecuteCommands.
+    const std::vector<VkCommandBuffer> &record(
+        int frameIndex,
+        const VkCommandBufferInheritanceInfo &inheritanceInfo,
+        uint32_t itemCount,
+        const RecordFn &recordFn);
+
+private:
+    struct ThreadFrameData {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> commandBuffers; // allocated on demand, reused every frame
+        uint32_t usedCount = 0;
+    };
+
+    VkCommandBuffer acquireCommandBuffer(ThreadFrameData &threadData);
+
+    CvkDevice &cvkDevice;
+    CvkThreadPool &threadPool;
+
+    std::vector<std::vector<ThreadFrameData>> frameData; // [frameIndex][threadIndex]
+    std::vector<VkCommandBuffer> chunkCommandBuffers;
+};
+
+} // namespace cvk
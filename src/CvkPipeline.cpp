@@ -1,59 +1,146 @@
 #include "CvkPipeline.hpp"
+#include "CvkPipelineBuilder.hpp"
+#include "CvkPipelineLibrary.hpp"
+#include "CvkShaderLibrary.hpp"
 #include "CvkModel.hpp"
 
 //std
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
-#include <fstream>
 #include <cassert>
+#include <cstring>
+#include <exception>
 
 namespace cvk {
 
+SpecializationConstants &SpecializationConstants::setUint(uint32_t constantId, uint32_t value) {
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].constantID == constantId) {
+            values[i] = value;
+            return *this;
+        }
+    }
+    entries.push_back({constantId, static_cast<uint32_t>(values.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+    values.push_back(value);
+    return *this;
+}
+
+SpecializationConstants &SpecializationConstants::setFloat(uint32_t constantId, float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return setUint(constantId, bits);
+}
+
+VkSpecializationInfo SpecializationConstants::info() const {
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specializationInfo.pMapEntries = entries.data();
+    specializationInfo.dataSize = values.size() * sizeof(uint32_t);
+    specializationInfo.pData = values.data();
+    return specializationInfo;
+}
+
+std::vector<uint32_t> SpecializationConstants::key() const {
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (size_t i = 0; i < entries.size(); i++) {
+        pairs.emplace_back(entries[i].constantID, values[i]);
+    }
+    std::sort(pairs.begin(), pairs.end());
+    std::vector<uint32_t> result;
+    for (auto &pair : pairs) {
+        result.push_back(pair.first);
+        result.push_back(pair.second);
+    }
+    return result;
+}
+
+SpecializationConstants SpecializationConstants::fromKey(const std::vector<uint32_t> &key) {
+    SpecializationConstants constants;
+    for (size_t i = 0; i + 1 < key.size(); i += 2) {
+        constants.setUint(key[i], key[i + 1]);
+    }
+    return constants;
+}
+
 CvkPipeline::CvkPipeline(
     CvkDevice& device,
     const std::string&vertFilepath,
     const std::string&fragFilepath,
-    const PipelineConfigInfo& configInfo) : cvkDevice{device} {
-        createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+    const PipelineConfigInfo& configInfo) : CvkPipeline(device, vertFilepath, fragFilepath, configInfo, reserveId()) {}
+
+CvkPipeline::CvkPipeline(
+    CvkDevice& device,
+    const std::string&vertFilepath,
+    const std::string&fragFilepath,
+    const PipelineConfigInfo& configInfo,
+    uint32_t id) : cvkDevice{device}, id{id} {
+        graphicsPipeline = createGraphicsPipeline(cvkDevice, vertFilepath, fragFilepath, configInfo);
 }
 
-CvkPipeline::~CvkPipeline() {
-    vkDestroyShaderModule(cvkDevice.device(), vertShaderModule, nullptr);
-    vkDestroyShaderModule(cvkDevice.device(), fragShaderModule, nullptr);
-    vkDestroyPipeline(cvkDevice.device(), graphicsPipeline, nullptr);
+CvkPipeline::CvkPipeline(CvkDevice& device, VkPipeline pipeline, uint32_t id)
+: cvkDevice{device}, id{id}, graphicsPipeline{pipeline} {}
+
+static std::atomic<uint32_t> replaceCount{0};
+
+uint32_t CvkPipeline::getReplaceCount() {
+    return replaceCount.load();
 }
 
-std::vector<char> CvkPipeline::readFile(const std::string& filepath) {
-    // 'ate' takes it to the end of file, makes it easier to know the size of the file 
-    std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-    if(!file.is_open()) {
-        throw std::runtime_error("Failed to open file: "+filepath);
+uint32_t CvkPipeline::reserveId() {
+    static std::atomic<uint32_t> nextId{0};
+    return nextId++;
+}
+
+CvkPipeline::~CvkPipeline() {
+    vkDestroyPipeline(cvkDevice.device(), graphicsPipeline.load(), nullptr);
+    for (VkPipeline pipeline : replacedPipelines) {
+        vkDestroyPipeline(cvkDevice.device(), pipeline, nullptr);
     }
-    // get size and create a buffer with that size to store the file data
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
+}
 
-    // then go back to start and then read file
-    file.seekg(0);
-    file.read(buffer.data(),fileSize);
-    file.close();
-    return buffer;
+void CvkPipeline::replacePipeline(VkPipeline pipeline, uint32_t generation) {
+    std::lock_guard<std::mutex> lock{replaceMutex};
+    if (generation < this->generation) {
+        // e.g. an optimized link of the old shaders that finished after the reload, it was never bound.
+        vkDestroyPipeline(cvkDevice.device(), pipeline, nullptr);
+        return;
+    }
+    this->generation = generation;
+    // Only freed with this, each reload keeps one more pipeline around. Fine for the few edits of a session.
+    replacedPipelines.push_back(graphicsPipeline.exchange(pipeline));
+    replaceCount++;
 }
-void CvkPipeline::createGraphicsPipeline(
+
+VkPipeline CvkPipeline::createGraphicsPipeline(
+    CvkDevice& cvkDevice,
     const std::string& vertFilepath,
     const std::string& fragFilepath,
     const PipelineConfigInfo& configInfo) {
 
     assert(configInfo.pipelineLayout != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no pipelineLayout provided in  configInfo");
-    assert(configInfo.renderPass != VK_NULL_HANDLE && "Cannot create graphics pipeline:: no renderPass provided in  configInfo");
+    assert((configInfo.renderPass != VK_NULL_HANDLE || !configInfo.colorAttachmentFormats.empty() ||
+        configInfo.depthAttachmentFormat != VK_FORMAT_UNDEFINED) &&
+        "Cannot create graphics pipeline:: no renderPass or attachment formats provided in  configInfo");
     
-    auto vertCode = readFile(vertFilepath);
-    auto fragCode = readFile(fragFilepath);
-
-    // std::cout<<"VS size : "<<vertCode.size()<<"\n";
-    // std::cout<<"FS size : "<<fragCode.size()<<"\n";
+    // Only needed until the pipeline exists, released again at the end of this function.
+    CvkShaderLibrary &shaderLibrary = cvkDevice.shaderLibrary();
+    VkShaderModule vertShaderModule = shaderLibrary.acquire(vertFilepath, configInfo.defines);
+    VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+    const bool hasFragmentStage = !fragFilepath.empty();
+    if (hasFragmentStage) {
+        try {
+            fragShaderModule = shaderLibrary.acquire(fragFilepath, configInfo.defines);
+        } catch (...) {
+            shaderLibrary.release(vertShaderModule);
+            throw;
+        }
+    }
 
-    createShaderModule(vertCode, &vertShaderModule);
-    createShaderModule(fragCode, &fragShaderModule);
+    const VkSpecializationInfo specializationInfo = configInfo.specialization.info();
+    const VkSpecializationInfo *pSpecializationInfo =
+        configInfo.specialization.empty() ? nullptr : &specializationInfo;
 
     VkPipelineShaderStageCreateInfo shaderStages[2];
     
@@ -63,7 +150,7 @@ void CvkPipeline::createGraphicsPipeline(
     shaderStages[0].pName = "main";
     shaderStages[0].flags = 0;
     shaderStages[0].pNext = nullptr;
-    shaderStages[0].pSpecializationInfo = nullptr;
+    shaderStages[0].pSpecializationInfo = pSpecializationInfo;
     
     shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -71,10 +158,10 @@ void CvkPipeline::createGraphicsPipeline(
     shaderStages[1].pName = "main";
     shaderStages[1].flags = 0;
     shaderStages[1].pNext = nullptr;
-    shaderStages[1].pSpecializationInfo = nullptr;
+    shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
-    auto bindingDescriptions = CvkModel::Vertex::getBindingDescriptions();
-    auto attributeDescriptions = CvkModel::Vertex::getAttributeDescriptions();
+    auto &bindingDescriptions = configInfo.bindingDescriptions;
+    auto &attributeDescriptions = configInfo.attributeDescriptions;
     VkPipelineVertexInputStateCreateInfo vertexInputInfo {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -85,14 +172,14 @@ void CvkPipeline::createGraphicsPipeline(
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     // Specifies how many programmable stages (and which stages) our pipeline will use
-    pipelineInfo.stageCount = 2;
+    pipelineInfo.stageCount = hasFragmentStage ? 2 : 1;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
     pipelineInfo.pViewportState = &configInfo.viewportInfo;
     pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
     pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-    // pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+    pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
     pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
     pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
@@ -100,27 +187,36 @@ void CvkPipeline::createGraphicsPipeline(
     pipelineInfo.renderPass = configInfo.renderPass;
     pipelineInfo.subpass = configInfo.subpass;
 
+    // Without a render pass the formats are all there is to be compatible with.
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    if (configInfo.renderPass == VK_NULL_HANDLE) {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+        renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+        renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+        pipelineInfo.pNext = &renderingInfo;
+    }
+
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; 
 
-    if(vkCreateGraphicsPipelines(cvkDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    auto startTime = std::chrono::steady_clock::now();
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(cvkDevice.device(), cvkDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &pipeline);
+    shaderLibrary.release(vertShaderModule);
+    if (hasFragmentStage) { shaderLibrary.release(fragShaderModule); }
+    if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to create Graphics Pipeline.");
     }
-}
-
-void CvkPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-    VkShaderModuleCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data()); // Vulkan expects uint32 and not a char array
-
-    if (vkCreateShaderModule(cvkDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create shader module");
-    }
+    auto endTime = std::chrono::steady_clock::now();
+    cvkDevice.reportPipelineCreation(
+        fragFilepath.empty() ? vertFilepath : vertFilepath + " + " + fragFilepath,
+        std::chrono::duration<double, std::milli>(endTime - startTime).count());
+    return pipeline;
 }
 
 void CvkPipeline::bind(VkCommandBuffer commandBuffer) {
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.load());
 }
 
 void CvkPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -180,7 +276,7 @@ void CvkPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
     configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
     configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;              // Optional
 
-    /* ! Not covered yet, added due to validation error
+    // ! Not covered yet, added due to validation error
     configInfo.colorBlendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     configInfo.colorBlendInfo.logicOpEnable = VK_FALSE;
     configInfo.colorBlendInfo.logicOp = VK_LOGIC_OP_COPY;  // Optional
@@ -190,7 +286,6 @@ void CvkPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
     configInfo.colorBlendInfo.blendConstants[1] = 0.0f;  // Optional
     configInfo.colorBlendInfo.blendConstants[2] = 0.0f;  // Optional
     configInfo.colorBlendInfo.blendConstants[3] = 0.0f;  // Optional
-    */
 
     // Depth testing
     configInfo.depthStencilInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
@@ -209,6 +304,184 @@ void CvkPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
     configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
     configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
     configInfo.dynamicStateInfo.flags = 0;
+
+    configInfo.bindingDescriptions = CvkModel::Vertex::getBindingDescriptions();
+    configInfo.attributeDescriptions = CvkModel::Vertex::getAttributeDescriptions();
+}
+
+void CvkPipeline::depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+    defaultPipelineConfigInfo(configInfo);
+    configInfo.bindingDescriptions = CvkModel::getPositionBindingDescriptions();
+    configInfo.attributeDescriptions = CvkModel::getPositionAttributeDescriptions();
+    // The color attachment is still part of the subpass, it just never gets written.
+    configInfo.colorBlendAttachment.colorWriteMask = 0;
+}
+
+void CvkPipeline::fullscreenPipelineConfigInfo(PipelineConfigInfo& configInfo) {
+    defaultPipelineConfigInfo(configInfo);
+    configInfo.bindingDescriptions.clear();
+    configInfo.attributeDescriptions.clear();
+    configInfo.depthStencilInfo.depthTestEnable = VK_FALSE;
+    configInfo.depthStencilInfo.depthWriteEnable = VK_FALSE;
+}
+
+CvkPipelineVariants::CvkPipelineVariants(
+CvkDevice &device,
+const std::string &vertFilepath,
+const std::string &fragFilepath,
+ConfigFunction configure,
+CvkPipelineBuilder *builder)
+: cvkDevice{device},
+  vertFilepath{vertFilepath},
+  fragFilepath{fragFilepath},
+  configure{std::move(configure)},
+  builder{builder} {
+    if (builder == nullptr) { return; }
+    if (builder->usesPipelineLibrary()) {
+        library = std::make_unique<CvkPipelineLibrary>(cvkDevice, vertFilepath, fragFilepath, this->configure);
+    }
+    builder->watch(this);
+}
+
+CvkPipelineVariants::~CvkPipelineVariants() {
+    if (builder == nullptr) { return; }
+    builder->unwatch(this);
+    // The tasks still point at the libraries and the pipelines, shader parts nobody linked yet included.
+    for (auto &entry : pending) {
+        if (library) {
+            try { builder->wait(entry.second.handle); } catch (...) {}
+        } else {
+            builder->discard(entry.second.handle);
+        }
+    }
+    for (uint32_t handle : backgroundTasks) {
+        // A failed optimization just means the fast linked pipeline stays.
+        try { builder->wait(handle); } catch (...) {}
+    }
+}
+
+CvkPipeline &CvkPipelineVariants::get(const SpecializationConstants &constants) {
+    auto key = constants.key();
+    auto variant = variants.find(key);
+    if (variant != variants.end()) { return *variant->second; }
+
+    std::unique_ptr<CvkPipeline> pipeline;
+    if (library) {
+        prefetch(constants);
+        auto variant = pending.find(key);
+        const PendingVariant compiling = variant->second;
+        pending.erase(variant);
+        builder->wait(compiling.handle);
+        pipeline = library->link(constants, compiling.pipelineId);
+
+        CvkPipeline *linked = pipeline.get();
+        CvkPipelineLibrary *parts = library.get();
+        const uint32_t generation = shaderGeneration;
+        backgroundTasks.push_back(builder->submitTask([parts, linked, constants, generation] {
+            linked->replacePipeline(parts->linkOptimized(constants), generation);
+        }));
+    } else if (builder != nullptr) {
+        prefetch(constants);
+        auto variant = pending.find(key);
+        const uint32_t handle = variant->second.handle;
+        pending.erase(variant);
+        pipeline = builder->take(handle);
+    } else {
+        PipelineConfigInfo configInfo{};
+        configure(configInfo);
+        configInfo.specialization = constants;
+        pipeline = std::make_unique<CvkPipeline>(cvkDevice, vertFilepath, fragFilepath, configInfo);
+    }
+    CvkPipeline &result = *pipeline;
+    variants.emplace(std::move(key), std::move(pipeline));
+    return result;
+}
+
+CvkPipeline *CvkPipelineVariants::tryGet(const SpecializationConstants &constants) {
+    auto key = constants.key();
+    auto variant = variants.find(key);
+    if (variant != variants.end()) { return variant->second.get(); }
+    if (builder == nullptr) { return &get(constants); }
+
+    prefetch(constants);
+    if (!builder->isReady(pending.at(key).handle)) { return nullptr; }
+    return &get(constants);
+}
+
+void CvkPipelineVariants::prefetch(const SpecializationConstants &constants) {
+    if (builder == nullptr) { return; }
+    auto key = constants.key();
+    if (variants.count(key) != 0 || pending.count(key) != 0) { return; }
+    if (library) {
+        CvkPipelineLibrary *parts = library.get();
+        const uint32_t handle = builder->submitTask([parts, constants] { parts->compileShaders(constants); });
+        pending.emplace(std::move(key), PendingVariant{handle, CvkPipeline::reserveId()});
+    } else {
+        pending.emplace(std::move(key), PendingVariant{builder->submit({vertFilepath, fragFilepath, configure, constants}), 0});
+    }
+}
+
+void CvkPipelineVariants::releaseFinishedTasks() {
+    // Every reload adds tasks, the finished ones are waited for so the builder can let go of them.
+    auto finished = std::remove_if(backgroundTasks.begin(), backgroundTasks.end(), [this](uint32_t handle) {
+        if (!builder->isReady(handle)) { return false; }
+        try { builder->wait(handle); } catch (...) {}
+        return true;
+    });
+    backgroundTasks.erase(finished, backgroundTasks.end());
+}
+
+void CvkPipelineVariants::reloadShaders(const std::vector<std::string> &changedSources) {
+    const bool changed = std::any_of(changedSources.begin(), changedSources.end(), [this](const std::string &filepath) {
+        return usesShader(filepath);
+    });
+    if (builder == nullptr || !changed) { return; }
+    releaseFinishedTasks();
+
+    const uint32_t generation = ++shaderGeneration;
+    if (library) {
+        // Its shader parts are compiled from the old code. Linking only needs the parts that aren't shaders, so
+        // those are built again right here, that is quick.
+        retiredLibraries.push_back(std::move(library));
+        library = std::make_unique<CvkPipelineLibrary>(cvkDevice, vertFilepath, fragFilepath, configure);
+    }
+
+    // Variants still compiling may have read the old code, they start over.
+    for (auto &entry : pending) {
+        const SpecializationConstants constants = SpecializationConstants::fromKey(entry.first);
+        if (library) {
+            backgroundTasks.push_back(entry.second.handle);
+            CvkPipelineLibrary *parts = library.get();
+            entry.second.handle = builder->submitTask([parts, constants] { parts->compileShaders(constants); });
+        } else {
+            // Nobody takes the old pipeline anymore, the builder destroys it once it's built.
+            builder->discard(entry.second.handle);
+            entry.second.handle = builder->submit({vertFilepath, fragFilepath, configure, constants});
+        }
+    }
+
+    CvkPipelineLibrary *parts = library.get();
+    for (auto &entry : variants) {
+        CvkPipeline *pipeline = entry.second.get();
+        const SpecializationConstants constants = SpecializationConstants::fromKey(entry.first);
+        backgroundTasks.push_back(builder->submitTask([this, parts, pipeline, constants, generation] {
+            try {
+                if (parts != nullptr) {
+                    pipeline->replacePipeline(parts->linkOptimized(constants), generation);
+                } else {
+                    PipelineConfigInfo configInfo{};
+                    configure(configInfo);
+                    configInfo.specialization = constants;
+                    pipeline->replacePipeline(
+                        CvkPipeline::createGraphicsPipeline(cvkDevice, vertFilepath, fragFilepath, configInfo),
+                        generation);
+                }
+            } catch (const std::exception &e) {
+                // A typo in a shader shouldn't take the app down, it keeps drawing with what it had.
+                std::cerr << "Shader reload failed, keeping the old pipeline: " << e.what() << "\n";
+            }
+        }));
+    }
 }
 
-} // namespace cvk
\ No newline at end of file
+} // namespace cvk
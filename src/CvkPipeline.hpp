@@ -1,18 +1,49 @@
 #pragma once
 
 #include "CvkDevice.hpp"
+#include "CvkShaderCompiler.hpp"
 
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace cvk {
 
+class CvkPipelineBuilder;
+class CvkPipelineLibrary;
+
+// Values for the shaders' layout(constant_id = N) constants. All of them are 32-bit (bool, int, uint and float
+// are in GLSL), and every stage gets the same set, a stage just ignores the ids it doesn't declare.
+class SpecializationConstants {
+public:
+    SpecializationConstants &setUint(uint32_t constantId, uint32_t value);
+    SpecializationConstants &setBool(uint32_t constantId, bool value) { return setUint(constantId, value ? VK_TRUE : VK_FALSE); }
+    SpecializationConstants &setFloat(uint32_t constantId, float value);
+
+    bool empty() const { return entries.empty(); }
+    // Points into this object, so it has to outlive the pipeline creation.
+    VkSpecializationInfo info() const;
+    // (id, value) pairs sorted by id, equal keys build identical pipelines.
+    std::vector<uint32_t> key() const;
+    static SpecializationConstants fromKey(const std::vector<uint32_t> &key);
+private:
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<uint32_t> values;
+};
+
 // Need this outside the pipeline class so that the Application has full control and shareability.
 struct PipelineConfigInfo {
     PipelineConfigInfo() = default;
     PipelineConfigInfo(const PipelineConfigInfo&) = delete;
     PipelineConfigInfo &operator=(const PipelineConfigInfo&) = delete;
 
+    // Filled with CvkModel::Vertex by defaultPipelineConfigInfo, depth only pipelines just take the position stream.
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
     VkPipelineViewportStateCreateInfo viewportInfo;
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
     VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -25,34 +56,159 @@ struct PipelineConfigInfo {
     VkPipelineLayout pipelineLayout = nullptr;
     VkRenderPass renderPass = nullptr;
     uint32_t subpass = 0;
+    // Dynamic rendering (renderPass left null): the pipeline only needs to know the attachment formats.
+    std::vector<VkFormat> colorAttachmentFormats{};
+    VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    // Resolved when the pipeline is compiled, branches on them cost nothing in the shaders.
+    SpecializationConstants specialization{};
+    // For both stages, for variants constants can't express (different inputs, extensions). Needs CVK_HAS_SHADERC.
+    ShaderDefines defines{};
+};
+
+// Fills in a PipelineConfigInfo. Pipelines that are built later or elsewhere (CvkPipelineVariants,
+// CvkPipelineBuilder) keep one of these instead, since the config itself can't be copied.
+using PipelineConfigFunction = std::function<void(PipelineConfigInfo &)>;
+
+// What a render system's pipelines draw into, so the systems don't care whether that is a VkRenderPass or,
+// with VK_KHR_dynamic_rendering, a set of attachment formats.
+struct PipelineRenderTarget {
+    VkRenderPass renderPass = VK_NULL_HANDLE; // null with dynamic rendering
+    std::vector<VkFormat> colorFormats{};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+
+    void apply(PipelineConfigInfo &configInfo) const {
+        configInfo.renderPass = renderPass;
+        configInfo.colorAttachmentFormats = colorFormats;
+        configInfo.depthAttachmentFormat = depthFormat;
+    }
 };
 
 class CvkPipeline {
 public:
+    // The shaders are GLSL sources, see CvkShaderLibrary. fragFilepath may be empty for depth only pipelines, those
+    // don't need a fragment shader at all.
     CvkPipeline(
         CvkDevice& device,
         const std::string&vertFilepath,
         const std::string&fragFilepath,
         const PipelineConfigInfo& configInfo);
+    // Takes an id from reserveId(), for pipelines that are built out of order (see CvkPipelineBuilder) but should
+    // still sort in the order they were asked for.
+    CvkPipeline(
+        CvkDevice& device,
+        const std::string&vertFilepath,
+        const std::string&fragFilepath,
+        const PipelineConfigInfo& configInfo,
+        uint32_t id);
+    // Takes over a pipeline created elsewhere, e.g. linked by CvkPipelineLibrary.
+    CvkPipeline(CvkDevice& device, VkPipeline pipeline, uint32_t id);
 
     ~CvkPipeline();
     CvkPipeline(const CvkPipeline&) = delete;
     CvkPipeline &operator=(const CvkPipeline&) = delete;
 
     void bind(VkCommandBuffer commandBuffer);
+    // Swaps in another pipeline from any thread, later binds pick it up: the link time optimized one (see
+    // CvkPipelineLibrary), or one built from reloaded shaders. The old one lives on until this is destroyed, recorded
+    // commands may use it. A pipeline of an older generation than the current one is stale and destroyed instead.
+    void replacePipeline(VkPipeline pipeline, uint32_t generation = 0);
+    // Counts the pipelines replacePipeline() swapped in, across all of them. When it moved, commands recorded
+    // before still bind the old ones and have to be recorded again. Thread safe.
+    static uint32_t getReplaceCount();
+    // Unique per pipeline, used in render queue sort keys.
+    uint32_t getId() const { return id; }
+    // Thread safe.
+    static uint32_t reserveId();
     static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
-private:
-    static std::vector<char> readFile(const std::string& filepath);
-    void createGraphicsPipeline(
+    // Default config, but only reads CvkModel positions (see CvkModel::bindPositions) and never writes color.
+    static void depthOnlyPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // No vertex input and no depth test, for a single triangle generated from gl_VertexIndex that covers the screen.
+    static void fullscreenPipelineConfigInfo(PipelineConfigInfo& configInfo);
+    // Just the VkPipeline, for replacePipeline().
+    static VkPipeline createGraphicsPipeline(
+        CvkDevice& cvkDevice,
         const std::string& vertFilepath,
         const std::string& fragFilepath,
         const PipelineConfigInfo& configInfo);
-    
-    void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+private:
     CvkDevice& cvkDevice;
-    VkPipeline graphicsPipeline;
-    VkShaderModule vertShaderModule;
-    VkShaderModule fragShaderModule;
+    uint32_t id;
+    std::atomic<VkPipeline> graphicsPipeline{VK_NULL_HANDLE};
+    std::mutex replaceMutex;
+    uint32_t generation = 0;
+    std::vector<VkPipeline> replacedPipelines;
+};
+
+/*
+Pipelines of one shader pair that only differ in their specialization constants. A variant is compiled the first
+time its constants are asked for and kept from then on, so feature toggles become separate, branch-free pipelines
+without a GLSL file per combination. Every variant gets its own CvkPipeline id.
+
+With a CvkPipelineBuilder, prefetch() starts compiling a variant on the builder's threads and returns right away,
+get() blocks until it is done and tryGet() doesn't. Without one everything is built on the calling thread.
+
+If the builder uses pipeline libraries, prefetch() only compiles the variant's shader parts (see CvkPipelineLibrary)
+and get() links them, which is quick enough to happen in the frame loop. The link time optimized pipeline is then
+built on the builder and swapped in when done.
+
+With a builder the variants also follow edits to their shaders, see reloadShaders().
+*/
+class CvkPipelineVariants {
+public:
+    // Fills the config shared by every variant, the constants are set on top of it.
+    using ConfigFunction = PipelineConfigFunction;
+
+    // builder has to outlive this.
+    CvkPipelineVariants(
+        CvkDevice &device,
+        const std::string &vertFilepath,
+        const std::string &fragFilepath,
+        ConfigFunction configure,
+        CvkPipelineBuilder *builder = nullptr);
+
+    // Waits for the optimized links still running on the builder.
+    ~CvkPipelineVariants();
+
+    CvkPipelineVariants(const CvkPipelineVariants &) = delete;
+    CvkPipelineVariants &operator=(const CvkPipelineVariants &) = delete;
+
+    CvkPipeline &get(const SpecializationConstants &constants);
+    // nullptr while the variant is still compiling on the builder, so the caller can draw with something else.
+    // Prefetches the variant if nobody did yet.
+    CvkPipeline *tryGet(const SpecializationConstants &constants);
+    // Nothing to do without a builder, get() will build the variant when it is needed.
+    void prefetch(const SpecializationConstants &constants);
+    // If one of the shaders is in changedSources, every variant is rebuilt on the builder from the new code and swapped
+    // into the CvkPipeline it already has, so the frame loop keeps drawing with the old one until then. If the new code
+    // doesn't compile that is printed and the old pipelines stay. Called by CvkPipelineBuilder::reloadChangedShaders.
+    void reloadShaders(const std::vector<std::string> &changedSources);
+    bool usesShader(const std::string &filepath) const {
+        return filepath == vertFilepath || (!fragFilepath.empty() && filepath == fragFilepath);
+    }
+    size_t size() const { return variants.size(); }
+private:
+    void releaseFinishedTasks();
+
+    CvkDevice &cvkDevice;
+    std::string vertFilepath;
+    std::string fragFilepath;
+    ConfigFunction configure;
+    CvkPipelineBuilder *builder;
+    std::unique_ptr<CvkPipelineLibrary> library; // only if the builder uses pipeline libraries
+    std::map<std::vector<uint32_t>, std::unique_ptr<CvkPipeline>> variants;
+
+    // Variants being built. handle is a CvkPipelineBuilder::Handle, of the pipeline itself or with a library of the
+    // task compiling its shader parts. In the latter case the id is reserved here, the pipeline is made by get().
+    struct PendingVariant {
+        uint32_t handle;
+        uint32_t pipelineId;
+    };
+    std::map<std::vector<uint32_t>, PendingVariant> pending;
+    // Builder handles of the tasks that point at the variants or a library: optimized links, reloads, and shader parts
+    // of retired libraries that were still compiling.
+    std::vector<uint32_t> backgroundTasks;
+    uint32_t shaderGeneration = 0; // bumped by every reload, see CvkPipeline::replacePipeline
+    std::vector<std::unique_ptr<CvkPipelineLibrary>> retiredLibraries; // compiled from old code, tasks may still use them
 };
 
 } // namespace cvk
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "CvkPipelineBuilder.hpp"
+#include "CvkShaderLibrary.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace cvk {
+
+CvkPipelineBuilder::CvkPipelineBuilder(CvkDevice &device, uint32_t threadCount, bool pipelineLibrary)
+: cvkDevice{device}, pipelineLibrary{pipelineLibrary && device.supportsGraphicsPipelineLibrary()} {
+    if (threadCount == 0) {
+        threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&CvkPipelineBuilder::workerLoop, this);
+    }
+}
+
+CvkPipelineBuilder::~CvkPipelineBuilder() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+        queue.clear();
+    }
+    wakeCondition.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+CvkPipelineBuilder::Handle CvkPipelineBuilder::submit(Request request) {
+    auto job = std::make_unique<Job>();
+    job->request = std::move(request);
+    job->pipelineId = CvkPipeline::reserveId();
+    return enqueue(std::move(job));
+}
+
+CvkPipelineBuilder::Handle CvkPipelineBuilder::submitTask(Task task) {
+    auto job = std::make_unique<Job>();
+    job->task = std::move(task);
+    return enqueue(std::move(job));
+}
+
+CvkPipelineBuilder::Handle CvkPipelineBuilder::enqueue(std::unique_ptr<Job> job) {
+    Handle handle;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        handle = nextHandle++;
+        jobs.emplace(handle, std::move(job));
+        queue.push_back(handle);
+        unfinishedJobs++;
+    }
+    wakeCondition.notify_one();
+    return handle;
+}
+
+bool CvkPipelineBuilder::isReady(Handle handle) const {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto job = jobs.find(handle);
+    assert(job != jobs.end() && "Unknown pipeline handle, or it was already taken!");
+    return job->second->done;
+}
+
+std::unique_ptr<CvkPipelineBuilder::Job> CvkPipelineBuilder::finish(std::unique_lock<std::mutex> &lock, Handle handle) {
+    auto entry = jobs.find(handle);
+    assert(entry != jobs.end() && "Unknown pipeline handle, or it was already taken!");
+    Job *job = entry->second.get();
+    doneCondition.wait(lock, [job] { return job->done; });
+    // Looked up again, other jobs may have been added or freed while waiting.
+    entry = jobs.find(handle);
+    std::unique_ptr<Job> finished = std::move(entry->second);
+    jobs.erase(entry);
+    if (finished->error) {
+        std::rethrow_exception(finished->error);
+    }
+    return finished;
+}
+
+std::unique_ptr<CvkPipeline> CvkPipelineBuilder::take(Handle handle) {
+    std::unique_lock<std::mutex> lock{mutex};
+    std::unique_ptr<Job> job = finish(lock, handle);
+    assert(!job->task && "take() on a task, use wait()!");
+    return std::move(job->pipeline);
+}
+
+void CvkPipelineBuilder::wait(Handle handle) {
+    std::unique_lock<std::mutex> lock{mutex};
+    finish(lock, handle);
+}
+
+void CvkPipelineBuilder::discard(Handle handle) {
+    std::unique_ptr<Job> finished;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto entry = jobs.find(handle);
+        assert(entry != jobs.end() && "Unknown pipeline handle, or it was already taken!");
+        assert(!entry->second->task && "Tasks can't be discarded, they may point at their submitter!");
+        if (!entry->second->done) {
+            entry->second->discarded = true;
+            return;
+        }
+        finished = std::move(entry->second);
+        jobs.erase(entry);
+    }
+    // its pipeline is destroyed here, outside of the lock
+}
+
+void CvkPipelineBuilder::waitIdle() {
+    std::unique_lock<std::mutex> lock{mutex};
+    doneCondition.wait(lock, [this] { return unfinishedJobs == 0; });
+}
+
+void CvkPipelineBuilder::watch(CvkPipelineVariants *variants) {
+    watched.push_back(variants);
+}
+
+void CvkPipelineBuilder::unwatch(CvkPipelineVariants *variants) {
+    watched.erase(std::remove(watched.begin(), watched.end(), variants), watched.end());
+}
+
+bool CvkPipelineBuilder::reloadChangedShaders() {
+    const std::vector<std::string> changed = cvkDevice.shaderLibrary().compiler().pollChanges();
+    if (changed.empty()) { return false; }
+    // Only graphics pipelines are watched. The compute ones (CvkComputePipeline) are built once, their sources
+    // are still compiled through the shader library and so show up here as well.
+    bool reloading = false;
+    for (const auto &source : changed) {
+        const bool reloaded = std::any_of(watched.begin(), watched.end(), [&source](CvkPipelineVariants *variants) {
+            return variants->usesShader(source);
+        });
+        if (reloaded) {
+            std::cout << "Reloading " << source << "\n";
+            reloading = true;
+        } else {
+            std::cout << source << " changed, but only graphics shaders are hot reloaded, restart to use it\n";
+        }
+    }
+    for (CvkPipelineVariants *variants : watched) {
+        variants->reloadShaders(changed);
+    }
+    return reloading;
+}
+
+void CvkPipelineBuilder::workerLoop() {
+    while (true) {
+        Handle handle;
+        Job *job;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            wakeCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) { return; }
+            handle = queue.front();
+            job = jobs.at(handle).get();
+            queue.pop_front();
+        }
+
+        // The request doesn't change after submit, so it is read without the lock.
+        std::unique_ptr<CvkPipeline> pipeline;
+        std::exception_ptr error;
+        try {
+            if (job->task) {
+                job->task();
+            } else {
+                PipelineConfigInfo configInfo{};
+                job->request.configure(configInfo);
+                configInfo.specialization = job->request.specialization;
+                pipeline = std::make_unique<CvkPipeline>(
+                    cvkDevice,
+                    job->request.vertFilepath,
+                    job->request.fragFilepath,
+                    configInfo,
+                    job->pipelineId);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::unique_ptr<Job> discarded;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            job->pipeline = std::move(pipeline);
+            job->error = error;
+            job->done = true;
+            unfinishedJobs--;
+            if (job->discarded) {
+                discarded = std::move(jobs.at(handle));
+                jobs.erase(handle);
+            }
+        }
+        doneCondition.notify_all();
+        // destroys the pipeline nobody wanted anymore, outside of the lock
+    }
+}
+
+} // namespace cvk
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+#include "CvkPipeline.hpp"
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cvk {
+
+/*
+Compiles graphics pipelines on worker threads of its own. Render systems submit what they need while they are
+constructed and only take the pipelines once they first draw, so the driver's shader compilation for all of
+them overlaps instead of running one system after the other. The pipeline cache is internally synchronized,
+every worker creates through CvkDevice::pipelineCache().
+
+CvkThreadPool isn't used here since its run() blocks until a whole batch is done, and frames are recorded on it
+while pipelines are still compiling.
+
+With usesPipelineLibrary() CvkPipelineVariants compile their variants as CvkPipelineLibrary parts through
+submitTask() instead, and link them on first use.
+
+Every CvkPipelineVariants built with a builder is watched, so reloadChangedShaders() can rebuild the ones whose
+shaders were edited while the app runs.
+*/
+class CvkPipelineBuilder {
+public:
+    struct Request {
+        std::string vertFilepath;
+        std::string fragFilepath; // may be empty, see CvkPipeline
+        PipelineConfigFunction configure; // runs on a worker thread, so only capture by value
+        SpecializationConstants specialization{};
+    };
+    using Handle = uint32_t;
+    using Task = std::function<void()>;
+
+    // 0 picks one thread per hardware thread, minus the one the main thread keeps busy. pipelineLibrary only
+    // takes effect if the device supports graphics pipeline libraries.
+    explicit CvkPipelineBuilder(CvkDevice &device, uint32_t threadCount = 0, bool pipelineLibrary = false);
+    // Waits for the pipelines being compiled right now, the queued ones are dropped.
+    ~CvkPipelineBuilder();
+
+    CvkPipelineBuilder(const CvkPipelineBuilder &) = delete;
+    CvkPipelineBuilder &operator=(const CvkPipelineBuilder &) = delete;
+
+    // The pipeline id is reserved here, so pipelines sort in submission order no matter which finishes first.
+    Handle submit(Request request);
+    bool isReady(Handle handle) const;
+    // Blocks until the pipeline is built and hands it over, rethrows if creating it failed. Frees the handle.
+    std::unique_ptr<CvkPipeline> take(Handle handle);
+    // Any other work that belongs on the builder's threads, waited for with wait() instead of take().
+    Handle submitTask(Task task);
+    // Blocks until the task is done, rethrows what it threw. Frees the handle.
+    void wait(Handle handle);
+    // For a pipeline nobody is going to take anymore (e.g. built from shaders that were reloaded since). Frees the
+    // handle, the pipeline is destroyed right away or as soon as a worker finished it. Never bound, so that's safe.
+    void discard(Handle handle);
+    // Blocks until everything submitted so far is done.
+    void waitIdle();
+
+    // Called by CvkPipelineVariants, main thread only.
+    void watch(CvkPipelineVariants *variants);
+    void unwatch(CvkPipelineVariants *variants);
+    // Asks CvkShaderCompiler::pollChanges() which shader sources changed and lets the watched variants rebuild their
+    // pipelines on the workers. Cheap enough to call every frame, main thread only. True if a pipeline is being rebuilt.
+    bool reloadChangedShaders();
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+    bool usesPipelineLibrary() const { return pipelineLibrary; }
+private:
+    struct Job {
+        Request request;
+        Task task; // set for submitTask() jobs, which have no request
+        uint32_t pipelineId = 0;
+        // written by the worker under mutex
+        std::unique_ptr<CvkPipeline> pipeline;
+        std::exception_ptr error;
+        bool done = false;
+        bool discarded = false; // the worker that finishes it frees it
+    };
+
+    void workerLoop();
+    Handle enqueue(std::unique_ptr<Job> job);
+    // Waits for the job and frees its handle, rethrows its error.
+    std::unique_ptr<Job> finish(std::unique_lock<std::mutex> &lock, Handle handle);
+
+    CvkDevice &cvkDevice;
+    bool pipelineLibrary;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    // Only the jobs whose handle wasn't taken, waited for or discarded yet. Pointers stay put while workers use them.
+    std::unordered_map<Handle, std::unique_ptr<Job>> jobs;
+    Handle nextHandle = 0;
+    std::deque<Handle> queue;
+    uint32_t unfinishedJobs = 0;
+    bool stopping = false;
+
+    std::vector<CvkPipelineVariants*> watched;
+};
+
+} // namespace cvk
@@ -0,0 +1,197 @@
+#include "CvkPipelineLibrary.hpp"
+#include "CvkShaderLibrary.hpp"
+
+// std
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace cvk {
+
+CvkPipelineLibrary::CvkPipelineLibrary(
+CvkDevice &device,
+const std::string &vertFilepath,
+const std::string &fragFilepath,
+PipelineConfigFunction configure)
+: cvkDevice{device}, vertFilepath{vertFilepath}, fragFilepath{fragFilepath}, configure{std::move(configure)} {
+    assert(cvkDevice.supportsGraphicsPipelineLibrary() && "Pipeline library without VK_EXT_graphics_pipeline_library!");
+    PipelineConfigInfo configInfo{};
+    this->configure(configInfo);
+    pipelineLayout = configInfo.pipelineLayout;
+
+    vertexInputPart = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, {});
+    fragmentOutputPart = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, {});
+}
+
+CvkPipelineLibrary::~CvkPipelineLibrary() {
+    for (auto &entry : shaderParts) {
+        vkDestroyPipeline(cvkDevice.device(), entry.second.preRasterization, nullptr);
+        vkDestroyPipeline(cvkDevice.device(), entry.second.fragmentShader, nullptr);
+    }
+    vkDestroyPipeline(cvkDevice.device(), vertexInputPart, nullptr);
+    vkDestroyPipeline(cvkDevice.device(), fragmentOutputPart, nullptr);
+}
+
+// Every part only reads the state that belongs to it, so they all start from the same full config.
+VkPipeline CvkPipelineLibrary::createPart(VkGraphicsPipelineLibraryFlagsEXT part, const SpecializationConstants &constants) {
+    PipelineConfigInfo configInfo{};
+    configure(configInfo);
+    configInfo.specialization = constants;
+
+    const bool vertexInput = part == VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+    const bool preRasterization = part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+    const bool fragmentShader = part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+    const bool fragmentOutput = part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+
+    CvkShaderLibrary &shaderLibrary = cvkDevice.shaderLibrary();
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (preRasterization) {
+        shaderModule = shaderLibrary.acquire(vertFilepath, configInfo.defines);
+    } else if (fragmentShader && !fragFilepath.empty()) {
+        shaderModule = shaderLibrary.acquire(fragFilepath, configInfo.defines);
+    }
+
+    const VkSpecializationInfo specializationInfo = configInfo.specialization.info();
+    VkPipelineShaderStageCreateInfo shaderStage{};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = preRasterization ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStage.module = shaderModule;
+    shaderStage.pName = "main";
+    shaderStage.pSpecializationInfo = configInfo.specialization.empty() ? nullptr : &specializationInfo;
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(configInfo.attributeDescriptions.size());
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(configInfo.bindingDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = configInfo.attributeDescriptions.data();
+    vertexInputInfo.pVertexBindingDescriptions = configInfo.bindingDescriptions.data();
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+    libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    libraryInfo.flags = part;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &libraryInfo;
+    // Without the link time optimization info, linkOptimized() would have nothing to optimize with.
+    pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+    pipelineInfo.stageCount = shaderModule != VK_NULL_HANDLE ? 1 : 0;
+    pipelineInfo.pStages = shaderModule != VK_NULL_HANDLE ? &shaderStage : nullptr;
+    if (vertexInput) {
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
+    }
+    if (preRasterization) {
+        pipelineInfo.pViewportState = &configInfo.viewportInfo;
+        pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
+        pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo; // viewport and scissor
+    }
+    if (fragmentShader) {
+        pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
+    }
+    if (fragmentShader || fragmentOutput) {
+        pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
+    }
+    if (fragmentOutput) {
+        pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+    }
+    if (!vertexInput) {
+        pipelineInfo.renderPass = configInfo.renderPass;
+        pipelineInfo.subpass = configInfo.subpass;
+    }
+    if (preRasterization || fragmentShader) {
+        pipelineInfo.layout = configInfo.pipelineLayout;
+    }
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    if (!vertexInput && configInfo.renderPass == VK_NULL_HANDLE) {
+        renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+        renderingInfo.colorAttachmentCount = static_cast<uint32_t>(configInfo.colorAttachmentFormats.size());
+        renderingInfo.pColorAttachmentFormats = configInfo.colorAttachmentFormats.data();
+        renderingInfo.depthAttachmentFormat = configInfo.depthAttachmentFormat;
+        libraryInfo.pNext = &renderingInfo;
+    }
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(cvkDevice.device(), cvkDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &pipeline);
+    if (shaderModule != VK_NULL_HANDLE) { shaderLibrary.release(shaderModule); }
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create graphics pipeline library part.");
+    }
+    return pipeline;
+}
+
+void CvkPipelineLibrary::compileShaders(const SpecializationConstants &constants) {
+    auto key = constants.key();
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (shaderParts.count(key) != 0) { return; }
+    }
+
+    // Compiled without the lock, so different variants compile side by side on the builder's threads.
+    auto startTime = std::chrono::steady_clock::now();
+    ShaderParts parts{};
+    parts.preRasterization = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, constants);
+    try {
+        parts.fragmentShader = createPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, constants);
+    } catch (...) {
+        vkDestroyPipeline(cvkDevice.device(), parts.preRasterization, nullptr);
+        throw;
+    }
+    auto endTime = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock{mutex};
+    if (!shaderParts.emplace(std::move(key), parts).second) {
+        // Somebody else compiled the same variant in the meantime.
+        vkDestroyPipeline(cvkDevice.device(), parts.preRasterization, nullptr);
+        vkDestroyPipeline(cvkDevice.device(), parts.fragmentShader, nullptr);
+        return;
+    }
+    cvkDevice.reportPipelineCreation(
+        vertFilepath + " + " + (fragFilepath.empty() ? "no fragment shader" : fragFilepath) + " (library parts)",
+        std::chrono::duration<double, std::milli>(endTime - startTime).count());
+}
+
+VkPipeline CvkPipelineLibrary::linkParts(const SpecializationConstants &constants, bool optimize) {
+    compileShaders(constants);
+    ShaderParts parts;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        parts = shaderParts.at(constants.key());
+    }
+
+    VkPipeline libraries[] = {vertexInputPart, parts.preRasterization, parts.fragmentShader, fragmentOutputPart};
+    VkPipelineLibraryCreateInfoKHR linkInfo{};
+    linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    linkInfo.libraryCount = 4;
+    linkInfo.pLibraries = libraries;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &linkInfo;
+    pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+
+    auto startTime = std::chrono::steady_clock::now();
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(cvkDevice.device(), cvkDevice.pipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to link graphics pipeline library.");
+    }
+    auto endTime = std::chrono::steady_clock::now();
+    cvkDevice.reportPipelineCreation(
+        vertFilepath + (optimize ? " (optimized link)" : " (fast link)"),
+        std::chrono::duration<double, std::milli>(endTime - startTime).count());
+    return pipeline;
+}
+
+std::unique_ptr<CvkPipeline> CvkPipelineLibrary::link(const SpecializationConstants &constants, uint32_t pipelineId) {
+    return std::make_unique<CvkPipeline>(cvkDevice, linkParts(constants, false), pipelineId);
+}
+
+VkPipeline CvkPipelineLibrary::linkOptimized(const SpecializationConstants &constants) {
+    return linkParts(constants, true);
+}
+
+} // namespace cvk
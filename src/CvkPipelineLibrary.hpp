@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+#include "CvkPipeline.hpp"
+
+// std
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cvk {
+
+/*
+The variants of one shader pair built as VK_EXT_graphics_pipeline_library parts: vertex input, pre-rasterization
+shaders, fragment shader and fragment output. Vertex input and fragment output don't involve shaders and are the
+same for every variant, so they are built once. The two shader parts are what costs, they are compiled once per
+set of specialization constants, and both get the whole set like full pipelines do.
+
+Linking the four parts is cheap (the device guarantees fast linking, see CvkDevice::supportsGraphicsPipelineLibrary),
+so a variant whose parts are compiled can be drawn with right away. The link time optimized pipeline is slower to
+build and runs faster, it is meant to be built in the background and swapped in with CvkPipeline::replacePipeline.
+*/
+class CvkPipelineLibrary {
+public:
+    // Builds the vertex input and fragment output parts. configure is the same as for CvkPipelineVariants.
+    CvkPipelineLibrary(
+        CvkDevice &device,
+        const std::string &vertFilepath,
+        const std::string &fragFilepath,
+        PipelineConfigFunction configure);
+    ~CvkPipelineLibrary();
+
+    CvkPipelineLibrary(const CvkPipelineLibrary &) = delete;
+    CvkPipelineLibrary &operator=(const CvkPipelineLibrary &) = delete;
+
+    // Compiles the pre-rasterization and fragment shader parts for constants, unless they exist already.
+    // Thread safe.
+    void compileShaders(const SpecializationConstants &constants);
+    // Fast link without optimization, compiles the shader parts first if needed. Thread safe.
+    std::unique_ptr<CvkPipeline> link(const SpecializationConstants &constants, uint32_t pipelineId);
+    // Link time optimized version of what link() returns, for CvkPipeline::replacePipeline. Thread safe.
+    VkPipeline linkOptimized(const SpecializationConstants &constants);
+private:
+    struct ShaderParts {
+        VkPipeline preRasterization;
+        VkPipeline fragmentShader;
+    };
+
+    VkPipeline createPart(VkGraphicsPipelineLibraryFlagsEXT part, const SpecializationConstants &constants);
+    VkPipeline linkParts(const SpecializationConstants &constants, bool optimize);
+
+    CvkDevice &cvkDevice;
+    std::string vertFilepath;
+    std::string fragFilepath;
+    PipelineConfigFunction configure;
+    VkPipelineLayout pipelineLayout;
+
+    VkPipeline vertexInputPart = VK_NULL_HANDLE;
+    VkPipeline fragmentOutputPart = VK_NULL_HANDLE;
+    std::mutex mutex;
+    std::map<std::vector<uint32_t>, ShaderParts> shaderParts; // by SpecializationConstants::key()
+};
+
+} // namespace cvk
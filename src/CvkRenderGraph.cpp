@@ -0,0 +1,897 @@
+#include "CvkRenderGraph.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+namespace {
+
+// Layout, stages and access flags behind a Usage.
+struct UsageInfo {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags readAccess;
+    VkAccessFlags writeAccess;
+    VkImageUsageFlags imageUsage;
+};
+
+bool isDepthFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool hasStencil(VkFormat format) {
+    return format == VK_FORMAT_D16_UNORM_S8_UINT ||
+        format == VK_FORMAT_D24_UNORM_S8_UINT ||
+        format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+UsageInfo getUsageInfo(CvkRenderGraph::Usage usage, VkFormat format) {
+    using Usage = CvkRenderGraph::Usage;
+    const VkImageLayout sampledLayout = isDepthFormat(format)
+        ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+        : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    switch (usage) {
+        case Usage::ColorAttachment:
+            return {
+                VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+        case Usage::DepthAttachment:
+            return {
+                VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT};
+        case Usage::SampledFragment:
+            return {
+                sampledLayout,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT,
+                0,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+        case Usage::SampledCompute:
+            return {
+                sampledLayout,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT,
+                0,
+                VK_IMAGE_USAGE_SAMPLED_BIT};
+        case Usage::StorageImageCompute:
+            return {
+                VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_USAGE_STORAGE_BIT};
+        case Usage::StorageBufferCompute:
+            return {
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT,
+                VK_ACCESS_SHADER_WRITE_BIT,
+                0};
+        case Usage::StorageBufferVertex:
+            return {
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT,
+                0,
+                0};
+        case Usage::IndirectBuffer:
+            return {
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                0,
+                0};
+    }
+    throw std::runtime_error("unknown render graph usage!");
+}
+
+template <typename T>
+uint64_t handleKey(T handle) {
+    // Non-dispatchable handles are pointers on 64-bit and plain uint64_t on 32-bit platforms.
+    return (uint64_t)handle;
+}
+
+} // namespace
+
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::writeColor(ResourceId image) {
+    graph.addAccess(passIndex, image, Usage::ColorAttachment, true, false, {});
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::writeColor(ResourceId image, const VkClearColorValue &clear) {
+    VkClearValue clearValue{};
+    clearValue.color = clear;
+    graph.addAccess(passIndex, image, Usage::ColorAttachment, true, true, clearValue);
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::writeDepth(ResourceId image) {
+    graph.addAccess(passIndex, image, Usage::DepthAttachment, true, false, {});
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::writeDepth(ResourceId image, const VkClearDepthStencilValue &clear) {
+    VkClearValue clearValue{};
+    clearValue.depthStencil = clear;
+    graph.addAccess(passIndex, image, Usage::DepthAttachment, true, true, clearValue);
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::read(ResourceId resource, Usage usage) {
+    assert(usage != Usage::ColorAttachment && usage != Usage::DepthAttachment && "Attachments are declared with writeColor/writeDepth!");
+    graph.addAccess(passIndex, resource, usage, false, false, {});
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::write(ResourceId resource, Usage usage) {
+    assert(usage != Usage::ColorAttachment && usage != Usage::DepthAttachment && "Attachments are declared with writeColor/writeDepth!");
+    graph.addAccess(passIndex, resource, usage, true, false, {});
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::setRenderArea(VkExtent2D extent) {
+    graph.passes[passIndex].renderArea = extent;
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::useSecondaryCommandBuffers() {
+    graph.passes[passIndex].secondaryCommandBuffers = true;
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::setSideEffects() {
+    graph.passes[passIndex].sideEffects = true;
+    return *this;
+}
+CvkRenderGraph::PassBuilder &CvkRenderGraph::PassBuilder::setRecord(RecordFunction record) {
+    graph.passes[passIndex].record = std::move(record);
+    return *this;
+}
+
+// *************** Render Graph *********************
+
+CvkRenderGraph::CvkRenderGraph(
+CvkDevice &device,
+bool dynamicRendering)
+: cvkDevice{device}, dynamicRendering{dynamicRendering} {
+    assert((!dynamicRendering || device.supportsDynamicRendering()) && "Device has no dynamic rendering!");
+}
+
+CvkRenderGraph::~CvkRenderGraph() {
+    clearFramebuffers();
+    for (auto &frame : frameImages) {
+        destroyTransientImages(frame);
+    }
+    for (auto &entry : renderPassCache) {
+        vkDestroyRenderPass(cvkDevice.device(), entry.second, nullptr);
+    }
+}
+
+void CvkRenderGraph::reset() {
+    passes.clear();
+    resources.clear();
+    compiled = false;
+}
+
+CvkRenderGraph::ResourceId CvkRenderGraph::importImage(
+const std::string &name,
+VkImage image,
+VkImageView view,
+const ImageDesc &desc,
+VkImageLayout initialLayout,
+VkImageLayout finalLayout) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = true;
+    resource.desc = desc;
+    resource.image = image;
+    resource.view = view;
+    resource.initialLayout = initialLayout;
+    resource.finalLayout = finalLayout;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+CvkRenderGraph::ResourceId CvkRenderGraph::importBuffer(const std::string &name, VkBuffer buffer) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = false;
+    resource.imported = true;
+    resource.buffer = buffer;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+CvkRenderGraph::ResourceId CvkRenderGraph::createImage(const std::string &name, const ImageDesc &desc) {
+    Resource resource{};
+    resource.name = name;
+    resource.isImage = true;
+    resource.imported = false;
+    resource.desc = desc;
+    resources.push_back(resource);
+    return static_cast<ResourceId>(resources.size() - 1);
+}
+
+CvkRenderGraph::Pass &CvkRenderGraph::addPass(const std::string &name, bool graphics) {
+    compiled = false;
+    Pass pass{};
+    pass.name = name;
+    pass.graphics = graphics;
+    passes.push_back(std::move(pass));
+    return passes.back();
+}
+
+CvkRenderGraph::PassBuilder CvkRenderGraph::addGraphicsPass(const std::string &name) {
+    addPass(name, true);
+    return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+CvkRenderGraph::PassBuilder CvkRenderGraph::addComputePass(const std::string &name) {
+    addPass(name, false);
+    return PassBuilder(*this, static_cast<uint32_t>(passes.size() - 1));
+}
+
+void CvkRenderGraph::addAccess(
+uint32_t passIndex,
+ResourceId resource,
+Usage usage,
+bool write,
+bool clear,
+VkClearValue clearValue) {
+    assert(resource < resources.size() && "Unknown render graph resource!");
+    const bool attachment = usage == Usage::ColorAttachment || usage == Usage::DepthAttachment;
+    assert((!attachment || passes[passIndex].graphics) && "Compute passes can't have attachments!");
+    assert(resources[resource].isImage == (usage != Usage::StorageBufferCompute &&
+        usage != Usage::StorageBufferVertex && usage != Usage::IndirectBuffer) && "Usage doesn't fit the resource type!");
+    compiled = false;
+    passes[passIndex].accesses.push_back({resource, usage, write, clear, clearValue});
+}
+
+// *************** Compile *********************
+
+bool CvkRenderGraph::hasLaterUse(ResourceId resource, uint32_t passIndex) const {
+    for (uint32_t i = passIndex + 1; i < passes.size(); i++) {
+        if (passes[i].culled) { continue; }
+        for (auto &access : passes[i].accesses) {
+            // A clearing write doesn't care what was there before.
+            if (access.resource == resource && !(access.write && access.clear)) { return true; }
+        }
+    }
+    return false;
+}
+
+bool CvkRenderGraph::hasEarlierWrite(ResourceId resource, uint32_t passIndex) const {
+    for (uint32_t i = 0; i < passIndex; i++) {
+        if (passes[i].culled) { continue; }
+        for (auto &access : passes[i].accesses) {
+            if (access.resource == resource && access.write) { return true; }
+        }
+    }
+    return false;
+}
+
+void CvkRenderGraph::compile() {
+    // Backwards from the frame outputs: a pass survives if it writes something still needed, and then everything it
+    // reads (or loads) is needed from the passes before it. A clearing write ends the need for earlier contents.
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].imported && resources[i].isImage && resources[i].finalLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+    culledPassCount = 0;
+    for (size_t i = passes.size(); i-- > 0;) {
+        Pass &pass = passes[i];
+        bool keep = pass.sideEffects;
+        for (auto &access : pass.accesses) {
+            if (access.write && needed[access.resource]) { keep = true; }
+        }
+        pass.culled = !keep;
+        if (!keep) {
+            culledPassCount++;
+            continue;
+        }
+        for (auto &access : pass.accesses) {
+            if (access.write && access.clear) { needed[access.resource] = false; }
+        }
+        for (auto &access : pass.accesses) {
+            if (!(access.write && access.clear)) { needed[access.resource] = true; }
+        }
+    }
+
+    for (auto &resource : resources) {
+        resource.usage = 0;
+        resource.firstPass = -1;
+        resource.lastPass = -1;
+    }
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled) { continue; }
+        for (auto &access : passes[i].accesses) {
+            Resource &resource = resources[access.resource];
+            resource.usage |= getUsageInfo(access.usage, resource.desc.format).imageUsage;
+            if (resource.firstPass < 0) { resource.firstPass = static_cast<int>(i); }
+            resource.lastPass = static_cast<int>(i);
+        }
+    }
+
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        if (passes[i].culled || !passes[i].graphics) { continue; }
+        compileAttachments(i);
+        if (!dynamicRendering) { passes[i].renderPass = getRenderPass(i); }
+    }
+    compiled = true;
+}
+
+std::vector<const CvkRenderGraph::Access*> CvkRenderGraph::attachmentsOf(const Pass &pass) const {
+    std::vector<const Access*> attachments;
+    for (auto &access : pass.accesses) {
+        if (access.usage == Usage::ColorAttachment) { attachments.push_back(&access); }
+    }
+    for (auto &access : pass.accesses) {
+        if (access.usage == Usage::DepthAttachment) { attachments.push_back(&access); }
+    }
+    return attachments;
+}
+
+void CvkRenderGraph::compileAttachments(uint32_t passIndex) {
+    Pass &pass = passes[passIndex];
+    const auto attachments = attachmentsOf(pass);
+    assert(!attachments.empty() && "Graphics passes need at least one attachment!");
+
+    pass.framebufferExtent = resources[attachments[0]->resource].desc.extent;
+    pass.loadOps.clear();
+    pass.storeOps.clear();
+    for (auto *access : attachments) {
+        const Resource &resource = resources[access->resource];
+        assert(resource.desc.extent.width == pass.framebufferExtent.width &&
+            resource.desc.extent.height == pass.framebufferExtent.height &&
+            "All attachments of a pass need the same extent!");
+        if (access->clear) {
+            pass.loadOps.push_back(VK_ATTACHMENT_LOAD_OP_CLEAR);
+        } else if (hasEarlierWrite(access->resource, passIndex) ||
+                   (resource.imported && resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED)) {
+            pass.loadOps.push_back(VK_ATTACHMENT_LOAD_OP_LOAD);
+        } else {
+            pass.loadOps.push_back(VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+        }
+        // Transient attachments nobody reads afterwards never leave the tile memory on GPUs that have it.
+        pass.storeOps.push_back(resource.imported || hasLaterUse(access->resource, passIndex)
+            ? VK_ATTACHMENT_STORE_OP_STORE
+            : VK_ATTACHMENT_STORE_OP_DONT_CARE);
+    }
+}
+
+// Initial and final layouts are the attachment layouts themselves, the barriers around the pass do the transitions.
+VkRenderPass CvkRenderGraph::getRenderPass(uint32_t passIndex) {
+    const Pass &pass = passes[passIndex];
+    const auto attachments = attachmentsOf(pass);
+
+    std::vector<VkAttachmentDescription> descriptions;
+    std::vector<VkAttachmentReference> colorReferences;
+    VkAttachmentReference depthReference{};
+    bool hasDepth = false;
+    std::string key;
+    for (size_t i = 0; i < attachments.size(); i++) {
+        const Access *access = attachments[i];
+        const Resource &resource = resources[access->resource];
+        const bool depth = access->usage == Usage::DepthAttachment;
+        const VkImageLayout layout = getUsageInfo(access->usage, resource.desc.format).layout;
+
+        VkAttachmentDescription description{};
+        description.format = resource.desc.format;
+        description.samples = VK_SAMPLE_COUNT_1_BIT;
+        description.loadOp = pass.loadOps[i];
+        description.storeOp = pass.storeOps[i];
+        description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        description.initialLayout = layout;
+        description.finalLayout = layout;
+
+        VkAttachmentReference reference{static_cast<uint32_t>(descriptions.size()), layout};
+        if (depth) {
+            depthReference = reference;
+            hasDepth = true;
+        } else {
+            colorReferences.push_back(reference);
+        }
+        descriptions.push_back(description);
+        key += std::to_string(description.format) + ":" + std::to_string(description.loadOp) + ":" +
+            std::to_string(description.storeOp) + (depth ? "d;" : "c;");
+    }
+
+    auto cached = renderPassCache.find(key);
+    if (cached != renderPassCache.end()) { return cached->second; }
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+    renderPassInfo.pAttachments = descriptions.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 0;
+    renderPassInfo.pDependencies = nullptr;
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(cvkDevice.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph render pass!");
+    }
+    renderPassCache[key] = renderPass;
+    return renderPass;
+}
+
+// *************** Transient images *********************
+
+std::string CvkRenderGraph::transientSignature() const {
+    std::string signature;
+    for (auto &resource : resources) {
+        if (resource.imported || resource.firstPass < 0) { continue; }
+        signature += resource.name + ":" + std::to_string(resource.desc.format) + ":" +
+            std::to_string(resource.desc.extent.width) + "x" + std::to_string(resource.desc.extent.height) + ":" +
+            std::to_string(resource.usage) + ":" + std::to_string(resource.firstPass) + "-" +
+            std::to_string(resource.lastPass) + ";";
+    }
+    return signature;
+}
+
+void CvkRenderGraph::destroyTransientImages(FrameImages &frame) {
+    // Cached framebuffers that point at these views go with them.
+    for (auto it = framebufferCache.begin(); it != framebufferCache.end();) {
+        const auto &views = it->second.views;
+        const bool stale = std::any_of(views.begin(), views.end(), [&](VkImageView view) {
+            return std::find(frame.views.begin(), frame.views.end(), view) != frame.views.end();
+        });
+        if (stale) {
+            vkDestroyFramebuffer(cvkDevice.device(), it->second.framebuffer, nullptr);
+            it = framebufferCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto view : frame.views) {
+        if (view != VK_NULL_HANDLE) { vkDestroyImageView(cvkDevice.device(), view, nullptr); }
+    }
+    for (auto image : frame.images) {
+        if (image != VK_NULL_HANDLE) { vkDestroyImage(cvkDevice.device(), image, nullptr); }
+    }
+    for (auto block : frame.blocks) {
+        vkFreeMemory(cvkDevice.device(), block, nullptr);
+    }
+    frame.images.clear();
+    frame.views.clear();
+    frame.aliasSlots.clear();
+    frame.blocks.clear();
+    frame.signature.clear();
+}
+
+// Images are placed greedily in order of first use, into the first memory block whose current occupant is done
+// by then. The blocks grow to the largest image they hold.
+void CvkRenderGraph::realizeTransientImages(int frameIndex) {
+    if (frameImages.size() <= static_cast<size_t>(frameIndex)) { frameImages.resize(frameIndex + 1); }
+    FrameImages &frame = frameImages[frameIndex];
+    const std::string signature = transientSignature();
+    if (signature == frame.signature && frame.images.size() == resources.size()) { return; }
+
+    destroyTransientImages(frame);
+    frame.signature = signature;
+    frame.images.assign(resources.size(), VK_NULL_HANDLE);
+    frame.views.assign(resources.size(), VK_NULL_HANDLE);
+    frame.aliasSlots.assign(resources.size(), -1);
+
+    std::vector<VkMemoryRequirements> requirements(resources.size());
+    std::vector<ResourceId> transients;
+    for (ResourceId id = 0; id < resources.size(); id++) {
+        const Resource &resource = resources[id];
+        if (resource.imported || resource.firstPass < 0) { continue; }
+
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = resource.desc.extent.width;
+        imageInfo.extent.height = resource.desc.extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = resource.desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = resource.usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.flags = 0;
+        if (vkCreateImage(cvkDevice.device(), &imageInfo, nullptr, &frame.images[id]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image!");
+        }
+        vkGetImageMemoryRequirements(cvkDevice.device(), frame.images[id], &requirements[id]);
+        transients.push_back(id);
+    }
+    std::stable_sort(transients.begin(), transients.end(), [&](ResourceId a, ResourceId b) {
+        return resources[a].firstPass < resources[b].firstPass;
+    });
+
+    struct Block {
+        VkDeviceSize size;
+        uint32_t memoryTypeBits;
+        int busyUntil;
+    };
+    std::vector<Block> blocks;
+    for (ResourceId id : transients) {
+        const Resource &resource = resources[id];
+        int slot = -1;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].busyUntil < resource.firstPass && (blocks[i].memoryTypeBits & requirements[id].memoryTypeBits) != 0) {
+                slot = static_cast<int>(i);
+                break;
+            }
+        }
+        if (slot < 0) {
+            blocks.push_back({0, requirements[id].memoryTypeBits, -1});
+            slot = static_cast<int>(blocks.size() - 1);
+        }
+        Block &block = blocks[slot];
+        block.size = std::max(block.size, requirements[id].size);
+        block.memoryTypeBits &= requirements[id].memoryTypeBits;
+        block.busyUntil = resource.lastPass;
+        frame.aliasSlots[id] = slot;
+    }
+
+    frame.blocks.resize(blocks.size(), VK_NULL_HANDLE);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = blocks[i].size;
+        allocInfo.memoryTypeIndex = cvkDevice.findMemoryType(blocks[i].memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(cvkDevice.device(), &allocInfo, nullptr, &frame.blocks[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory!");
+        }
+    }
+
+    for (ResourceId id : transients) {
+        const Resource &resource = resources[id];
+        // Every image starts at offset 0 of its block, so there is no alignment to take care of.
+        if (vkBindImageMemory(cvkDevice.device(), frame.images[id], frame.blocks[frame.aliasSlots[id]], 0) != VK_SUCCESS) {
+            throw std::runtime_error("failed to bind render graph image memory!");
+        }
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = frame.images[id];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.desc.format;
+        viewInfo.subresourceRange.aspectMask =
+            isDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(cvkDevice.device(), &viewInfo, nullptr, &frame.views[id]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view!");
+        }
+    }
+}
+
+VkFramebuffer CvkRenderGraph::getFramebuffer(const Pass &pass, const std::vector<VkImageView> &attachments) {
+    std::vector<uint64_t> key{handleKey(pass.renderPass), pass.framebufferExtent.width, pass.framebufferExtent.height};
+    for (auto view : attachments) { key.push_back(handleKey(view)); }
+    auto cached = framebufferCache.find(key);
+    if (cached != framebufferCache.end()) { return cached->second.framebuffer; }
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = pass.renderPass;
+    framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    framebufferInfo.pAttachments = attachments.data();
+    framebufferInfo.width = pass.framebufferExtent.width;
+    framebufferInfo.height = pass.framebufferExtent.height;
+    framebufferInfo.layers = 1;
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(cvkDevice.device(), &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph framebuffer!");
+    }
+    framebufferCache[key] = {attachments, framebuffer};
+    return framebuffer;
+}
+
+void CvkRenderGraph::clearFramebuffers() {
+    for (auto &entry : framebufferCache) {
+        vkDestroyFramebuffer(cvkDevice.device(), entry.second.framebuffer, nullptr);
+    }
+    framebufferCache.clear();
+}
+
+// *************** Execute *********************
+
+static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D renderArea) {
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(renderArea.width);
+    viewport.height = static_cast<float>(renderArea.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, renderArea};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+// Writes (and layout transitions) wait for every earlier access, reads only for the last write, and only if it
+// isn't visible to their stage yet. The first use of a transient image waits for whatever used its memory before.
+void CvkRenderGraph::recordBarriers(
+VkCommandBuffer commandBuffer,
+const Pass &pass,
+std::vector<SlotState> &slots,
+const FrameImages &frame) {
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+
+    for (auto &access : pass.accesses) {
+        Resource &resource = resources[access.resource];
+        const UsageInfo info = getUsageInfo(access.usage, resource.desc.format);
+        const VkAccessFlags accessMask = info.readAccess | (access.write ? info.writeAccess : 0);
+        const bool firstTransientUse = !resource.imported && resource.layout == VK_IMAGE_LAYOUT_UNDEFINED;
+        const bool layoutChange = resource.isImage && resource.layout != info.layout;
+
+        VkPipelineStageFlags waitStages = 0;
+        VkAccessFlags waitAccess = 0;
+        if (firstTransientUse) {
+            const SlotState &slot = slots[frame.aliasSlots[access.resource]];
+            waitStages = slot.stages;
+            waitAccess = slot.writeAccess;
+        } else if (access.write || layoutChange) {
+            waitStages = resource.writeStages | resource.readStages;
+            waitAccess = resource.writeAccess;
+        } else if ((info.stages & ~resource.visibleStages) != 0 || (accessMask & ~resource.visibleAccess) != 0) {
+            waitStages = resource.writeStages;
+            waitAccess = resource.writeAccess;
+        }
+
+        if (layoutChange || waitStages != 0) {
+            srcStages |= waitStages != 0 ? waitStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            dstStages |= info.stages;
+            if (resource.isImage) {
+                VkImageMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.oldLayout = firstTransientUse ? VK_IMAGE_LAYOUT_UNDEFINED : resource.layout;
+                barrier.newLayout = info.layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = resource.imported ? resource.image : frame.images[access.resource];
+                VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+                if (isDepthFormat(resource.desc.format)) {
+                    aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil(resource.desc.format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+                }
+                barrier.subresourceRange = {aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+                barrier.srcAccessMask = waitAccess;
+                barrier.dstAccessMask = accessMask;
+                imageBarriers.push_back(barrier);
+            } else {
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = resource.buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                barrier.srcAccessMask = waitAccess;
+                barrier.dstAccessMask = accessMask;
+                bufferBarriers.push_back(barrier);
+            }
+        }
+
+        if (layoutChange || firstTransientUse) {
+            // The transition counts as a write, later accesses have to wait for it.
+            resource.writeStages = info.stages;
+            resource.writeAccess = access.write ? info.writeAccess : 0;
+            resource.readStages = access.write ? 0 : info.stages;
+            resource.visibleStages = info.stages;
+            resource.visibleAccess = accessMask;
+        } else if (access.write) {
+            resource.writeStages = info.stages;
+            resource.writeAccess = info.writeAccess;
+            resource.readStages = 0;
+            resource.visibleStages = info.stages;
+            resource.visibleAccess = accessMask;
+        } else {
+            if (waitStages != 0) {
+                resource.visibleStages |= info.stages;
+                resource.visibleAccess |= accessMask;
+            }
+            resource.readStages |= info.stages;
+        }
+        if (resource.isImage) { resource.layout = info.layout; }
+        if (!resource.imported) {
+            SlotState &slot = slots[frame.aliasSlots[access.resource]];
+            slot.stages |= info.stages;
+            slot.writeAccess |= access.write ? info.writeAccess : 0;
+        }
+    }
+
+    if (imageBarriers.empty() && bufferBarriers.empty()) { return; }
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        srcStages,
+        dstStages,
+        0,
+        0,
+        nullptr,
+        static_cast<uint32_t>(bufferBarriers.size()),
+        bufferBarriers.data(),
+        static_cast<uint32_t>(imageBarriers.size()),
+        imageBarriers.data());
+}
+
+void CvkRenderGraph::recordFinalTransitions(VkCommandBuffer commandBuffer) {
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    VkPipelineStageFlags srcStages = 0;
+    for (auto &resource : resources) {
+        if (!resource.imported || !resource.isImage) { continue; }
+        if (resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.finalLayout == resource.layout) { continue; }
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = resource.layout;
+        barrier.newLayout = resource.finalLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = resource.image;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        if (isDepthFormat(resource.desc.format)) {
+            aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencil(resource.desc.format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+        }
+        barrier.subresourceRange = {aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+        barrier.srcAccessMask = resource.writeAccess;
+        // Presenting (the usual final layout) needs no access mask, the semaphore takes care of visibility.
+        barrier.dstAccessMask = 0;
+        imageBarriers.push_back(barrier);
+        srcStages |= resource.writeStages | resource.readStages;
+        resource.layout = resource.finalLayout;
+    }
+    if (imageBarriers.empty()) { return; }
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        static_cast<uint32_t>(imageBarriers.size()),
+        imageBarriers.data());
+}
+
+void CvkRenderGraph::beginRendering(
+VkCommandBuffer commandBuffer,
+const Pass &pass,
+const FrameImages &frame,
+VkExtent2D renderArea,
+VkSubpassContents contents,
+std::vector<VkFormat> &colorFormats,
+VkCommandBufferInheritanceRenderingInfoKHR &inheritance) {
+    const auto attachments = attachmentsOf(pass);
+    std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    for (size_t i = 0; i < attachments.size(); i++) {
+        const Access *access = attachments[i];
+        const Resource &resource = resources[access->resource];
+        VkRenderingAttachmentInfoKHR attachment{};
+        attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        attachment.imageView = resource.imported ? resource.view : frame.views[access->resource];
+        attachment.imageLayout = getUsageInfo(access->usage, resource.desc.format).layout;
+        attachment.loadOp = pass.loadOps[i];
+        attachment.storeOp = pass.storeOps[i];
+        attachment.clearValue = access->clearValue;
+        if (access->usage == Usage::DepthAttachment) {
+            depthAttachment = attachment;
+            depthFormat = resource.desc.format;
+        } else {
+            colorAttachments.push_back(attachment);
+            colorFormats.push_back(resource.desc.format);
+        }
+    }
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags = contents == VK_SUBPASS_CONTENTS_INLINE ? 0 : VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+    renderingInfo.renderArea = {{0, 0}, renderArea};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+    renderingInfo.pColorAttachments = colorAttachments.data();
+    renderingInfo.pDepthAttachment = depthFormat != VK_FORMAT_UNDEFINED ? &depthAttachment : nullptr;
+    cvkDevice.cmdBeginRendering()(commandBuffer, &renderingInfo);
+
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+    inheritance.flags = renderingInfo.flags;
+    inheritance.colorAttachmentCount = renderingInfo.colorAttachmentCount;
+    inheritance.pColorAttachmentFormats = colorFormats.data();
+    inheritance.depthAttachmentFormat = depthFormat;
+    inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+}
+
+void CvkRenderGraph::execute(VkCommandBuffer commandBuffer, int frameIndex) {
+    assert(compiled && "Render graph has to be compiled before it is executed!");
+    realizeTransientImages(frameIndex);
+    const FrameImages &frame = frameImages[frameIndex];
+
+    // Whatever touched an imported resource before the graph is unknown, so its first use waits for everything.
+    // For the swapchain image that also chains the layout transition to the acquire semaphore's wait stage.
+    for (auto &resource : resources) {
+        resource.layout = resource.imported ? resource.initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+        resource.writeStages = resource.imported ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : 0;
+        resource.writeAccess =
+            resource.imported && (!resource.isImage || resource.initialLayout != VK_IMAGE_LAYOUT_UNDEFINED)
+            ? VK_ACCESS_MEMORY_WRITE_BIT
+            : 0;
+        resource.readStages = 0;
+        resource.visibleStages = 0;
+        resource.visibleAccess = 0;
+    }
+    std::vector<SlotState> slots(frame.blocks.size());
+
+    for (auto &pass : passes) {
+        if (pass.culled) { continue; }
+        recordBarriers(commandBuffer, pass, slots, frame);
+
+        if (!pass.graphics) {
+            if (pass.record) { pass.record({commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, {0, 0}, VK_SUBPASS_CONTENTS_INLINE}); }
+            continue;
+        }
+
+        const VkExtent2D renderArea = pass.renderArea.width > 0 ? pass.renderArea : pass.framebufferExtent;
+        const VkSubpassContents contents = pass.secondaryCommandBuffers
+            ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+            : VK_SUBPASS_CONTENTS_INLINE;
+        if (dynamicRendering) {
+            std::vector<VkFormat> colorFormats;
+            VkCommandBufferInheritanceRenderingInfoKHR inheritance{};
+            beginRendering(commandBuffer, pass, frame, renderArea, contents, colorFormats, inheritance);
+            if (contents == VK_SUBPASS_CONTENTS_INLINE) { setViewportAndScissor(commandBuffer, renderArea); }
+            if (pass.record) {
+                pass.record({commandBuffer, VK_NULL_HANDLE, VK_NULL_HANDLE, renderArea, contents, &inheritance});
+            }
+            cvkDevice.cmdEndRendering()(commandBuffer);
+            continue;
+        }
+
+        std::vector<VkImageView> views;
+        std::vector<VkClearValue> clearValues;
+        for (auto *access : attachmentsOf(pass)) {
+            const Resource &resource = resources[access->resource];
+            views.push_back(resource.imported ? resource.view : frame.views[access->resource]);
+            clearValues.push_back(access->clearValue);
+        }
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = pass.renderPass;
+        renderPassInfo.framebuffer = getFramebuffer(pass, views);
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = renderArea;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) { setViewportAndScissor(commandBuffer, renderArea); }
+        if (pass.record) { pass.record({commandBuffer, pass.renderPass, renderPassInfo.framebuffer, renderArea, contents}); }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+
+    recordFinalTransitions(commandBuffer);
+}
+
+} // namespace cvk
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+
+// std
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace cvk {
+
+/*
+Declarative frame graph. Every frame the passes are declared again along with the resources they read and write,
+and compile() works out everything that used to be written by hand:
+    - passes whose results nobody reads are culled (unless they have side effects)
+    - transient images (createImage) are allocated by the graph, images whose lifetimes don't overlap share memory
+    - graphics passes get a VkRenderPass and VkFramebuffer built from their attachments, with load/store ops
+      derived from who reads the attachment afterwards. Both are cached, so nothing is created per frame.
+execute() records the surviving passes in declaration order, with the pipeline barriers and layout transitions
+in between derived from the declared accesses. The render passes carry no transitions or dependencies of their own.
+
+Imported resources (swapchain image, buffers of the render systems) are tracked the same way, they are just owned
+by someone else. A pass with one color and one depth attachment gets a render pass compatible with the swapchain's,
+so pipelines created against CvkRenderer::getSwapChainRenderPass() can draw in it.
+
+With dynamic rendering (VK_KHR_dynamic_rendering) graphics passes begin with vkCmdBeginRenderingKHR on the image
+views directly, with the same derived load/store ops. No render passes or framebuffers exist then, so nothing has
+to be rebuilt when imported views change, and pipelines only have to agree on the attachment formats.
+*/
+class CvkRenderGraph {
+public:
+    using ResourceId = uint32_t;
+
+    // How a pass touches a resource, each maps to an image layout, pipeline stages and access flags.
+    enum class Usage {
+        ColorAttachment,
+        DepthAttachment,
+        SampledFragment,      // combined image sampler in a fragment shader
+        SampledCompute,
+        StorageImageCompute,
+        StorageBufferCompute,
+        StorageBufferVertex,
+        IndirectBuffer,
+    };
+
+    struct ImageDesc {
+        VkFormat format;
+        VkExtent2D extent;
+    };
+
+    // What a pass gets to record with. renderPass and framebuffer are VK_NULL_HANDLE for compute passes and with
+    // dynamic rendering, secondary command buffers inherit them. With dynamic rendering they have to chain
+    // renderingInheritance into their VkCommandBufferInheritanceInfo instead (only valid during the record call).
+    struct PassContext {
+        VkCommandBuffer commandBuffer;
+        VkRenderPass renderPass;
+        VkFramebuffer framebuffer;
+        VkExtent2D renderArea;
+        VkSubpassContents contents;
+        const VkCommandBufferInheritanceRenderingInfoKHR *renderingInheritance = nullptr;
+    };
+    using RecordFunction = std::function<void(const PassContext &)>;
+
+    class PassBuilder {
+    public:
+        PassBuilder(CvkRenderGraph &graph, uint32_t passIndex) : graph{graph}, passIndex{passIndex} {}
+
+        // Attachments without a clear value keep (load) what earlier passes wrote.
+        PassBuilder &writeColor(ResourceId image);
+        PassBuilder &writeColor(ResourceId image, const VkClearColorValue &clear);
+        PassBuilder &writeDepth(ResourceId image);
+        PassBuilder &writeDepth(ResourceId image, const VkClearDepthStencilValue &clear);
+        PassBuilder &read(ResourceId resource, Usage usage);
+        // Storage writes never discard what was there, so they count as a read as well.
+        PassBuilder &write(ResourceId resource, Usage usage);
+        // Defaults to the extent of the attachments.
+        PassBuilder &setRenderArea(VkExtent2D extent);
+        // The pass only records vkCmdExecuteCommands, so viewport and scissor are up to the secondary buffers.
+        PassBuilder &useSecondaryCommandBuffers();
+        // Never culled, e.g. a pass that writes something the host reads back.
+        PassBuilder &setSideEffects();
+        PassBuilder &setRecord(RecordFunction record);
+    private:
+        CvkRenderGraph &graph;
+        uint32_t passIndex;
+    };
+
+    // dynamicRendering needs CvkDevice::supportsDynamicRendering().
+    CvkRenderGraph(CvkDevice &device, bool dynamicRendering = false);
+    ~CvkRenderGraph();
+
+    CvkRenderGraph(const CvkRenderGraph &) = delete;
+    CvkRenderGraph &operator=(const CvkRenderGraph &) = delete;
+
+    // Drops this frame's passes and resources, the allocations and caches behind them stay.
+    void reset();
+
+    // initialLayout is what the image holds when the frame starts (UNDEFINED discards it), the graph transitions it
+    // to finalLayout at the end, unless that is UNDEFINED too. Images with a final layout are frame outputs,
+    // the passes writing them are never culled.
+    ResourceId importImage(
+        const std::string &name,
+        VkImage image,
+        VkImageView view,
+        const ImageDesc &desc,
+        VkImageLayout initialLayout,
+        VkImageLayout finalLayout);
+    ResourceId importBuffer(const std::string &name, VkBuffer buffer);
+    // Lives for this frame only, its contents are undefined before the first write.
+    ResourceId createImage(const std::string &name, const ImageDesc &desc);
+
+    PassBuilder addGraphicsPass(const std::string &name);
+    PassBuilder addComputePass(const std::string &name);
+
+    // Culls passes, computes lifetimes and picks render passes. Cheap when the frame looks like the last one.
+    void compile();
+    // frameIndex selects the set of transient images, the previous submission using it has to be finished.
+    void execute(VkCommandBuffer commandBuffer, int frameIndex);
+
+    // Imported views are used as framebuffer cache keys, call this once they are destroyed (swapchain recreation)
+    // and nothing is in flight anymore. Nothing to do with dynamic rendering.
+    void clearFramebuffers();
+
+    uint32_t getCulledPassCount() const { return culledPassCount; }
+private:
+    struct Access {
+        ResourceId resource;
+        Usage usage;
+        bool write;
+        bool clear;
+        VkClearValue clearValue;
+    };
+    struct Pass {
+        std::string name;
+        bool graphics;
+        std::vector<Access> accesses;
+        VkExtent2D renderArea{0, 0};
+        bool secondaryCommandBuffers = false;
+        bool sideEffects = false;
+        RecordFunction record;
+        // compile results
+        bool culled = false;
+        VkRenderPass renderPass = VK_NULL_HANDLE; // stays null with dynamic rendering
+        VkExtent2D framebufferExtent{0, 0};
+        std::vector<VkAttachmentLoadOp> loadOps;   // in attachmentsOf() order
+        std::vector<VkAttachmentStoreOp> storeOps;
+    };
+    struct Resource {
+        std::string name;
+        bool isImage;
+        bool imported;
+        ImageDesc desc{VK_FORMAT_UNDEFINED, {0, 0}};
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // compile results
+        VkImageUsageFlags usage = 0;
+        int firstPass = -1;
+        int lastPass = -1;
+        // execute state, the accesses since the last write and what of them is already visible
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;
+        VkPipelineStageFlags visibleStages = 0;
+        VkAccessFlags visibleAccess = 0;
+    };
+    // Transient images of one frame in flight, recreated only when the transient set or its lifetimes change.
+    struct FrameImages {
+        std::string signature;
+        std::vector<VkImage> images;         // by resource id, VK_NULL_HANDLE for imports and culled ones
+        std::vector<VkImageView> views;
+        std::vector<int> aliasSlots;         // memory block of each image
+        std::vector<VkDeviceMemory> blocks;
+    };
+    struct SlotState {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags writeAccess = 0;
+    };
+
+    Pass &addPass(const std::string &name, bool graphics);
+    void addAccess(uint32_t passIndex, ResourceId resource, Usage usage, bool write, bool clear, VkClearValue clearValue);
+    std::string transientSignature() const;
+    void realizeTransientImages(int frameIndex);
+    void destroyTransientImages(FrameImages &frame);
+    // Color attachments in declaration order, then depth. Same order in render pass, framebuffer and clear values.
+    std::vector<const Access*> attachmentsOf(const Pass &pass) const;
+    // Load/store ops and extent of a graphics pass' attachments.
+    void compileAttachments(uint32_t passIndex);
+    VkRenderPass getRenderPass(uint32_t passIndex);
+    VkFramebuffer getFramebuffer(const Pass &pass, const std::vector<VkImageView> &attachments);
+    void recordBarriers(VkCommandBuffer commandBuffer, const Pass &pass, std::vector<SlotState> &slots, const FrameImages &frame);
+    void recordFinalTransitions(VkCommandBuffer commandBuffer);
+    // Begins the pass with vkCmdBeginRenderingKHR, inheritance gets what secondary command buffers need.
+    void beginRendering(
+        VkCommandBuffer commandBuffer,
+        const Pass &pass,
+        const FrameImages &frame,
+        VkExtent2D renderArea,
+        VkSubpassContents contents,
+        std::vector<VkFormat> &colorFormats,
+        VkCommandBufferInheritanceRenderingInfoKHR &inheritance);
+    bool hasLaterUse(ResourceId resource, uint32_t passIndex) const;
+    bool hasEarlierWrite(ResourceId resource, uint32_t passIndex) const;
+
+    CvkDevice &cvkDevice;
+    bool dynamicRendering;
+
+    std::vector<Pass> passes;
+    std::vector<Resource> resources;
+    bool compiled = false;
+    uint32_t culledPassCount = 0;
+
+    std::vector<FrameImages> frameImages;
+    std::map<std::string, VkRenderPass> renderPassCache;
+    struct CachedFramebuffer {
+        std::vector<VkImageView> views;
+        VkFramebuffer framebuffer;
+    };
+    std::map<std::vector<uint64_t>, CachedFramebuffer> framebufferCache;
+};
+
+} // namespace cvk
@@ -0,0 +1,148 @@
+#include "CvkRenderQueue.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace cvk {
+
+static constexpr int PIPELINE_BITS = 12;
+static constexpr int MATERIAL_BITS = 12;
+static constexpr int MODEL_BITS = 16;
+static constexpr int DEPTH_BITS = 24;
+static_assert(PIPELINE_BITS + MATERIAL_BITS + MODEL_BITS + DEPTH_BITS == 64, "Sort key has to fill 64 bits");
+
+static uint64_t keyField(uint32_t value, int bits) {
+    return static_cast<uint64_t>(value) & ((uint64_t{1} << bits) - 1);
+}
+
+// For positive floats the bit pattern sorts the same way as the value, so the top bits make a fine depth key.
+static uint32_t depthBits(float depth) {
+    depth = std::max(depth, 0.f);
+    uint32_t bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return bits >> (32 - DEPTH_BITS);
+}
+
+uint64_t CvkRenderQueue::makeSortKey(const DrawPacket &packet) {
+    uint64_t key = keyField(packet.pipeline->getId(), PIPELINE_BITS);
+    key = (key << MATERIAL_BITS) | keyField(packet.materialId, MATERIAL_BITS);
+    key = (key << MODEL_BITS) | keyField(packet.model->getId(), MODEL_BITS);
+    key = (key << DEPTH_BITS) | keyField(depthBits(packet.depth), DEPTH_BITS);
+    return key;
+}
+
+void CvkRenderQueue::clear() {
+    packets.clear();
+    pushRanges.clear();
+    pushData.clear();
+}
+
+void CvkRenderQueue::submit(const DrawPacket &packet, const void *data, uint32_t size, VkShaderStageFlags stages) {
+    assert(packet.pipeline != nullptr && packet.model != nullptr && "Draw packet needs a pipeline and a model");
+    PushRange range{static_cast<uint32_t>(pushData.size()), size, stages};
+    if (size > 0) {
+        const char *bytes = static_cast<const char*>(data);
+        pushData.insert(pushData.end(), bytes, bytes + size);
+    }
+    packets.push_back(packet);
+    pushRanges.push_back(range);
+}
+
+// LSD radix sort, one pass per key byte. All histograms are built in a single sweep, and passes where every
+// key has the same byte are skipped, which with few pipelines and materials removes most of the top passes.
+void CvkRenderQueue::sort() {
+    entries.resize(packets.size());
+    for (uint32_t i = 0; i < packets.size(); i++) {
+        entries[i] = {makeSortKey(packets[i]), i};
+    }
+    scratch.resize(entries.size());
+
+    uint32_t histograms[8][256] = {};
+    for (const auto &entry : entries) {
+        for (int pass = 0; pass < 8; pass++) {
+            histograms[pass][(entry.key >> (pass * 8)) & 0xff]++;
+        }
+    }
+
+    const uint32_t count = static_cast<uint32_t>(entries.size());
+    for (int pass = 0; pass < 8; pass++) {
+        uint32_t *histogram = histograms[pass];
+        const uint32_t firstByte = (entries[0].key >> (pass * 8)) & 0xff;
+        if (histogram[firstByte] == count) { continue; }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (const auto &entry : entries) {
+            scratch[histogram[(entry.key >> (pass * 8)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void CvkRenderQueue::flush(VkCommandBuffer commandBuffer, FrameStats &stats, VkDescriptorSet boundGlobalSet) {
+    if (packets.empty()) { return; }
+    sort();
+
+    CvkPipeline *boundPipeline = nullptr;
+    VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+    VkDescriptorSet boundSets[2] = {boundGlobalSet, VK_NULL_HANDLE};
+    CvkModel *boundModel = nullptr;
+    bool boundPositionsOnly = false;
+    for (const auto &entry : entries) {
+        const DrawPacket &packet = packets[entry.packetIndex];
+        const PushRange &push = pushRanges[entry.packetIndex];
+
+        // Without the queue every packet would bind all three.
+        stats.requestedBinds += 3;
+        if (packet.pipeline != boundPipeline) {
+            packet.pipeline->bind(commandBuffer);
+            boundPipeline = packet.pipeline;
+            stats.pipelineBinds++;
+        }
+        if (packet.pipelineLayout != boundLayout) {
+            // All layouts come from MasterRenderSystem and agree on set 0, set 1 belongs to the system though.
+            boundLayout = packet.pipelineLayout;
+            boundSets[1] = VK_NULL_HANDLE;
+        }
+        if (packet.descriptorSets[0] != boundSets[0] ||
+            (packet.descriptorSets[1] != VK_NULL_HANDLE && packet.descriptorSets[1] != boundSets[1])) {
+            const uint32_t firstSet = packet.descriptorSets[0] == boundSets[0] ? 1 : 0;
+            const uint32_t setCount = (packet.descriptorSets[1] != VK_NULL_HANDLE ? 2 : 1) - firstSet;
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                packet.pipelineLayout,
+                firstSet,
+                setCount,
+                packet.descriptorSets + firstSet,
+                0,
+                nullptr);
+            boundSets[0] = packet.descriptorSets[0];
+            boundSets[1] = packet.descriptorSets[1];
+            stats.descriptorSetBinds++;
+        }
+        if (push.size > 0) {
+            vkCmdPushConstants(commandBuffer, packet.pipelineLayout, push.stages, 0, push.size, &pushData[push.offset]);
+        }
+        if (packet.model != boundModel || packet.positionsOnly != boundPositionsOnly) {
+            if (packet.positionsOnly) {
+                packet.model->bindPositions(commandBuffer);
+            } else {
+                packet.model->bind(commandBuffer);
+            }
+            boundModel = packet.model;
+            boundPositionsOnly = packet.positionsOnly;
+            stats.vertexBufferBinds++;
+        }
+        packet.model->draw(commandBuffer, 1, packet.firstInstance);
+        stats.drawCalls++;
+    }
+}
+
+} // namespace cvk
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CvkFrameInfo.hpp"
+#include "CvkModel.hpp"
+#include "CvkPipeline.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace cvk {
+
+/*
+Render systems submit draw packets instead of recording draws directly. Once per frame the queue
+radix sorts them by a 64-bit key and records them in that order, skipping every bind that would
+not change the currently bound state.
+
+Key layout, most significant first:
+    pipeline id (12 bits) | material id (12 bits) | model id (16 bits) | depth (24 bits)
+so state changes are grouped from most to least expensive and objects of one model draw front to back.
+Since the pipeline id comes first, all draws of an earlier created pipeline (e.g. a depth pre-pass) are
+recorded before any draw of a later one.
+*/
+class CvkRenderQueue {
+public:
+    struct DrawPacket {
+        CvkPipeline *pipeline;
+        VkPipelineLayout pipelineLayout;
+        VkDescriptorSet descriptorSets[2]{}; // sets 0 and 1, leave unused ones as VK_NULL_HANDLE
+        CvkModel *model;
+        uint32_t firstInstance = 0;          // object buffer slot, see CvkObjectBuffer
+        uint32_t materialId = 0;
+        float depth = 0.f;             // view space distance, only used for ordering
+        bool positionsOnly = false;    // bind CvkModel::bindPositions instead of the full vertex stream (depth pre-pass)
+    };
+
+    void clear();
+    // pushData (if any) is copied, so it only has to live until this returns.
+    void submit(const DrawPacket &packet, const void *pushData = nullptr, uint32_t pushSize = 0, VkShaderStageFlags pushStages = 0);
+    // Sorts and records everything submitted since the last clear(), the bind counts go into stats.
+    // boundGlobalSet is what is already bound at set 0 (see MasterRenderSystem), packets using it only bind set 1.
+    void flush(VkCommandBuffer commandBuffer, FrameStats &stats, VkDescriptorSet boundGlobalSet = VK_NULL_HANDLE);
+
+    size_t size() const { return packets.size(); }
+
+    static uint64_t makeSortKey(const DrawPacket &packet);
+private:
+    struct PushRange {
+        uint32_t offset;
+        uint32_t size;
+        VkShaderStageFlags stages;
+    };
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packetIndex;
+    };
+
+    void sort();
+
+    std::vector<DrawPacket> packets;
+    std::vector<PushRange> pushRanges;
+    std::vector<char> pushData;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+};
+
+} // namespace cvk
@@ -6,7 +6,17 @@
 
 namespace cvk {
 
-CvkRenderer::CvkRenderer(CvkWindow& window, CvkDevice& device) : cvkWindow{window}, cvkDevice{device} {
+CvkRenderer::CvkRenderer(
+CvkWindow& window,
+CvkDevice& device,
+bool dynamicRendering,
+VkPresentModeKHR presentMode,
+uint32_t framesInFlight)
+: cvkWindow{window},
+  cvkDevice{device},
+  dynamicRendering{dynamicRendering && device.supportsDynamicRendering()},
+  presentMode{presentMode},
+  framesInFlight{framesInFlight} {
     recreateSwapChain();
     createCommandBuffers();   
 }
@@ -16,25 +26,54 @@ CvkRenderer::~CvkRenderer() {
 
 void CvkRenderer::recreateSwapChain() {
     auto extent = cvkWindow.getExtent();
+    if (cvkWindow.isHeadless() && (extent.width == 0 || extent.height == 0)) {
+        throw std::runtime_error("Headless rendering needs a non-zero extent!");
+    }
     // While Window is minimized, or being resized, the app will pause and wait.
     while(extent.width == 0 || extent.height == 0) {
         extent = cvkWindow.getExtent();
         glfwWaitEvents(); 
     }
-    // Wait until current swapchain is no longer being used before creating new one.
-    vkDeviceWaitIdle(cvkDevice.device());
+    // Wait until current swapchain is no longer being used before creating new one. Its render passes and
+    // framebuffers go with it, and recorded commands of any frame may still point at those. With dynamic rendering
+    // only the frames in flight use its images and sync objects (and our command buffers), so their fences are
+    // enough and the queue doesn't have to drain.
+    if (dynamicRendering && cvkSwapchain != nullptr) {
+        cvkSwapchain->waitForFrames();
+    } else {
+        vkDeviceWaitIdle(cvkDevice.device());
+    }
 
     if (cvkSwapchain == nullptr) {
-        cvkSwapchain = std::make_unique<CvkSwapchain>(cvkDevice, extent);
+        cvkSwapchain = std::make_unique<CvkSwapchain>(cvkDevice, extent, dynamicRendering, presentMode, framesInFlight);
     } else {
         std::shared_ptr<CvkSwapchain> old_SwapChain = std::move(cvkSwapchain);
-        cvkSwapchain = std::make_unique<CvkSwapchain>(cvkDevice, extent, old_SwapChain);
+        cvkSwapchain = std::make_unique<CvkSwapchain>(
+            cvkDevice,
+            extent,
+            old_SwapChain,
+            dynamicRendering,
+            presentMode,
+            framesInFlight);
         if (!old_SwapChain->compareSwapFormats(*cvkSwapchain.get())) {
             throw std::runtime_error("Swap chain image (or depth) format has changed!");
         }
     }
+    swapChainGeneration++;
 }
 
+PipelineRenderTarget CvkRenderer::getSwapChainRenderTarget() const {
+    PipelineRenderTarget target{};
+    if (dynamicRendering) {
+        target.colorFormats = {cvkSwapchain->getSwapChainImageFormat()};
+        target.depthFormat = cvkSwapchain->getSwapChainDepthFormat();
+    } else {
+        target.renderPass = cvkSwapchain->getRenderPass();
+    }
+    return target;
+}
+
+// One per possible frame in flight, so changing the count never reallocates them.
 void CvkRenderer::createCommandBuffers() {
     commandBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
     VkCommandBufferAllocateInfo allocInfo{};
@@ -56,8 +95,28 @@ void CvkRenderer::freeCommandBuffers() {
     commandBuffers.clear();
 }
 
+void CvkRenderer::setPresentMode(VkPresentModeKHR mode) {
+    if (mode == presentMode) { return; }
+    presentMode = mode;
+    swapChainSettingsChanged = true;
+}
+
+void CvkRenderer::setFramesInFlight(uint32_t count) {
+    assert(count >= 1 && count <= CvkSwapchain::MAX_FRAMES_IN_FLIGHT && "Frames in flight out of range!");
+    if (count == framesInFlight) { return; }
+    framesInFlight = count;
+    swapChainSettingsChanged = true;
+}
+
 VkCommandBuffer CvkRenderer::beginFrame() {
     assert(!isFrameStarted && "Can't call beginFrame while already in progress");
+    if (swapChainSettingsChanged) {
+        swapChainSettingsChanged = false;
+        // Waits for the old frames, nothing of them is in use anymore. The new swapchain counts its
+        // frames from 0, this has to as well so both pick the same frame's fence and command buffer.
+        recreateSwapChain();
+        currentFrameIndex = 0;
+    }
     auto result = cvkSwapchain->acquireNextImage(&currentImageIndex);
 
     // Error that occurs when the surface has changed/resized and is no longer compatible with the swapchain.
@@ -92,32 +151,52 @@ void CvkRenderer::endFrame() {
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present Swap Chain image!");
     }
+    lastImageIndex = currentImageIndex;
     isFrameStarted = false;
-    currentFrameIndex = (currentFrameIndex + 1) % CvkSwapchain::MAX_FRAMES_IN_FLIGHT;
+    currentFrameIndex = (currentFrameIndex + 1) % framesInFlight;
 }
 
-void CvkRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void CvkRenderer::readLastFrame(std::vector<uint8_t> &rgba) {
+    assert(!isFrameStarted && "Can't read back a frame while one is in progress");
+    assert(lastImageIndex != UINT32_MAX && "No frame has been submitted yet");
+    cvkSwapchain->readImage(static_cast<int>(lastImageIndex), rgba);
+}
+
+void CvkRenderer::beginSwapChainRenderPass(
+VkCommandBuffer commandBuffer,
+VkSubpassContents contents,
+SwapChainPass pass) {
     assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
     assert(
         commandBuffer == getCurrentCommandBuffer() &&
         "Can't begin render pass on a command buffer from a different frame");
 
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = cvkSwapchain->getRenderPass();
-    renderPassInfo.framebuffer = cvkSwapchain->getFrameBuffer(currentImageIndex);
+    if (dynamicRendering) {
+        beginSwapChainRendering(commandBuffer, contents, pass);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        switch (pass) {
+            case SwapChainPass::Full: renderPassInfo.renderPass = cvkSwapchain->getRenderPass(); break;
+            case SwapChainPass::DepthStore: renderPassInfo.renderPass = cvkSwapchain->getDepthStoreRenderPass(); break;
+            case SwapChainPass::Continue: renderPassInfo.renderPass = cvkSwapchain->getContinueRenderPass(); break;
+        }
+        renderPassInfo.framebuffer = cvkSwapchain->getFrameBuffer(currentImageIndex);
+
+        renderPassInfo.renderArea.offset = {0,0};
+        renderPassInfo.renderArea.extent = cvkSwapchain->getSwapChainExtent();
 
-    renderPassInfo.renderArea.offset = {0,0};
-    renderPassInfo.renderArea.extent = cvkSwapchain->getSwapChainExtent();
+        // Ignored by the Continue pass, it loads both attachments.
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
+        clearValues[1].depthStencil = {1.0f, 0};
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
 
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
-    clearValues[1].depthStencil = {1.0f, 0};
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    }
+    if (contents != VK_SUBPASS_CONTENTS_INLINE) { return; }
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,VK_SUBPASS_CONTENTS_INLINE);
-    
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.width = static_cast<float>(cvkSwapchain->getSwapChainExtent().width);
@@ -134,7 +213,160 @@ void CvkRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
     assert(
         commandBuffer == getCurrentCommandBuffer() &&
         "Can't end render pass on a command buffer from a different frame");
-    vkCmdEndRenderPass(commandBuffer);
+    if (dynamicRendering) {
+        endSwapChainRendering(commandBuffer);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+// Layout transitions of depth/stencil formats have to include the stencil aspect.
+static VkImageAspectFlags depthAspectOf(VkFormat format) {
+    const bool stencil = format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+    return VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+}
+
+static void recordImageBarrier(
+VkCommandBuffer commandBuffer,
+VkImage image,
+VkImageAspectFlags aspectMask,
+VkImageLayout oldLayout,
+VkImageLayout newLayout,
+VkPipelineStageFlags srcStages,
+VkAccessFlags srcAccess,
+VkPipelineStageFlags dstStages,
+VkAccessFlags dstAccess) {
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {aspectMask, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Same load/store ops, layouts and dependencies as the three render passes of CvkSwapchain::createRenderPass.
+void CvkRenderer::beginSwapChainRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents, SwapChainPass pass) {
+    const VkImage colorImage = cvkSwapchain->getImage(currentImageIndex);
+    const VkImage depthImage = cvkSwapchain->getDepthImage(currentImageIndex);
+    const VkImageAspectFlags depthAspect = depthAspectOf(cvkSwapchain->getSwapChainDepthFormat());
+    const VkPipelineStageFlags depthStages =
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    const VkAccessFlags depthAccess =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    const bool clear = pass != SwapChainPass::Continue;
+    if (clear) {
+        // The color transition waits on the acquire semaphore's stage, just like the render pass dependency.
+        recordImageBarrier(
+            commandBuffer,
+            colorImage,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            0,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+        recordImageBarrier(
+            commandBuffer,
+            depthImage,
+            depthAspect,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            depthStages,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            depthStages,
+            depthAccess);
+    } else {
+        // Depth comes back from the compute reads of CvkDepthPyramid.
+        recordImageBarrier(
+            commandBuffer,
+            depthImage,
+            depthAspect,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0,
+            depthStages,
+            depthAccess);
+    }
+
+    VkRenderingAttachmentInfoKHR colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = cvkSwapchain->getImageView(currentImageIndex);
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue.color = {0.01f, 0.01f, 0.01f, 1.0f};
+
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = cvkSwapchain->getDepthImageView(currentImageIndex);
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    depthAttachment.storeOp = pass == SwapChainPass::DepthStore
+        ? VK_ATTACHMENT_STORE_OP_STORE
+        : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue.depthStencil = {1.0f, 0};
+
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.flags = contents == VK_SUBPASS_CONTENTS_INLINE ? 0 : VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+    renderingInfo.renderArea = {{0, 0}, cvkSwapchain->getSwapChainExtent()};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    cvkDevice.cmdBeginRendering()(commandBuffer, &renderingInfo);
+    activePass = pass;
+}
+
+void CvkRenderer::endSwapChainRendering(VkCommandBuffer commandBuffer) {
+    cvkDevice.cmdEndRendering()(commandBuffer);
+
+    const VkImage colorImage = cvkSwapchain->getImage(currentImageIndex);
+    if (activePass == SwapChainPass::DepthStore) {
+        const VkImageAspectFlags depthAspect = depthAspectOf(cvkSwapchain->getSwapChainDepthFormat());
+        // Depth is read by the compute pass in between, color is only continued by the next pass.
+        recordImageBarrier(
+            commandBuffer,
+            cvkSwapchain->getDepthImage(currentImageIndex),
+            depthAspect,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT);
+        recordImageBarrier(
+            commandBuffer,
+            colorImage,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+        return;
+    }
+    // Presenting needs no access, a headless readback copies from it.
+    const VkImageLayout presentLayout = cvkSwapchain->getPresentLayout();
+    const bool transfer = presentLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    recordImageBarrier(
+        commandBuffer,
+        colorImage,
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        presentLayout,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        transfer ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        transfer ? VK_ACCESS_TRANSFER_READ_BIT : 0);
 }
 
 } // namespace cvk
\ No newline at end of file
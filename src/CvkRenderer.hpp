@@ -1,11 +1,13 @@
 #pragma once
 
 #include "CvkDevice.hpp"
+#include "CvkPipeline.hpp"
 #include "CvkSwapchain.hpp"
 #include "CvkWindow.hpp"
 
 // std
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -13,34 +15,100 @@ namespace cvk {
 
 class CvkRenderer {
 public:
-    CvkRenderer(CvkWindow &window, CvkDevice &device);
+    // Which swapchain render pass to begin, see CvkSwapchain::getDepthStoreRenderPass.
+    enum class SwapChainPass { Full, DepthStore, Continue };
+
+    // dynamicRendering is ignored when the device doesn't support it, check usesDynamicRendering().
+    CvkRenderer(
+        CvkWindow &window,
+        CvkDevice &device,
+        bool dynamicRendering = false,
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR,
+        uint32_t framesInFlight = CvkSwapchain::DEFAULT_FRAMES_IN_FLIGHT);
     ~CvkRenderer();
 
     CvkRenderer(const CvkRenderer &) = delete;
     CvkRenderer &operator=(const CvkRenderer &) = delete;
 
+    // VK_NULL_HANDLE with dynamic rendering, pipelines should be created from getSwapChainRenderTarget() instead.
     VkRenderPass getSwapChainRenderPass() const { return cvkSwapchain->getRenderPass(); }
+    // The swapchain's render pass, or its formats with dynamic rendering. Stays valid across swapchain
+    // recreation either way, since the formats must not change.
+    PipelineRenderTarget getSwapChainRenderTarget() const;
+    bool usesDynamicRendering() const { return dynamicRendering; }
     float getAspectRatio() const { return cvkSwapchain->extentAspectRatio(); }
+    VkExtent2D getSwapChainExtent() const { return cvkSwapchain->getSwapChainExtent(); }
+    // Offscreen targets (CvkSceneTarget) use the same formats to stay compatible with the swapchain render pass.
+    VkFormat getSwapChainImageFormat() const { return cvkSwapchain->getSwapChainImageFormat(); }
+    VkFormat getSwapChainDepthFormat() const { return cvkSwapchain->getSwapChainDepthFormat(); }
     bool isFrameInProgress() const { return isFrameStarted; }
+    // Takes effect with the next beginFrame(), which recreates the swapchain for it. The surface may not support
+    // the mode, getPresentMode() is the one in use.
+    void setPresentMode(VkPresentModeKHR mode);
+    VkPresentModeKHR getPresentMode() const { return cvkSwapchain->getPresentMode(); }
+    // 1 to CvkSwapchain::MAX_FRAMES_IN_FLIGHT, applied with the next beginFrame() like setPresentMode(). Frame
+    // indices start over at 0 then.
+    void setFramesInFlight(uint32_t count);
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+    // See CvkSwapchain::getLastFenceWaitMilliseconds.
+    double getLastFenceWaitMilliseconds() const { return cvkSwapchain->getLastFenceWaitMilliseconds(); }
+    bool isSwapChainDepthSampleable() const { return cvkSwapchain->isDepthSampleable(); }
+    // The layout a finished frame has to be left in, see CvkSwapchain::getPresentLayout.
+    VkImageLayout getPresentLayout() const { return cvkSwapchain->getPresentLayout(); }
+    // Bumped every time the swapchain is (re)created, anything recorded against the old one is stale.
+    uint32_t getSwapChainGeneration() const { return swapChainGeneration; }
 
     VkCommandBuffer getCurrentCommandBuffer() const {
         assert(isFrameStarted && "Cannot get Command Buffer when frame is not in progress!");
         return commandBuffers[currentFrameIndex];
     }
 
+    // Needed by secondary command buffers that continue the swapchain render pass. None with dynamic rendering.
+    VkFramebuffer getCurrentFramebuffer() const {
+        assert(isFrameStarted && "Cannot get framebuffer when frame is not in progress!");
+        return dynamicRendering ? VK_NULL_HANDLE : cvkSwapchain->getFrameBuffer(currentImageIndex);
+    }
+
+    // The acquired swapchain image, for render graphs that import it.
+    VkImage getCurrentImage() const {
+        assert(isFrameStarted && "Cannot get swapchain image when frame is not in progress!");
+        return cvkSwapchain->getImage(currentImageIndex);
+    }
+    VkImageView getCurrentImageView() const {
+        assert(isFrameStarted && "Cannot get swapchain image view when frame is not in progress!");
+        return cvkSwapchain->getImageView(currentImageIndex);
+    }
+
+    // Only holds this frame's depth between a DepthStore and a Continue pass.
+    VkImageView getCurrentDepthImageView() const {
+        assert(isFrameStarted && "Cannot get depth image view when frame is not in progress!");
+        return cvkSwapchain->getDepthImageView(currentImageIndex);
+    }
+
     int getFrameIndex() const {
         assert(isFrameStarted && "Cannot get frame index when frame is not in progress!");
         return currentFrameIndex;
     }
     VkCommandBuffer beginFrame();
     void endFrame();
-    void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+    // With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS the pass only accepts vkCmdExecuteCommands,
+    // so the viewport and scissor have to be set by the secondary buffers themselves.
+    void beginSwapChainRenderPass(
+        VkCommandBuffer commandBuffer,
+        VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE,
+        SwapChainPass pass = SwapChainPass::Full);
     void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+    // Headless only, copies the last submitted frame out as 8-bit RGBA (waits for the device).
+    void readLastFrame(std::vector<uint8_t> &rgba);
     
 private:
     void createCommandBuffers();
     void freeCommandBuffers();
     void recreateSwapChain();
+    // Dynamic rendering has no render pass to transition the attachments, these record the barriers instead.
+    void beginSwapChainRendering(VkCommandBuffer commandBuffer, VkSubpassContents contents, SwapChainPass pass);
+    void endSwapChainRendering(VkCommandBuffer commandBuffer);
 
     CvkWindow& cvkWindow;
     CvkDevice& cvkDevice;
@@ -51,8 +119,15 @@ private:
     std::vector<VkCommandBuffer> commandBuffers;
 
     uint32_t currentImageIndex;
+    uint32_t lastImageIndex{UINT32_MAX};
     int currentFrameIndex{0};
     bool isFrameStarted{false};
+    uint32_t swapChainGeneration{0};
+    bool dynamicRendering;
+    VkPresentModeKHR presentMode;
+    uint32_t framesInFlight;
+    bool swapChainSettingsChanged{false}; // present mode or frames in flight, applied by beginFrame()
+    SwapChainPass activePass{SwapChainPass::Full};
 };
 
 } // namespace cvk
\ No newline at end of file
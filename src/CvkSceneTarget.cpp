@@ -0,0 +1,175 @@
+#include "CvkSceneTarget.hpp"
+#include "CvkSwapchain.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace cvk {
+
+// GPU time has to be this far under the target before the scale goes back up, so it doesn't hunt around the target.
+static constexpr double SCALE_UP_THRESHOLD = .85;
+// Largest change per step, going down is allowed to be quicker than going up.
+static constexpr float MAX_SCALE_DOWN_STEP = .85f;
+static constexpr float MAX_SCALE_UP_STEP = 1.05f;
+// Smaller changes aren't worth invalidating cached command buffers for.
+static constexpr float MIN_SCALE_CHANGE = .01f;
+
+CvkSceneTarget::CvkSceneTarget(
+CvkDevice &device,
+VkFormat colorFormat,
+float minScale,
+float maxScale,
+double targetGpuMilliseconds)
+: cvkDevice{device},
+  colorFormat{colorFormat},
+  minScale{std::clamp(minScale, MIN_SCALE_LIMIT, MAX_SCALE_LIMIT)},
+  maxScale{std::clamp(maxScale, MIN_SCALE_LIMIT, MAX_SCALE_LIMIT)},
+  targetGpuMilliseconds{targetGpuMilliseconds} {
+    assert(targetGpuMilliseconds > 0.0 && "Scene target needs a positive GPU time target!");
+    if (this->minScale > this->maxScale) { std::swap(this->minScale, this->maxScale); }
+    // Start sharp and let the GPU time pull it down.
+    scale = this->maxScale;
+
+    createSampler();
+    createDescriptors();
+}
+
+CvkSceneTarget::~CvkSceneTarget() {
+    destroyImages();
+    vkDestroySampler(cvkDevice.device(), sampler, nullptr);
+}
+
+// Linear, that's the whole upscale filter.
+void CvkSceneTarget::createSampler() {
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = 0.f;
+    if (vkCreateSampler(cvkDevice.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create scene target sampler!");
+    }
+}
+
+void CvkSceneTarget::createDescriptors() {
+    descriptorPool = CvkDescriptorPool::Builder(cvkDevice)
+        .setMaxSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+    setLayout = CvkDescriptorSetLayout::Builder(cvkDevice)
+        .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+        .build();
+    descriptorSets.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    for (auto &set : descriptorSets) {
+        if (!descriptorPool->allocateDescriptorSet(setLayout->getDescriptorSetLayout(), set)) {
+            throw std::runtime_error("failed to allocate scene target descriptor sets!");
+        }
+    }
+}
+
+void CvkSceneTarget::createImages() {
+    imageExtent = {
+        std::max(1u, static_cast<uint32_t>(std::ceil(outputExtent.width * maxScale))),
+        std::max(1u, static_cast<uint32_t>(std::ceil(outputExtent.height * maxScale)))};
+
+    const size_t count = CvkSwapchain::MAX_FRAMES_IN_FLIGHT;
+    colorImages.resize(count);
+    colorImageMemorys.resize(count);
+    colorImageViews.resize(count);
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = colorFormat;
+    imageInfo.extent.width = imageExtent.width;
+    imageInfo.extent.height = imageExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.flags = 0;
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = colorFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    for (size_t i = 0; i < count; i++) {
+        cvkDevice.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImages[i], colorImageMemorys[i]);
+        viewInfo.image = colorImages[i];
+        if (vkCreateImageView(cvkDevice.device(), &viewInfo, nullptr, &colorImageViews[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create scene target color view!");
+        }
+
+        VkDescriptorImageInfo colorInfo{sampler, colorImageViews[i], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        CvkDescriptorWriter(*setLayout, *descriptorPool)
+            .writeImage(0, &colorInfo)
+            .overwrite(descriptorSets[i]);
+    }
+}
+
+void CvkSceneTarget::destroyImages() {
+    for (size_t i = 0; i < colorImages.size(); i++) {
+        vkDestroyImageView(cvkDevice.device(), colorImageViews[i], nullptr);
+        vkDestroyImage(cvkDevice.device(), colorImages[i], nullptr);
+        vkFreeMemory(cvkDevice.device(), colorImageMemorys[i], nullptr);
+    }
+    colorImages.clear();
+}
+
+void CvkSceneTarget::updateRenderExtent() {
+    renderExtent = {
+        std::clamp(static_cast<uint32_t>(std::lround(outputExtent.width * scale)), 1u, imageExtent.width),
+        std::clamp(static_cast<uint32_t>(std::lround(outputExtent.height * scale)), 1u, imageExtent.height)};
+}
+
+bool CvkSceneTarget::resize(VkExtent2D outputExtent) {
+    if (outputExtent.width == this->outputExtent.width && outputExtent.height == this->outputExtent.height) { return false; }
+    // The other frame in flight may still sample the old images.
+    vkDeviceWaitIdle(cvkDevice.device());
+    destroyImages();
+    this->outputExtent = outputExtent;
+    createImages();
+    updateRenderExtent();
+    return true;
+}
+
+bool CvkSceneTarget::updateScale(double gpuMilliseconds) {
+    if (gpuMilliseconds <= 0.0) { return false; }
+    if (framesSinceChange < CvkSwapchain::MAX_FRAMES_IN_FLIGHT + 1) {
+        framesSinceChange++;
+        return false;
+    }
+    if (gpuMilliseconds <= targetGpuMilliseconds && gpuMilliseconds >= targetGpuMilliseconds * SCALE_UP_THRESHOLD) {
+        return false;
+    }
+
+    const float step = static_cast<float>(std::sqrt(targetGpuMilliseconds / gpuMilliseconds));
+    const float newScale = std::clamp(scale * std::clamp(step, MAX_SCALE_DOWN_STEP, MAX_SCALE_UP_STEP), minScale, maxScale);
+    if (std::abs(newScale - scale) < MIN_SCALE_CHANGE && newScale != minScale && newScale != maxScale) { return false; }
+
+    const VkExtent2D previousExtent = renderExtent;
+    scale = newScale;
+    updateRenderExtent();
+    framesSinceChange = 0;
+    return renderExtent.width != previousExtent.width || renderExtent.height != previousExtent.height;
+}
+
+} // namespace cvk
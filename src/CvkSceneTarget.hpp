@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CvkDescriptors.hpp"
+#include "CvkDevice.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace cvk {
+
+/*
+Offscreen color image the scene renders into at a fraction of the swapchain's resolution,
+UpscaleRenderSystem then stretches it over the swapchain image. The render graph imports it, depth is a
+transient image of the graph.
+
+The images are allocated once at maxScale and the scale only changes how much of them gets rendered to
+(render area, viewport and scissor), so a new scale never reallocates anything. updateScale() drives it
+from the measured GPU frame time: pixel cost goes with scale squared, so the scale moves by the square root
+of target / measured, a few percent at a time.
+*/
+class CvkSceneTarget {
+public:
+    static constexpr float MIN_SCALE_LIMIT = .25f;
+    static constexpr float MAX_SCALE_LIMIT = 2.f;
+
+    CvkSceneTarget(
+        CvkDevice &device,
+        VkFormat colorFormat,
+        float minScale,
+        float maxScale,
+        double targetGpuMilliseconds);
+    ~CvkSceneTarget();
+
+    CvkSceneTarget(const CvkSceneTarget &) = delete;
+    CvkSceneTarget &operator=(const CvkSceneTarget &) = delete;
+
+    // Reallocates for a new swapchain extent, waits for the device when it does and returns true (the old views
+    // are gone). Has to be called before anything of the current frame is recorded.
+    bool resize(VkExtent2D outputExtent);
+    // Feed it the latest GPU frame time, returns true if the render extent changed (recorded viewports are stale).
+    bool updateScale(double gpuMilliseconds);
+
+    VkImage getColorImage(int frameIndex) const { return colorImages[frameIndex]; }
+    VkImageView getColorImageView(int frameIndex) const { return colorImageViews[frameIndex]; }
+    VkFormat getColorFormat() const { return colorFormat; }
+    // The part of the images the scene actually covers this frame.
+    VkExtent2D getRenderExtent() const { return renderExtent; }
+    VkExtent2D getImageExtent() const { return imageExtent; }
+    float getScale() const { return scale; }
+
+    // Binding 0 is the color image of a frame, expected in SHADER_READ_ONLY_OPTIMAL.
+    VkDescriptorSetLayout getDescriptorSetLayout() const { return setLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getDescriptorSet(int frameIndex) const { return descriptorSets[frameIndex]; }
+
+private:
+    void createSampler();
+    void createDescriptors();
+    void createImages();
+    void destroyImages();
+    void updateRenderExtent();
+
+    CvkDevice &cvkDevice;
+    VkFormat colorFormat;
+    float minScale;
+    float maxScale;
+    double targetGpuMilliseconds;
+
+    float scale;
+    // The timer lags a few frames behind, a new scale has to show up in it before it is judged.
+    uint32_t framesSinceChange = 0;
+    VkExtent2D outputExtent{0, 0};
+    VkExtent2D imageExtent{0, 0};
+    VkExtent2D renderExtent{0, 0};
+
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    // One of each per frame in flight, the other frame may still be sampling its color image.
+    std::vector<VkImage> colorImages;
+    std::vector<VkDeviceMemory> colorImageMemorys;
+    std::vector<VkImageView> colorImageViews;
+
+    std::unique_ptr<CvkDescriptorPool> descriptorPool;
+    std::unique_ptr<CvkDescriptorSetLayout> setLayout;
+    std::vector<VkDescriptorSet> descriptorSets;
+};
+
+} // namespace cvk
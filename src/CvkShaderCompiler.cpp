@@ -0,0 +1,179 @@
+#include "CvkShaderCompiler.hpp"
+
+// std
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef CVK_HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+#endif
+
+namespace cvk {
+
+namespace fs = std::filesystem;
+
+#ifdef CVK_HAS_SHADERC
+// FNV-1a, the same as CvkShaderLibrary uses for the code itself.
+static void hashBytes(uint64_t &hash, const std::string &bytes) {
+    for (char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    // so "ab" + "c" and "a" + "bc" don't collide
+    hash ^= 0xFF;
+    hash *= 1099511628211ull;
+}
+
+static shaderc_shader_kind shaderKind(const std::string &sourcePath) {
+    const std::string extension = fs::path{sourcePath}.extension().string();
+    if (extension == ".vert") { return shaderc_vertex_shader; }
+    if (extension == ".frag") { return shaderc_fragment_shader; }
+    if (extension == ".comp") { return shaderc_compute_shader; }
+    throw std::runtime_error("Unknown shader stage: " + sourcePath);
+}
+
+static std::string readSource(const std::string &sourcePath) {
+    std::ifstream file{sourcePath, std::ios::binary};
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + sourcePath);
+    }
+    std::ostringstream source;
+    source << file.rdbuf();
+    return source.str();
+}
+
+std::string CvkShaderCompiler::compileSource(const std::string &sourcePath, const ShaderDefines &defines) {
+    const std::string source = readSource(sourcePath);
+    const shaderc_shader_kind kind = shaderKind(sourcePath);
+
+    unsigned int spirvVersion, spirvRevision;
+    shaderc_get_spv_version(&spirvVersion, &spirvRevision);
+    uint64_t hash = 14695981039346656037ull;
+    hashBytes(hash, source);
+    hashBytes(hash, std::to_string(kind));
+    for (auto &define : defines) {
+        hashBytes(hash, define.first);
+        hashBytes(hash, define.second);
+    }
+    hashBytes(hash, std::to_string(spirvVersion) + "." + std::to_string(spirvRevision));
+
+    char hashText[17];
+    std::snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash));
+    const fs::path cachePath = fs::path{CACHE_DIRECTORY} / (fs::path{sourcePath}.filename().string() + "-" + hashText + ".spv");
+    watch(sourcePath, sourcePath);
+
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        compiledCondition.wait(lock, [this, hash] { return compiling.count(hash) == 0; });
+        if (fs::exists(cachePath)) { return cachePath.string(); }
+        compiling.insert(hash);
+    }
+    auto doneCompiling = [this, hash] {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            compiling.erase(hash);
+        }
+        compiledCondition.notify_all();
+    };
+
+    try {
+        shaderc::Compiler compiler;
+        shaderc::CompileOptions options;
+        for (auto &define : defines) {
+            options.AddMacroDefinition(define.first, define.second);
+        }
+        options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(source, kind, sourcePath.c_str(), options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+            throw std::runtime_error("Failed to compile " + sourcePath + ":\n" + result.GetErrorMessage());
+        }
+
+        // Written next to it first, so a crash or a second process never leaves half a file under the real name.
+        fs::create_directories(CACHE_DIRECTORY);
+        std::ostringstream tmpName;
+        tmpName << cachePath.string() << "." << std::this_thread::get_id() << ".tmp";
+        const fs::path tmpPath = tmpName.str();
+        {
+            std::ofstream file{tmpPath, std::ios::binary | std::ios::trunc};
+            file.write(reinterpret_cast<const char*>(result.cbegin()), (result.cend() - result.cbegin()) * sizeof(uint32_t));
+            if (!file) {
+                throw std::runtime_error("Failed to write shader cache file: " + tmpPath.string());
+            }
+        }
+        std::error_code error;
+        fs::rename(tmpPath, cachePath, error);
+        if (error) {
+            fs::remove(tmpPath, error);
+            // Another process wrote the same code first, and on Windows a mapped file can't be replaced.
+            if (!fs::exists(cachePath)) {
+                throw std::runtime_error("Failed to write shader cache file: " + cachePath.string());
+            }
+        }
+    } catch (...) {
+        doneCompiling();
+        throw;
+    }
+    doneCompiling();
+    return cachePath.string();
+}
+#endif
+
+std::string CvkShaderCompiler::prebuilt(const std::string &sourcePath, const ShaderDefines &defines) {
+    if (!defines.empty()) {
+        throw std::runtime_error("Shader defines need runtime compilation (CVK_HAS_SHADERC): " + sourcePath);
+    }
+    // Rebuilding it with compileShaders.sh counts as a change.
+    const std::string spirvPath = sourcePath + ".spv";
+    std::error_code error;
+    const auto spirvTime = fs::last_write_time(spirvPath, error);
+    if (error) {
+        throw std::runtime_error("Missing " + spirvPath + ", build the Shaders target or run compileShaders.sh");
+    }
+    // Drawing with the interface of an older version of the shader fails in ways far from the cause.
+    const auto sourceTime = fs::last_write_time(sourcePath, error);
+    if (!error && sourceTime > spirvTime) {
+        throw std::runtime_error(spirvPath + " is older than its source, build the Shaders target or run compileShaders.sh");
+    }
+    watch(sourcePath, spirvPath);
+    return spirvPath;
+}
+
+std::string CvkShaderCompiler::compile(const std::string &sourcePath, const ShaderDefines &defines) {
+#ifdef CVK_HAS_SHADERC
+    if (fs::exists(sourcePath)) {
+        return compileSource(sourcePath, defines);
+    }
+#endif
+    return prebuilt(sourcePath, defines);
+}
+
+void CvkShaderCompiler::watch(const std::string &sourcePath, const fs::path &path) {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (watched.count(sourcePath) != 0) { return; }
+    std::error_code error;
+    const auto writeTime = fs::last_write_time(path, error);
+    watched.emplace(sourcePath, WatchedFile{path, error ? fs::file_time_type{} : writeTime});
+}
+
+std::vector<std::string> CvkShaderCompiler::pollChanges() {
+    std::vector<std::string> changed;
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock{mutex};
+    if (now - lastPoll < POLL_INTERVAL) { return changed; }
+    lastPoll = now;
+
+    for (auto &entry : watched) {
+        std::error_code error;
+        const auto writeTime = fs::last_write_time(entry.second.path, error);
+        // Editors that save by replacing the file make it disappear for a moment, that isn't a change yet.
+        if (error || writeTime == entry.second.writeTime) { continue; }
+        entry.second.writeTime = writeTime;
+        changed.push_back(entry.first);
+    }
+    return changed;
+}
+
+} // namespace cvk
@@ -0,0 +1,62 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace cvk {
+
+// name -> value, each one becomes "#define name value" at the top of the source. Sorted, so equal sets hash the same.
+using ShaderDefines = std::map<std::string, std::string>;
+
+/*
+Turns GLSL sources (.vert, .frag, .comp) into SPIR-V files for CvkShaderLibrary to map.
+
+Built with shaderc (CVK_HAS_SHADERC, see CMakeLists.txt), the source is compiled in-process and written to
+CACHE_DIRECTORY, named after the hash of everything that goes into it: the source text, the stage, the defines
+and the SPIR-V version shaderc targets. A source that was compiled before, in this run or an earlier one, is only
+hashed and looked up. An edited one gets a new file rather than overwriting one a module may still be mapped from,
+and going back to an old version finds its old file again. #include isn't supported, the hash couldn't see included
+files change.
+
+Without shaderc, or for a source that isn't there, the prebuilt <source>.spv from compileShaders.sh or the Shaders
+target is used instead, and refused if it is missing or older than its source. Those can't have defines.
+
+Every file handed out is watched, pollChanges() reports the sources whose file was written since, so their
+pipelines can be rebuilt (see CvkPipelineBuilder::reloadChangedShaders). Thread safe.
+*/
+class CvkShaderCompiler {
+public:
+    static constexpr const char *CACHE_DIRECTORY = "shader_cache";
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{500};
+
+    // Path of the SPIR-V file for sourcePath with defines. Throws with the compiler's messages if it doesn't compile.
+    std::string compile(const std::string &sourcePath, const ShaderDefines &defines = {});
+    // Sources whose file changed since the last call, or since they were first compiled. Only looks at the files
+    // once every POLL_INTERVAL, so it is fine to call every frame.
+    std::vector<std::string> pollChanges();
+private:
+    struct WatchedFile {
+        std::filesystem::path path; // the source, or the prebuilt SPIR-V without shaderc
+        std::filesystem::file_time_type writeTime;
+    };
+
+    std::string compileSource(const std::string &sourcePath, const ShaderDefines &defines);
+    std::string prebuilt(const std::string &sourcePath, const ShaderDefines &defines);
+    void watch(const std::string &sourcePath, const std::filesystem::path &path);
+
+    std::mutex mutex;
+    std::condition_variable compiledCondition;
+    std::set<uint64_t> compiling; // hashes being compiled right now, the same shader is only compiled once at a time
+    std::map<std::string, WatchedFile> watched; // by source path
+    std::chrono::steady_clock::time_point lastPoll{};
+};
+
+} // namespace cvk
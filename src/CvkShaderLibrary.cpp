@@ -0,0 +1,165 @@
+#include "CvkShaderLibrary.hpp"
+
+// std
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cvk {
+
+static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filepath) {
+#ifdef _WIN32
+        file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open file: " + filepath);
+        }
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) { return; }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (data == nullptr) {
+            close();
+            throw std::runtime_error("Failed to map file: " + filepath);
+        }
+#else
+        fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open file: " + filepath);
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0) {
+            close();
+            throw std::runtime_error("Failed to stat file: " + filepath);
+        }
+        size = static_cast<size_t>(fileStat.st_size);
+        if (size == 0) { return; }
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close();
+            throw std::runtime_error("Failed to map file: " + filepath);
+        }
+        data = mapped;
+#endif
+    }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Page aligned
+    const void *getData() const { return data; }
+    size_t getSize() const { return size; }
+private:
+    void close() {
+#ifdef _WIN32
+        if (data != nullptr) { UnmapViewOfFile(data); }
+        if (mapping != nullptr) { CloseHandle(mapping); }
+        if (file != INVALID_HANDLE_VALUE) { CloseHandle(file); }
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data != nullptr) { munmap(const_cast<void*>(data), size); }
+        if (fd >= 0) { ::close(fd); }
+        fd = -1;
+#endif
+        data = nullptr;
+    }
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const void *data = nullptr;
+    size_t size = 0;
+};
+
+CvkShaderLibrary::CvkShaderLibrary(CvkDevice &device) : cvkDevice{device} {}
+
+CvkShaderLibrary::~CvkShaderLibrary() {
+    assert(modules.empty() && "Shader modules still acquired when the library is destroyed!");
+    for (auto &entry : modules) {
+        vkDestroyShaderModule(cvkDevice.device(), entry.second.module, nullptr);
+    }
+}
+
+// FNV-1a over whole words, SPIR-V is made of them anyway.
+uint64_t CvkShaderLibrary::hashCode(const uint32_t *code, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size / sizeof(uint32_t); i++) {
+        hash ^= code[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+VkShaderModule CvkShaderLibrary::acquire(const std::string &filepath, const ShaderDefines &defines) {
+    const bool spirv = filepath.size() > 4 && filepath.compare(filepath.size() - 4, 4, ".spv") == 0;
+    const std::string spirvPath = spirv ? filepath : shaderCompiler.compile(filepath, defines);
+    MappedFile file{spirvPath};
+    const auto *code = static_cast<const uint32_t*>(file.getData());
+    if (file.getSize() < sizeof(uint32_t) || file.getSize() % sizeof(uint32_t) != 0 || code[0] != SPIRV_MAGIC) {
+        throw std::runtime_error("Not a SPIR-V file: " + spirvPath);
+    }
+    const CodeKey key{hashCode(code, file.getSize()), file.getSize()};
+
+    std::lock_guard<std::mutex> lock{mutex};
+    const auto candidates = modules.equal_range(key);
+    for (auto existing = candidates.first; existing != candidates.second; ++existing) {
+        if (std::memcmp(existing->second.code.data(), code, file.getSize()) == 0) {
+            existing->second.refCount++;
+            return existing->second.module;
+        }
+    }
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = file.getSize();
+    createInfo.pCode = code;
+    VkShaderModule module;
+    if (vkCreateShaderModule(cvkDevice.device(), &createInfo, nullptr, &module) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module");
+    }
+    auto entry = modules.emplace(key, Module{module, 1, {code, code + file.getSize() / sizeof(uint32_t)}});
+    entries.emplace(module, entry);
+    return module;
+}
+
+void CvkShaderLibrary::release(VkShaderModule module) {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto entry = entries.find(module);
+    assert(entry != entries.end() && "Releasing a shader module that isn't from the library!");
+    if (--entry->second->second.refCount == 0) {
+        vkDestroyShaderModule(cvkDevice.device(), module, nullptr);
+        modules.erase(entry->second);
+        entries.erase(entry);
+    }
+}
+
+size_t CvkShaderLibrary::getModuleCount() const {
+    std::lock_guard<std::mutex> lock{mutex};
+    return modules.size();
+}
+
+} // namespace cvk
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+#include "CvkShaderCompiler.hpp"
+
+// std
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cvk {
+
+/*
+Shader modules shared by content. SPIR-V files are memory mapped instead of read, so the code is handed to
+vkCreateShaderModule straight from the page cache, already 4-byte aligned as pCode requires. Files with identical
+code share one VkShaderModule no matter their path. They are looked up by hash and size, and the code itself is
+compared before a module is shared, so a hash collision only costs a second module.
+
+Modules are reference counted. A pipeline only needs its modules while it is being created, so it acquires them
+right before and releases them right after, and a module lives exactly as long as pipelines using it are being
+built. When the builder compiles several variants of simple_shader.vert at once, they all share one module.
+
+Pipelines name their GLSL sources, compiler() turns those into the SPIR-V files that are mapped. Paths ending in
+.spv are mapped as they are.
+
+Owned by CvkDevice (see CvkDevice::shaderLibrary()), thread safe.
+*/
+class CvkShaderLibrary {
+public:
+    explicit CvkShaderLibrary(CvkDevice &device);
+    ~CvkShaderLibrary();
+
+    CvkShaderLibrary(const CvkShaderLibrary &) = delete;
+    CvkShaderLibrary &operator=(const CvkShaderLibrary &) = delete;
+
+    // Throws if the source doesn't compile, or the file can't be mapped or isn't SPIR-V. Every acquire needs a release.
+    VkShaderModule acquire(const std::string &filepath, const ShaderDefines &defines = {});
+    void release(VkShaderModule module);
+
+    size_t getModuleCount() const;
+    CvkShaderCompiler &compiler() { return shaderCompiler; }
+private:
+    using CodeKey = std::pair<uint64_t, size_t>; // hash and size of the code
+
+    struct Module {
+        VkShaderModule module;
+        uint32_t refCount;
+        std::vector<uint32_t> code; // a copy, the file may be rewritten while the module lives
+    };
+    using ModuleMap = std::multimap<CodeKey, Module>; // colliding hashes of different code get an entry each
+
+    static uint64_t hashCode(const uint32_t *code, size_t size);
+
+    CvkDevice &cvkDevice;
+    CvkShaderCompiler shaderCompiler;
+
+    mutable std::mutex mutex;
+    ModuleMap modules;
+    std::map<VkShaderModule, ModuleMap::iterator> entries; // so release() only needs the handle
+};
+
+} // namespace cvk
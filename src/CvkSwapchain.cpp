@@ -2,6 +2,8 @@
 
 // std
 #include <array>
+#include <cassert>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -11,13 +13,33 @@
 
 namespace cvk {
 
-CvkSwapchain::CvkSwapchain(CvkDevice &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+CvkSwapchain::CvkSwapchain(
+    CvkDevice &deviceRef,
+    VkExtent2D extent,
+    bool dynamicRendering,
+    VkPresentModeKHR preferredPresentMode,
+    uint32_t framesInFlight)
+    : dynamicRendering{dynamicRendering},
+      presentMode{preferredPresentMode},
+      framesInFlight{framesInFlight},
+      device{deviceRef},
+      windowExtent{extent} {
   init();
 }
 
-CvkSwapchain::CvkSwapchain(CvkDevice &deviceRef, VkExtent2D extent, std::shared_ptr<CvkSwapchain> previous)
-    : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous} {
+CvkSwapchain::CvkSwapchain(
+    CvkDevice &deviceRef,
+    VkExtent2D extent,
+    std::shared_ptr<CvkSwapchain> previous,
+    bool dynamicRendering,
+    VkPresentModeKHR preferredPresentMode,
+    uint32_t framesInFlight)
+    : dynamicRendering{dynamicRendering},
+      presentMode{preferredPresentMode},
+      framesInFlight{framesInFlight},
+      device{deviceRef},
+      windowExtent{extent},
+      oldSwapChain{previous} {
   init();
 
   // Clean up old swapchain after copying it.
@@ -25,11 +47,21 @@ CvkSwapchain::CvkSwapchain(CvkDevice &deviceRef, VkExtent2D extent, std::shared_
 }
 
 void CvkSwapchain::init() {
-  createSwapChain();
+  assert(framesInFlight >= 1 && framesInFlight <= MAX_FRAMES_IN_FLIGHT && "Frames in flight out of range!");
+  presentLayout = device.isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  if (device.isHeadless()) {
+    createOffscreenImages();
+  } else {
+    createSwapChain();
+  }
   createImageViews();
-  createRenderPass();
+  if (!dynamicRendering) {
+    createRenderPass();
+  }
   createDepthResources();
-  createFramebuffers();
+  if (!dynamicRendering) {
+    createFramebuffers();
+  }
   createSyncObjects();
 
 }
@@ -45,6 +77,12 @@ CvkSwapchain::~CvkSwapchain() {
     swapChain = nullptr;
   }
 
+  // only headless swapchains own their images
+  for (int i = 0; i < offscreenImageMemorys.size(); i++) {
+    vkDestroyImage(device.device(), swapChainImages[i], nullptr);
+    vkFreeMemory(device.device(), offscreenImageMemorys[i], nullptr);
+  }
+
   for (int i = 0; i < depthImages.size(); i++) {
     vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
     vkDestroyImage(device.device(), depthImages[i], nullptr);
@@ -56,22 +94,42 @@ CvkSwapchain::~CvkSwapchain() {
   }
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  vkDestroyRenderPass(device.device(), depthStoreRenderPass, nullptr);
+  vkDestroyRenderPass(device.device(), continueRenderPass, nullptr);
 
   // cleanup synchronization objects
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
     vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
     vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
     vkDestroyFence(device.device(), inFlightFences[i], nullptr);
   }
 }
 
+void CvkSwapchain::waitForFrames() {
+  vkWaitForFences(
+      device.device(),
+      framesInFlight,
+      inFlightFences.data(),
+      VK_TRUE,
+      std::numeric_limits<uint64_t>::max());
+}
+
 VkResult CvkSwapchain::acquireNextImage(uint32_t *imageIndex) {
+  auto waitStart = std::chrono::steady_clock::now();
   vkWaitForFences(
       device.device(),
       1,
       &inFlightFences[currentFrame],
       VK_TRUE,
       std::numeric_limits<uint64_t>::max());
+  lastFenceWaitMilliseconds =
+      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+  if (device.isHeadless()) {
+    // One image per frame in flight, the fence above already says it's free again.
+    *imageIndex = static_cast<uint32_t>(currentFrame);
+    return VK_SUCCESS;
+  }
 
   VkResult result = vkAcquireNextImageKHR(
       device.device(),
@@ -87,16 +145,21 @@ VkResult CvkSwapchain::acquireNextImage(uint32_t *imageIndex) {
 VkResult CvkSwapchain::submitCommandBuffers(
     const VkCommandBuffer *buffers, uint32_t *imageIndex) {
   if (imagesInFlight[*imageIndex] != VK_NULL_HANDLE) {
+    auto waitStart = std::chrono::steady_clock::now();
     vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
+    lastFenceWaitMilliseconds +=
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
   }
   imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
 
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+  // Headless frames are not acquired or presented, so there is nothing to wait on or signal.
+  const uint32_t semaphoreCount = device.isHeadless() ? 0 : 1;
   VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
+  submitInfo.waitSemaphoreCount = semaphoreCount;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
@@ -104,7 +167,7 @@ VkResult CvkSwapchain::submitCommandBuffers(
   submitInfo.pCommandBuffers = buffers;
 
   VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.signalSemaphoreCount = semaphoreCount;
   submitInfo.pSignalSemaphores = signalSemaphores;
 
   vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
@@ -113,6 +176,11 @@ VkResult CvkSwapchain::submitCommandBuffers(
     throw std::runtime_error("failed to submit draw command buffer!");
   }
 
+  if (device.isHeadless()) {
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    return VK_SUCCESS;
+  }
+
   VkPresentInfoKHR presentInfo = {};
   presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -127,7 +195,7 @@ VkResult CvkSwapchain::submitCommandBuffers(
 
   auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  currentFrame = (currentFrame + 1) % framesInFlight;
 
   return result;
 }
@@ -136,7 +204,7 @@ void CvkSwapchain::createSwapChain() {
   SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
   VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-  VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+  presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
   uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
@@ -193,6 +261,92 @@ void CvkSwapchain::createSwapChain() {
   swapChainExtent = extent;
 }
 
+void CvkSwapchain::createOffscreenImages() {
+  swapChainImageFormat = device.findSupportedFormat(
+      {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB},
+      VK_IMAGE_TILING_OPTIMAL,
+      VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+  swapChainExtent = windowExtent;
+
+  swapChainImages.resize(framesInFlight);
+  offscreenImageMemorys.resize(framesInFlight);
+  for (int i = 0; i < swapChainImages.size(); i++) {
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = swapChainExtent.width;
+    imageInfo.extent.height = swapChainExtent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // TRANSFER_SRC so readImage() can copy a finished frame out
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.flags = 0;
+
+    device.createImageWithInfo(
+        imageInfo,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        swapChainImages[i],
+        offscreenImageMemorys[i]);
+  }
+}
+
+void CvkSwapchain::readImage(int index, std::vector<uint8_t> &rgba) {
+  assert(device.isHeadless() && "Only headless swapchains can be read back!");
+  // the frame has to be finished, this is for captures and tests, not for every frame
+  vkDeviceWaitIdle(device.device());
+
+  const VkDeviceSize size = static_cast<VkDeviceSize>(swapChainExtent.width) * swapChainExtent.height * 4;
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingMemory;
+  device.createBuffer(
+      size,
+      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+      stagingBuffer,
+      stagingMemory);
+
+  VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+  // finished frames are left in presentLayout, which is TRANSFER_SRC_OPTIMAL when headless
+  vkCmdCopyImageToBuffer(
+      commandBuffer,
+      swapChainImages[index],
+      presentLayout,
+      stagingBuffer,
+      1,
+      &region);
+  device.endSingleTimeCommands(commandBuffer);
+
+  rgba.resize(size);
+  void *data;
+  vkMapMemory(device.device(), stagingMemory, 0, size, 0, &data);
+  memcpy(rgba.data(), data, static_cast<size_t>(size));
+  vkUnmapMemory(device.device(), stagingMemory);
+  vkDestroyBuffer(device.device(), stagingBuffer, nullptr);
+  vkFreeMemory(device.device(), stagingMemory, nullptr);
+
+  if (swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB) {
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+      std::swap(rgba[i], rgba[i + 2]);
+    }
+  }
+}
+
 void CvkSwapchain::createImageViews() {
   swapChainImageViews.resize(swapChainImages.size());
   for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -215,15 +369,29 @@ void CvkSwapchain::createImageViews() {
 }
 
 void CvkSwapchain::createRenderPass() {
+  renderPass = createRenderPass(PassType::Full);
+  depthStoreRenderPass = createRenderPass(PassType::DepthStore);
+  continueRenderPass = createRenderPass(PassType::Continue);
+}
+
+// All three variants have the same attachments, so they are compatible with the same framebuffers and pipelines.
+VkRenderPass CvkSwapchain::createRenderPass(PassType type) {
+  const bool clear = type != PassType::Continue;
+
   VkAttachmentDescription depthAttachment{};
   depthAttachment.format = findDepthFormat();
   depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+  // The depth store pass keeps depth around so that CvkDepthPyramid can read it.
+  depthAttachment.storeOp =
+      type == PassType::DepthStore ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
   depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachment.initialLayout =
+      clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  depthAttachment.finalLayout = type == PassType::DepthStore
+      ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+      : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
   VkAttachmentReference depthAttachmentRef{};
   depthAttachmentRef.attachment = 1;
@@ -232,12 +400,15 @@ void CvkSwapchain::createRenderPass() {
   VkAttachmentDescription colorAttachment = {};
   colorAttachment.format = getSwapChainImageFormat();
   colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
   colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
   colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
   colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  colorAttachment.initialLayout =
+      clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment.finalLayout = type == PassType::DepthStore
+      ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+      : presentLayout;
 
   VkAttachmentReference colorAttachmentRef = {};
   colorAttachmentRef.attachment = 0;
@@ -249,7 +420,8 @@ void CvkSwapchain::createRenderPass() {
   subpass.pColorAttachments = &colorAttachmentRef;
   subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-  VkSubpassDependency dependency = {};
+  std::vector<VkSubpassDependency> dependencies(1);
+  VkSubpassDependency &dependency = dependencies[0];
   dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
   dependency.srcAccessMask = 0;
   dependency.srcStageMask =
@@ -260,6 +432,28 @@ void CvkSwapchain::createRenderPass() {
   dependency.dstAccessMask =
       VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
+  if (type == PassType::DepthStore) {
+    // Depth and color writes have to land before the compute reads depth and before the continue pass loads both.
+    VkSubpassDependency storeDependency = {};
+    storeDependency.srcSubpass = 0;
+    storeDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+    storeDependency.srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    storeDependency.srcAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    storeDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    storeDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+    dependencies.push_back(storeDependency);
+  } else if (type == PassType::Continue) {
+    // Loading depth back transitions it out of READ_ONLY, which must wait for the compute reads in between.
+    dependency.srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependency.dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask |=
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  }
+
   std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -267,12 +461,14 @@ void CvkSwapchain::createRenderPass() {
   renderPassInfo.pAttachments = attachments.data();
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
 
-  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+  VkRenderPass result;
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &result) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+  return result;
 }
 
 void CvkSwapchain::createFramebuffers() {
@@ -305,6 +501,11 @@ void CvkSwapchain::createDepthResources() {
   swapChainDepthFormat = depthFormat;
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
+  // Sampled as well where the format allows it, so occlusion culling can build a depth pyramid from it.
+  VkFormatProperties formatProperties;
+  vkGetPhysicalDeviceFormatProperties(device.getPhysicalDevice(), depthFormat, &formatProperties);
+  depthSampleable = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
   depthImages.resize(imageCount());
   depthImageMemorys.resize(imageCount());
   depthImageViews.resize(imageCount());
@@ -322,6 +523,7 @@ void CvkSwapchain::createDepthResources() {
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (depthSampleable) { imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT; }
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
@@ -350,9 +552,9 @@ void CvkSwapchain::createDepthResources() {
 }
 
 void CvkSwapchain::createSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(framesInFlight);
+  renderFinishedSemaphores.resize(framesInFlight);
+  inFlightFences.resize(framesInFlight);
   imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -362,7 +564,7 @@ void CvkSwapchain::createSyncObjects() {
   fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
     if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) !=
             VK_SUCCESS ||
         vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) !=
@@ -385,26 +587,31 @@ VkSurfaceFormatKHR CvkSwapchain::chooseSwapSurfaceFormat(
   return availableFormats[0];
 }
 
+// The preferred mode (still in presentMode) if the surface has it. FIFO is the only one every surface must support.
 VkPresentModeKHR CvkSwapchain::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
   for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      std::cout << "Present mode: Mailbox" << std::endl;
+    if (availablePresentMode == presentMode) {
+      std::cout << "Present mode: " << presentModeName(presentMode) << std::endl;
       return availablePresentMode;
     }
   }
 
-  // for (const auto &availablePresentMode : availablePresentModes) {
-  //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-  //     std::cout << "Present mode: Immediate" << std::endl;
-  //     return availablePresentMode;
-  //   }
-  // }
-
-  std::cout << "Present mode: V-Sync" << std::endl;
+  std::cout << "Present mode: " << presentModeName(presentMode) << " is not supported, using "
+            << presentModeName(VK_PRESENT_MODE_FIFO_KHR) << std::endl;
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+const char *CvkSwapchain::presentModeName(VkPresentModeKHR mode) {
+  switch (mode) {
+    case VK_PRESENT_MODE_FIFO_KHR: return "V-Sync (FIFO)";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "Relaxed V-Sync (FIFO relaxed)";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "Mailbox";
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "Immediate";
+    default: return "Unknown";
+  }
+}
+
 VkExtent2D CvkSwapchain::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
@@ -6,6 +6,7 @@
 #include <vulkan/vulkan.h>
 
 // std lib headers
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -15,10 +16,29 @@ namespace cvk {
 class CvkSwapchain {
 public:
   
-    static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-    CvkSwapchain(CvkDevice &deviceRef, VkExtent2D windowExtent);
-    CvkSwapchain(CvkDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<CvkSwapchain> previous);
+    // Upper bound of getFramesInFlight(). Per-frame resources outside of the swapchain (command buffers, UBOs,
+    // descriptor sets) are allocated for this many, so the number of frames in flight can change whenever the
+    // swapchain is recreated without reallocating any of them. Frame indices stay below getFramesInFlight().
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
+    // 1 has the lowest latency, the CPU waits for the GPU every frame. More let the CPU record ahead.
+    static constexpr uint32_t DEFAULT_FRAMES_IN_FLIGHT = 2;
+
+    // With dynamicRendering no render passes or framebuffers are created, recreation only touches the images
+    // and their views. getRenderPass() and friends return VK_NULL_HANDLE then.
+    // preferredPresentMode falls back to FIFO if the surface doesn't support it, see getPresentMode().
+    CvkSwapchain(
+        CvkDevice &deviceRef,
+        VkExtent2D windowExtent,
+        bool dynamicRendering = false,
+        VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR,
+        uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
+    CvkSwapchain(
+        CvkDevice &deviceRef,
+        VkExtent2D windowExtent,
+        std::shared_ptr<CvkSwapchain> previous,
+        bool dynamicRendering = false,
+        VkPresentModeKHR preferredPresentMode = VK_PRESENT_MODE_MAILBOX_KHR,
+        uint32_t framesInFlight = DEFAULT_FRAMES_IN_FLIGHT);
     ~CvkSwapchain();
 
     CvkSwapchain(const CvkSwapchain &) = delete;
@@ -26,10 +46,30 @@ public:
 
     VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
     VkRenderPass getRenderPass() { return renderPass; }
+    // Occlusion culling splits the frame into two passes with a depth read in between. The depth store pass
+    // clears and keeps depth (READ_ONLY layout, ready for sampling), the continue pass loads color and depth
+    // back in and presents. Both are compatible with getRenderPass() and its framebuffers.
+    VkRenderPass getDepthStoreRenderPass() { return depthStoreRenderPass; }
+    VkRenderPass getContinueRenderPass() { return continueRenderPass; }
+    VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+    bool isDepthSampleable() const { return depthSampleable; }
+    VkImage getDepthImage(int index) { return depthImages[index]; }
+    VkImage getImage(int index) { return swapChainImages[index]; }
     VkImageView getImageView(int index) { return swapChainImageViews[index]; }
     size_t imageCount() { return swapChainImages.size(); }
     VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
+    VkFormat getSwapChainDepthFormat() { return swapChainDepthFormat; }
     VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+    // The mode actually in use. Meaningless when headless, nothing is presented.
+    VkPresentModeKHR getPresentMode() const { return presentMode; }
+    static const char *presentModeName(VkPresentModeKHR mode);
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+    // Blocks until every frame submitted through this swapchain has finished on the GPU.
+    void waitForFrames();
+    // How long the last frame blocked on fences before it could be recorded, i.e. waited for the GPU.
+    double getLastFenceWaitMilliseconds() const { return lastFenceWaitMilliseconds; }
+    // Where finished frames end up: PRESENT_SRC_KHR, or TRANSFER_SRC_OPTIMAL when headless.
+    VkImageLayout getPresentLayout() const { return presentLayout; }
     uint32_t width() { return swapChainExtent.width; }
     uint32_t height() { return swapChainExtent.height; }
 
@@ -40,6 +80,8 @@ public:
 
     VkResult acquireNextImage(uint32_t *imageIndex);
     VkResult submitCommandBuffers(const VkCommandBuffer *buffers, uint32_t *imageIndex);
+    // Headless only. Waits for the device and copies a finished image out as tightly packed 8-bit RGBA.
+    void readImage(int index, std::vector<uint8_t> &rgba);
 
     bool compareSwapFormats(const CvkSwapchain& swapChain) const {
       return swapChain.swapChainDepthFormat == swapChainDepthFormat &&
@@ -48,9 +90,13 @@ public:
 private:
     void init();
     void createSwapChain();
+    // Headless replacement for createSwapChain(), one color image per frame in flight.
+    void createOffscreenImages();
     void createImageViews();
     void createDepthResources();
+    enum class PassType { Full, DepthStore, Continue };
     void createRenderPass();
+    VkRenderPass createRenderPass(PassType type);
     void createFramebuffers();
     void createSyncObjects();
 
@@ -66,18 +112,27 @@ private:
     VkExtent2D swapChainExtent;
 
     std::vector<VkFramebuffer> swapChainFramebuffers;
-    VkRenderPass renderPass;
+    bool dynamicRendering;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkRenderPass depthStoreRenderPass = VK_NULL_HANDLE;
+    VkRenderPass continueRenderPass = VK_NULL_HANDLE;
+    bool depthSampleable = false;
 
     std::vector<VkImage> depthImages;
     std::vector<VkDeviceMemory> depthImageMemorys;
     std::vector<VkImageView> depthImageViews;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
+    std::vector<VkDeviceMemory> offscreenImageMemorys;
+    VkImageLayout presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    VkPresentModeKHR presentMode; // the preferred one until createSwapChain() picked
+    uint32_t framesInFlight;
+    double lastFenceWaitMilliseconds = 0.0;
 
     CvkDevice &device;
     VkExtent2D windowExtent;
 
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::shared_ptr<CvkSwapchain> oldSwapChain;
 
     std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace cvk {
+
+/*
+Sampled RGBA8 texture, uploaded once through a staging buffer and then left in SHADER_READ_ONLY_OPTIMAL.
+No mip maps, the textures this is used for are small and procedural.
+*/
+class CvkTexture {
+public:
+    // pixels holds width * height RGBA values, row by row.
+    CvkTexture(CvkDevice &device, uint32_t width, uint32_t height, const std::vector<uint32_t> &pixels);
+    ~CvkTexture();
+
+    CvkTexture(const CvkTexture &) = delete;
+    CvkTexture &operator=(const CvkTexture &) = delete;
+
+    // Two colors in squares of cellSize pixels, size x size in total.
+    static std::vector<uint32_t> checkerPixels(uint32_t size, uint32_t cellSize, uint32_t colorA, uint32_t colorB);
+
+    VkDescriptorImageInfo descriptorInfo() const {
+        return VkDescriptorImageInfo{sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    }
+
+private:
+    void createImage(uint32_t width, uint32_t height, const std::vector<uint32_t> &pixels);
+    void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
+    void createSampler();
+
+    CvkDevice &cvkDevice;
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+};
+
+} // namespace cvk
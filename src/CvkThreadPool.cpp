@@ -0,0 +1,84 @@
+#include "CvkThreadPool.hpp"
+
+// std
+#include <algorithm>
+
+namespace cvk {
+
+CvkThreadPool::CvkThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++) {
+        workers.emplace_back(&CvkThreadPool::workerLoop, this, i);
+    }
+}
+
+CvkThreadPool::~CvkThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void CvkThreadPool::run(uint32_t count, const Job &job) {
+    if (count == 0) { return; }
+
+    std::unique_lock<std::mutex> lock{mutex};
+    currentJob = &job;
+    jobCount = count;
+    finishedJobs = 0;
+    nextJob.store(0);
+    batch++;
+    wakeCondition.notify_all();
+    doneCondition.wait(lock, [this] { return finishedJobs == jobCount && activeWorkers == 0; });
+    currentJob = nullptr;
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void CvkThreadPool::workerLoop(uint32_t threadIndex) {
+    uint64_t seenBatch = 0;
+    while (true) {
+        const Job *job;
+        uint32_t count;
+        {
+            std::unique_lock<std::mutex> lock{mutex};
+            wakeCondition.wait(lock, [&] { return stopping || batch != seenBatch; });
+            if (stopping) { return; }
+            seenBatch = batch;
+            // Woke up after the batch was already finished and handed back.
+            if (currentJob == nullptr) { continue; }
+            job = currentJob;
+            count = jobCount;
+            activeWorkers++;
+        }
+
+        uint32_t done = 0;
+        for (uint32_t jobIndex = nextJob.fetch_add(1); jobIndex < count; jobIndex = nextJob.fetch_add(1)) {
+            try {
+                (*job)(threadIndex, jobIndex);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{mutex};
+                if (!firstError) { firstError = std::current_exception(); }
+            }
+            done++;
+        }
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            finishedJobs += done;
+            activeWorkers--;
+            if (finishedJobs == jobCount && activeWorkers == 0) { doneCondition.notify_one(); }
+        }
+    }
+}
+
+} // namespace cvk
@@ -0,0 +1,55 @@
+#pragma once
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cvk {
+
+/*
+Fixed set of worker threads that run batches of jobs. A batch is handed out through an atomic counter,
+so faster workers simply pick up more jobs, and run() only returns once every job of the batch is done.
+Jobs get the index of the worker running them, which is what per-thread resources are keyed on.
+*/
+class CvkThreadPool {
+public:
+    using Job = std::function<void(uint32_t threadIndex, uint32_t jobIndex)>;
+
+    // 0 picks one thread per hardware thread.
+    explicit CvkThreadPool(uint32_t threadCount = 0);
+    ~CvkThreadPool();
+
+    CvkThreadPool(const CvkThreadPool &) = delete;
+    CvkThreadPool &operator=(const CvkThreadPool &) = delete;
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+    // Runs job(threadIndex, jobIndex) for every jobIndex in [0, jobCount) and blocks until all are finished.
+    // The first exception thrown by a job is rethrown here.
+    void run(uint32_t jobCount, const Job &job);
+
+private:
+    void workerLoop(uint32_t threadIndex);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const Job *currentJob = nullptr;
+    uint64_t batch = 0;
+    uint32_t jobCount = 0;
+    uint32_t finishedJobs = 0;
+    uint32_t activeWorkers = 0; // workers inside the current batch, run() must not return while they still hold it
+    std::atomic<uint32_t> nextJob{0};
+    std::exception_ptr firstError;
+    bool stopping = false;
+};
+
+} // namespace cvk
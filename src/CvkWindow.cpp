@@ -3,10 +3,11 @@
 
 namespace cvk {
 
-CvkWindow::CvkWindow(int w, int h, std::string name) : width{w}, height{h}, windowName{name} {
-    initWindow();
+CvkWindow::CvkWindow(int w, int h, std::string name, bool headless) : width{w}, height{h}, windowName{name} {
+    if (!headless) { initWindow(); }
 }
 CvkWindow::~CvkWindow() {
+    if (window == nullptr) { return; }
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -19,9 +20,19 @@ void CvkWindow::initWindow() {
     glfwSetWindowUserPointer(window, this);
     // Call function with window,new_width and new_height params when a window resize event occurs.
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    // Called when the window contents got damaged (uncovered, restored etc.) and need to be drawn again.
+    glfwSetWindowRefreshCallback(window, windowRefreshCallback);
+}
+
+void CvkWindow::requestClose() {
+    closeRequested = true;
+    if (window != nullptr) { glfwSetWindowShouldClose(window, GLFW_TRUE); }
 }
 
 void CvkWindow::createWindowSurface(VkInstance instance,VkSurfaceKHR *surface) {
+    if (window == nullptr) {
+        throw std::runtime_error("Headless windows have no surface.");
+    }
     if(glfwCreateWindowSurface(instance, window, nullptr, surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create Window Surface.");
     }
@@ -32,6 +43,12 @@ void CvkWindow::framebufferResizeCallback(GLFWwindow *window, int width, int hei
     cvkWindow->framebufferResized = true;
     cvkWindow->width = width;
     cvkWindow->height = height;
+    cvkWindow->redrawRequested = true;
+}
+
+void CvkWindow::windowRefreshCallback(GLFWwindow *window) {
+    auto cvkWindow = reinterpret_cast<CvkWindow*> (glfwGetWindowUserPointer(window));
+    cvkWindow->redrawRequested = true;
 }
 
 } // namespace cvk
\ No newline at end of file
@@ -2,13 +2,16 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <atomic>
 #include <string>
 
 namespace cvk {
     
 class CvkWindow {
 public:
-    CvkWindow(int w, int h, std::string name);
+    // A headless window never touches GLFW, it only carries the extent. CvkDevice then skips the surface and
+    // CvkSwapchain renders into images of its own, so nothing needs a display.
+    CvkWindow(int w, int h, std::string name, bool headless = false);
     ~CvkWindow();
 
     /*
@@ -20,23 +23,36 @@ public:
     CvkWindow(const CvkWindow &) = delete;
     CvkWindow &operator=(const CvkWindow &) = delete;
 
-    bool shouldClose() { return glfwWindowShouldClose(window); }
+    bool shouldClose() { return closeRequested || (window != nullptr && glfwWindowShouldClose(window)); }
+    void requestClose();
+    bool isHeadless() const { return window == nullptr; }
     VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; }
     bool wasWindowResized() { return framebufferResized; }
     void resetWindowResizedFlag() { framebufferResized = false; }
+    // Anything that changes the picture outside of the update loop (resizes, expose events, finished uploads)
+    // asks for a redraw, the on-demand loop in MainApp picks it up. Safe to call from any thread,
+    // the empty event wakes up glfwWaitEventsTimeout right away.
+    void requestRedraw() {
+        redrawRequested = true;
+        if (window != nullptr) { glfwPostEmptyEvent(); }
+    }
+    bool consumeRedrawRequest() { return redrawRequested.exchange(false); }
     GLFWwindow * getGLFWWindow() const { return window; }
 
     void createWindowSurface(VkInstance instance,VkSurfaceKHR *surface);
 private:
     static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+    static void windowRefreshCallback(GLFWwindow *window);
     void initWindow();
 
     int width;
     int height;
     bool framebufferResized = false;
+    std::atomic<bool> redrawRequested{true}; // the first frame always has to be drawn
+    bool closeRequested = false;
 
     std::string windowName;
-    GLFWwindow *window;
+    GLFWwindow *window = nullptr; // nullptr when headless
 };
 
 } // namespace cvk
\ No newline at end of file
@@ -0,0 +1,517 @@
+#include "IndirectRenderSystem.hpp"
+#include "CvkSwapchain.hpp"
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace cvk {
+
+// Must match CullData in shaders/cull.comp (std140)
+struct CullData {
+    glm::vec4 frustumPlanes[6];
+    glm::mat4 viewProjection;
+    glm::mat4 previousViewProjection;
+    uint32_t objectCount;
+    uint32_t meshCount;
+    uint32_t earlyOcclusion;
+};
+
+// Must match StatsBuffer in shaders/cull.comp
+struct CullStats {
+    uint32_t frustumCulled;
+    uint32_t drawnEarly;
+    uint32_t drawnLate;
+    uint32_t occluded;
+};
+
+// Must match Push in shaders/cull.comp
+struct CullPushConstants {
+    uint32_t phase;
+};
+
+static constexpr uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x in shaders/cull.comp
+
+IndirectRenderSystem::IndirectRenderSystem(
+CvkDevice &device,
+const PipelineRenderTarget &renderTarget,
+const MasterRenderSystem &masterRenderSystem,
+const std::vector<CvkGameObject> &gameObjects,
+bool gpuCulling,
+bool occlusionCulling,
+CvkPipelineBuilder *pipelineBuilder)
+: cvkDevice{device}, gpuCulling{gpuCulling || occlusionCulling}, occlusionCulling{occlusionCulling} {
+    if (this->gpuCulling && !cvkDevice.enabledFeatures().drawIndirectFirstInstance) {
+        // The culled commands only exist on the GPU, so there is nothing to replay as direct draws.
+        std::cerr << "GPU culling needs drawIndirectFirstInstance, falling back to CPU-built commands\n";
+        this->gpuCulling = false;
+        this->occlusionCulling = false;
+    }
+
+    std::vector<const CvkModel*> models;
+    for (auto &obj : gameObjects) {
+        if (obj.model) { models.push_back(obj.model.get()); }
+    }
+    geometryBuffer = std::make_unique<CvkGeometryBuffer>(cvkDevice, models);
+
+    if (this->gpuCulling) {
+        createMeshBuffer();
+        depthPyramid = std::make_unique<CvkDepthPyramid>(cvkDevice);
+    }
+    createDescriptors(masterRenderSystem);
+    createPipelineLayout(masterRenderSystem);
+    createPipeline(renderTarget, pipelineBuilder);
+    if (this->gpuCulling) { createCullPipeline(); }
+}
+IndirectRenderSystem::~IndirectRenderSystem() {
+    vkDestroyPipelineLayout(cvkDevice.device(), pipelineLayout, nullptr);
+    if (cullPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(cvkDevice.device(), cullPipelineLayout, nullptr);
+    }
+}
+
+void IndirectRenderSystem::createDescriptors(const MasterRenderSystem &masterRenderSystem) {
+    // objects, instance list, draw commands, mesh bounds, visibility states, stats, the cull data and the layers.
+    // The graphics side only reads the first two.
+    objectPool = CvkDescriptorPool::Builder(cvkDevice)
+        .setMaxSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 * CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .build();
+    const VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    auto layoutBuilder = CvkDescriptorSetLayout::Builder(cvkDevice);
+    layoutBuilder
+        .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stages);
+    if (gpuCulling) {
+        layoutBuilder
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(6, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(7, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    objectSetLayout = layoutBuilder.build();
+
+    // Occlusion culling keeps a second set of commands for the late phase right behind the first.
+    const uint32_t commandCount = geometryBuffer->getMeshCount() * (occlusionCulling ? 2 : 1);
+    objectBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    instanceBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    indirectBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    countBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    cullDataBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    cullStatsBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    visibilityBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    layerBufferInfos.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    objectDescriptorSets.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    drawCounts.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT, 0);
+    objectCounts.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT, 0);
+    for (int i = 0; i < CvkSwapchain::MAX_FRAMES_IN_FLIGHT; i++) {
+        // HOST_COHERENT, since the whole buffer is rewritten every frame anyways.
+        // STORAGE as well, cull.comp counts the visible instances straight into the commands.
+        indirectBuffers[i] = std::make_unique<CvkBuffer>(
+            cvkDevice,
+            sizeof(VkDrawIndexedIndirectCommand),
+            commandCount,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        indirectBuffers[i]->map();
+        countBuffers[i] = std::make_unique<CvkBuffer>(
+            cvkDevice,
+            sizeof(uint32_t),
+            1,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        countBuffers[i]->map();
+        if (gpuCulling) {
+            cullDataBuffers[i] = std::make_unique<CvkBuffer>(
+                cvkDevice,
+                sizeof(CullData),
+                1,
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            cullDataBuffers[i]->map();
+            cullStatsBuffers[i] = std::make_unique<CvkBuffer>(
+                cvkDevice,
+                sizeof(CullStats),
+                1,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            cullStatsBuffers[i]->map();
+            CullStats zero{};
+            cullStatsBuffers[i]->writeToBuffer(&zero);
+            layerBufferInfos[i] = masterRenderSystem.getLayerBufferInfo(i);
+        }
+        ensureObjectCapacity(i, 1);
+    }
+}
+
+void IndirectRenderSystem::createMeshBuffer() {
+    const uint32_t meshCount = geometryBuffer->getMeshCount();
+    meshBuffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        sizeof(glm::vec4),
+        meshCount,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    meshBuffer->map();
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+        glm::vec4 sphere = geometryBuffer->getMeshModel(mesh).getBoundingSphere();
+        meshBuffer->writeToIndex(&sphere, mesh);
+    }
+    meshBuffer->unmap();
+}
+
+// Grows the object and instance buffers of a frame, the old ones are no longer in use once that frame's fence was waited on.
+void IndirectRenderSystem::ensureObjectCapacity(int frameIndex, uint32_t objectCount) {
+    auto &buffer = objectBuffers[frameIndex];
+    if (buffer && buffer->getInstanceCount() >= objectCount) { return; }
+
+    uint32_t capacity = buffer ? buffer->getInstanceCount() : 1;
+    while (capacity < objectCount) { capacity *= 2; }
+    buffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        sizeof(ObjectData),
+        capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    buffer->map();
+    // The late phase's instances go behind the early ones, so the list has room for every object twice.
+    instanceBuffers[frameIndex] = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        sizeof(uint32_t),
+        capacity * (occlusionCulling ? 2 : 1),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    instanceBuffers[frameIndex]->map();
+    if (gpuCulling) {
+        // Written and read by cull.comp only.
+        visibilityBuffers[frameIndex] = std::make_unique<CvkBuffer>(
+            cvkDevice,
+            sizeof(uint32_t),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    writeObjectDescriptorSet(frameIndex);
+}
+
+void IndirectRenderSystem::writeObjectDescriptorSet(int frameIndex) {
+    auto objectInfo = objectBuffers[frameIndex]->descriptorInfo();
+    auto instanceInfo = instanceBuffers[frameIndex]->descriptorInfo();
+    auto commandInfo = indirectBuffers[frameIndex]->descriptorInfo();
+    VkDescriptorBufferInfo meshInfo{};
+    VkDescriptorBufferInfo visibilityInfo{};
+    VkDescriptorBufferInfo statsInfo{};
+    VkDescriptorBufferInfo cullDataInfo{};
+    CvkDescriptorWriter writer(*objectSetLayout, *objectPool);
+    writer.writeBuffer(0, &objectInfo);
+    writer.writeBuffer(1, &instanceInfo);
+    if (gpuCulling) {
+        meshInfo = meshBuffer->descriptorInfo();
+        visibilityInfo = visibilityBuffers[frameIndex]->descriptorInfo();
+        statsInfo = cullStatsBuffers[frameIndex]->descriptorInfo();
+        cullDataInfo = cullDataBuffers[frameIndex]->descriptorInfo();
+        writer.writeBuffer(2, &commandInfo);
+        writer.writeBuffer(3, &meshInfo);
+        writer.writeBuffer(4, &visibilityInfo);
+        writer.writeBuffer(5, &statsInfo);
+        writer.writeBuffer(6, &cullDataInfo);
+        writer.writeBuffer(7, &layerBufferInfos[frameIndex]);
+    }
+    if (objectDescriptorSets[frameIndex] == VK_NULL_HANDLE) {
+        writer.build(objectDescriptorSets[frameIndex]);
+    } else {
+        writer.overwrite(objectDescriptorSets[frameIndex]);
+    }
+}
+
+void IndirectRenderSystem::createPipelineLayout(const MasterRenderSystem &masterRenderSystem) {
+    // Everything per object comes from the storage buffer at set 1, the push constants are unused.
+    pipelineLayout = masterRenderSystem.createPipelineLayout({objectSetLayout->getDescriptorSetLayout()});
+}
+void IndirectRenderSystem::createPipeline(const PipelineRenderTarget &renderTarget, CvkPipelineBuilder *pipelineBuilder) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before Pipeline Layout!");
+
+    cvkPipeline = std::make_unique<CvkPipelineVariants>(
+        cvkDevice,
+        "shaders/indirect_shader.vert",
+        "shaders/simple_shader.frag",
+        [renderTarget, layout = pipelineLayout](PipelineConfigInfo &pipelineConfig) {
+            CvkPipeline::defaultPipelineConfigInfo(pipelineConfig);
+            renderTarget.apply(pipelineConfig);
+            pipelineConfig.pipelineLayout = layout;
+        },
+        pipelineBuilder);
+    cvkPipeline->prefetch({});
+}
+
+void IndirectRenderSystem::createCullPipeline() {
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(CullPushConstants);
+
+    VkDescriptorSetLayout setLayouts[] = {
+        objectSetLayout->getDescriptorSetLayout(),
+        depthPyramid->getDescriptorSetLayout()};
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(cvkDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create cull Pipeline Layout!");
+    }
+    cullPipeline = std::make_unique<CvkComputePipeline>(cvkDevice, "shaders/cull.comp", cullPipelineLayout);
+}
+
+// Objects go into the storage buffer in scene order, only their indices get bucketed by mesh (counting sort),
+// so all instances of a mesh are contiguous in the instance list and one draw command per mesh covers them.
+// With GPU culling the CPU only lays out the per-mesh slices and cull.comp fills them.
+void IndirectRenderSystem::writeObjects(int frameIndex, std::vector<CvkGameObject> &gameObjects) {
+    const uint32_t meshCount = geometryBuffer->getMeshCount();
+    meshInstanceCounts.assign(meshCount, 0);
+    meshFirstInstance.assign(meshCount, 0);
+
+    for (auto &obj : gameObjects) {
+        if (obj.model == nullptr || !geometryBuffer->contains(obj.model.get())) { continue; }
+        meshInstanceCounts[geometryBuffer->getMeshIndex(obj.model.get())]++;
+    }
+    uint32_t objectCount = 0;
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+        meshFirstInstance[mesh] = objectCount;
+        objectCount += meshInstanceCounts[mesh];
+    }
+    ensureObjectCapacity(frameIndex, std::max(objectCount, 1u));
+    objectCounts[frameIndex] = objectCount;
+
+    auto objectData = static_cast<ObjectData*>(objectBuffers[frameIndex]->getMappedMemory());
+    auto objectIndices = static_cast<uint32_t*>(instanceBuffers[frameIndex]->getMappedMemory());
+    meshCursor.assign(meshFirstInstance.begin(), meshFirstInstance.end());
+    uint32_t objectIndex = 0;
+    for (auto &obj : gameObjects) {
+        if (obj.model == nullptr || !geometryBuffer->contains(obj.model.get())) { continue; }
+        uint32_t meshIndex = geometryBuffer->getMeshIndex(obj.model.get());
+        objectData[objectIndex] = ObjectData::fromGameObject(obj);
+        objectData[objectIndex].meshIndex = meshIndex;
+        if (!gpuCulling) { objectIndices[meshCursor[meshIndex]++] = objectIndex; }
+        objectIndex++;
+    }
+
+    auto commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffers[frameIndex]->getMappedMemory());
+    uint32_t drawCount = 0;
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+        uint32_t instanceCount = meshInstanceCounts[mesh];
+        // cull.comp indexes the commands by mesh, so with GPU culling every mesh keeps its command (at 0 instances).
+        // Otherwise only meshes that actually have instances get a command, so drawCount stays tight.
+        if (!gpuCulling && instanceCount == 0) { continue; }
+        const auto &range = geometryBuffer->getMeshRange(mesh);
+        VkDrawIndexedIndirectCommand &command = commands[drawCount++];
+        command.indexCount = range.indexCount;
+        command.instanceCount = gpuCulling ? 0 : instanceCount;
+        command.firstIndex = range.firstIndex;
+        command.vertexOffset = range.vertexOffset;
+        command.firstInstance = meshFirstInstance[mesh];
+        if (occlusionCulling) {
+            // Same mesh in the late half, its instances start behind all of the early ones.
+            commands[meshCount + mesh] = command;
+            commands[meshCount + mesh].firstInstance += objectCount;
+        }
+    }
+    *static_cast<uint32_t*>(countBuffers[frameIndex]->getMappedMemory()) = drawCount;
+    drawCounts[frameIndex] = drawCount;
+}
+
+void IndirectRenderSystem::writeCullData(FrameInfo& frameInfo) {
+    viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+
+    CullData data{};
+    const auto planes = frameInfo.camera.getFrustumPlanes();
+    std::copy(planes.begin(), planes.end(), data.frustumPlanes);
+    data.viewProjection = viewProjection;
+    data.previousViewProjection = previousViewProjection;
+    data.objectCount = objectCounts[frameInfo.frameIndex];
+    data.meshCount = geometryBuffer->getMeshCount();
+    data.earlyOcclusion = occlusionCulling && depthPyramid->isValid() ? 1 : 0;
+    cullDataBuffers[frameInfo.frameIndex]->writeToBuffer(&data);
+}
+
+// The counters of this frame index were written by its previous submission, which beginFrame already waited on.
+// So the numbers lag CvkRenderer::getFramesInFlight() frames behind, good enough for --stats.
+void IndirectRenderSystem::readCullStats(FrameInfo& frameInfo) {
+    auto &buffer = cullStatsBuffers[frameInfo.frameIndex];
+    CullStats stats = *static_cast<CullStats*>(buffer->getMappedMemory());
+    frameInfo.stats.visibleObjects = stats.drawnEarly + stats.drawnLate;
+    frameInfo.stats.culledObjects = stats.frustumCulled + stats.occluded;
+    frameInfo.stats.occludedObjects = stats.occluded;
+
+    CullStats zero{};
+    buffer->writeToBuffer(&zero);
+}
+
+// One thread per object, the host writes above are made visible by the queue submit itself,
+// only the compute writes need a barrier before the indirect read and the vertex shader.
+void IndirectRenderSystem::recordCulling(FrameInfo& frameInfo, uint32_t phase) {
+    const uint32_t objectCount = objectCounts[frameInfo.frameIndex];
+    if (objectCount == 0) { return; }
+
+    cullPipeline->bind(frameInfo.commandBuffer);
+    VkDescriptorSet descriptorSets[] = {
+        objectDescriptorSets[frameInfo.frameIndex],
+        depthPyramid->getDescriptorSet()};
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        cullPipelineLayout,
+        0,
+        2,
+        descriptorSets,
+        0,
+        nullptr);
+
+    CullPushConstants push{};
+    push.phase = phase;
+    vkCmdPushConstants(
+        frameInfo.commandBuffer,
+        cullPipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(CullPushConstants),
+        &push);
+    vkCmdDispatch(frameInfo.commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    // HOST as well for the stats, the fence wait alone doesn't make device writes host visible.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+}
+
+void IndirectRenderSystem::prepareFrame(FrameInfo& frameInfo, std::vector<CvkGameObject>& gameObjects, VkExtent2D depthExtent) {
+    writeObjects(frameInfo.frameIndex, gameObjects);
+    if (gpuCulling) {
+        // The survivors are only known on the GPU, the stats are last round's (see readCullStats).
+        if (occlusionCulling) { depthPyramid->resize(depthExtent); }
+        readCullStats(frameInfo);
+        writeCullData(frameInfo);
+        recordCulling(frameInfo, 0);
+    } else {
+        frameInfo.stats.visibleObjects = objectCounts[frameInfo.frameIndex];
+    }
+}
+
+void IndirectRenderSystem::prepareLatePhase(FrameInfo& frameInfo, VkImageView depthView) {
+    assert(occlusionCulling && "prepareLatePhase needs occlusion culling!");
+    depthPyramid->build(frameInfo.commandBuffer, frameInfo.frameIndex, depthView);
+    // The next frame's early phase tests against this pyramid.
+    previousViewProjection = viewProjection;
+
+    // The late dispatch reads the visibility states and bumps the counters of the early one.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+    recordCulling(frameInfo, 1);
+}
+
+void IndirectRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+    recordDraws(frameInfo, 0);
+}
+
+void IndirectRenderSystem::renderLateObjects(FrameInfo& frameInfo) {
+    assert(occlusionCulling && "renderLateObjects needs occlusion culling!");
+    recordDraws(frameInfo, geometryBuffer->getMeshCount());
+}
+
+// firstCommand is 0 for the early (or only) commands and meshCount for the late phase's.
+void IndirectRenderSystem::recordDraws(FrameInfo& frameInfo, uint32_t firstCommand) {
+    const uint32_t drawCount = drawCounts[frameInfo.frameIndex];
+    if (drawCount == 0) { return; }
+
+    cvkPipeline->get({}).bind(frameInfo.commandBuffer);
+    VkDescriptorSet descriptorSets[] = {
+        frameInfo.globalDescriptorSet,
+        objectDescriptorSets[frameInfo.frameIndex]};
+    // Set 0 stays as MasterRenderSystem bound it.
+    const uint32_t firstSet = frameInfo.globalSetBound ? 1 : 0;
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
+        0,
+        nullptr);
+    geometryBuffer->bind(frameInfo.commandBuffer);
+
+    VkBuffer indirectBuffer = indirectBuffers[frameInfo.frameIndex]->getBuffer();
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    const VkDeviceSize offset = firstCommand * stride;
+    const auto &features = cvkDevice.enabledFeatures();
+    if (!features.drawIndirectFirstInstance) {
+        // Indirect commands must keep firstInstance at 0 without this feature, so replay the
+        // CPU-side copy of the commands as direct draws instead.
+        auto commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffers[frameInfo.frameIndex]->getMappedMemory());
+        for (uint32_t i = 0; i < drawCount; i++) {
+            vkCmdDrawIndexed(
+                frameInfo.commandBuffer,
+                commands[i].indexCount,
+                commands[i].instanceCount,
+                commands[i].firstIndex,
+                commands[i].vertexOffset,
+                commands[i].firstInstance);
+        }
+    } else if (auto drawIndexedIndirectCount = cvkDevice.cmdDrawIndexedIndirectCount()) {
+        drawIndexedIndirectCount(
+            frameInfo.commandBuffer,
+            indirectBuffer,
+            offset,
+            countBuffers[frameInfo.frameIndex]->getBuffer(),
+            0,
+            geometryBuffer->getMeshCount(),
+            stride);
+    } else if (features.multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, indirectBuffer, offset, drawCount, stride);
+    } else {
+        // Without multiDrawIndirect every command needs its own call, still O(meshes) and not O(objects).
+        for (uint32_t i = 0; i < drawCount; i++) {
+            vkCmdDrawIndexedIndirect(frameInfo.commandBuffer, indirectBuffer, offset + i * stride, 1, stride);
+        }
+    }
+}
+
+} // namespace cvk
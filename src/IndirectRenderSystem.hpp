@@ -0,0 +1,121 @@
+#pragma once
+
+#include "CvkBuffer.hpp"
+#include "CvkCamera.hpp"
+#include "CvkComputePipeline.hpp"
+#include "CvkDepthPyramid.hpp"
+#include "CvkDescriptors.hpp"
+#include "CvkDevice.hpp"
+#include "CvkFrameInfo.hpp"
+#include "CvkGameObject.hpp"
+#include "CvkGeometryBuffer.hpp"
+#include "CvkObjectBuffer.hpp"
+#include "CvkPipeline.hpp"
+#include "MasterRenderSystem.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace cvk {
+
+/*
+GPU-driven render path. All models are packed into one CvkGeometryBuffer, per-object data goes into a
+storage buffer, and the CPU writes one VkDrawIndexedIndirectCommand per mesh range. The whole scene is
+then submitted with a single indirect call, so command recording no longer grows with object count.
+
+Objects are stored in scene order, the draws go through an instance list of object indices grouped by mesh.
+Without GPU culling the CPU fills that list, with it cull.comp tests every object against the frustum and
+appends only the visible ones, so the CPU never touches individual objects for culling.
+
+Occlusion culling (on top of GPU culling) splits the frame in two:
+    prepareFrame      early cull: frustum + occlusion against last frame's CvkDepthPyramid
+    renderGameObjects draws the early survivors, the render pass has to store depth
+    prepareLatePhase  builds the pyramid from that depth and re-tests the early phase's occluded objects
+    renderLateObjects draws the ones that turned out visible, in a render pass that loads color and depth
+Objects that were hidden last frame but got uncovered are caught by the late phase, so they show up in the
+same frame instead of one frame late.
+*/
+class IndirectRenderSystem {
+public:
+
+    IndirectRenderSystem(
+        CvkDevice &device,
+        const PipelineRenderTarget &renderTarget,
+        const MasterRenderSystem &masterRenderSystem,
+        const std::vector<CvkGameObject> &gameObjects,
+        bool gpuCulling = false,
+        bool occlusionCulling = false,
+        CvkPipelineBuilder *pipelineBuilder = nullptr);
+    ~IndirectRenderSystem();
+
+    IndirectRenderSystem(const IndirectRenderSystem &) = delete;
+    IndirectRenderSystem &operator=(const IndirectRenderSystem &) = delete;
+
+    // Uploads this frame's objects and, with GPU culling, records the culling dispatch.
+    // Has to be called outside of a render pass, so before beginSwapChainRenderPass.
+    // depthExtent is the swapchain's, the depth pyramid gets resized to it.
+    void prepareFrame(FrameInfo& frameInfo, std::vector<CvkGameObject> &gameObjects, VkExtent2D depthExtent);
+    void renderGameObjects(FrameInfo& frameInfo);
+    // Occlusion culling only, between the two render passes (see above). depthView holds what renderGameObjects drew.
+    void prepareLatePhase(FrameInfo& frameInfo, VkImageView depthView);
+    void renderLateObjects(FrameInfo& frameInfo);
+
+    bool isGpuCulling() const { return gpuCulling; }
+    bool isOcclusionCulling() const { return occlusionCulling; }
+private:
+    void createDescriptors(const MasterRenderSystem &masterRenderSystem);
+    void createMeshBuffer();
+    void createPipelineLayout(const MasterRenderSystem &masterRenderSystem);
+    void createPipeline(const PipelineRenderTarget &renderTarget, CvkPipelineBuilder *pipelineBuilder);
+    void createCullPipeline();
+    void ensureObjectCapacity(int frameIndex, uint32_t objectCount);
+    void writeObjectDescriptorSet(int frameIndex);
+    void writeObjects(int frameIndex, std::vector<CvkGameObject> &gameObjects);
+    void writeCullData(FrameInfo& frameInfo);
+    void readCullStats(FrameInfo& frameInfo);
+    void recordCulling(FrameInfo& frameInfo, uint32_t phase);
+    void recordDraws(FrameInfo& frameInfo, uint32_t firstCommand);
+
+    CvkDevice &cvkDevice;
+    bool gpuCulling;
+    bool occlusionCulling;
+
+    std::unique_ptr<CvkGeometryBuffer> geometryBuffer;
+    // A single variant without constants, so it can be compiled on the pipeline builder along with everything else.
+    std::unique_ptr<CvkPipelineVariants> cvkPipeline;
+    VkPipelineLayout pipelineLayout;
+
+    std::unique_ptr<CvkComputePipeline> cullPipeline;
+    VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+    // Model space bounding sphere per mesh, static so it is only written once.
+    std::unique_ptr<CvkBuffer> meshBuffer;
+    // Always there with GPU culling, its placeholder keeps set 1 of the cull pipeline valid without occlusion culling.
+    std::unique_ptr<CvkDepthPyramid> depthPyramid;
+    glm::mat4 viewProjection{1.f};
+    glm::mat4 previousViewProjection{1.f}; // the matrix the pyramid's depth was rendered with
+
+    std::unique_ptr<CvkDescriptorPool> objectPool;
+    std::unique_ptr<CvkDescriptorSetLayout> objectSetLayout;
+    std::vector<VkDescriptorSet> objectDescriptorSets;
+    // MasterRenderSystem's layer UBOs, cull.comp widens the bounds of turning objects with them.
+    std::vector<VkDescriptorBufferInfo> layerBufferInfos;
+
+    // One set per frame in flight, the CPU rewrites them while the GPU reads the other frame's copy.
+    std::vector<std::unique_ptr<CvkBuffer>> objectBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> instanceBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> indirectBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> countBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> cullDataBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> cullStatsBuffers;   // read back once the frame's fence was waited on
+    std::vector<std::unique_ptr<CvkBuffer>> visibilityBuffers; // early phase result per object, GPU only
+    std::vector<uint32_t> drawCounts;
+    std::vector<uint32_t> objectCounts;
+
+    // Scratch space for the per-frame bucketing of objects by mesh.
+    std::vector<uint32_t> meshInstanceCounts;
+    std::vector<uint32_t> meshFirstInstance;
+    std::vector<uint32_t> meshCursor;
+};
+
+} // namespace cvk
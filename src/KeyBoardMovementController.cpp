@@ -1,7 +1,8 @@
 #include "KeyBoardMovementController.hpp"
 
 namespace cvk {
-    void KeyBoardMovementController::moveInPlaneXZ(GLFWwindow* window, float dt, CvkGameObject& gameObject) {
+    bool KeyBoardMovementController::moveInPlaneXZ(GLFWwindow* window, float dt, CvkGameObject& gameObject) {
+        const TransformComponent before = gameObject.transform;
         glm::vec3 rotate{0};
         if (glfwGetKey(window, keys.lookRight) == GLFW_PRESS) rotate.y += 1.f;
         if (glfwGetKey(window, keys.lookLeft) == GLFW_PRESS) rotate.y -= 1.f;
@@ -28,5 +29,6 @@ namespace cvk {
         if (glm::dot(moveDir, moveDir) > std::numeric_limits<float>::epsilon()) {
             gameObject.transform.translation += moveSpeed * dt * glm::normalize(moveDir);
         }
+        return gameObject.transform.translation != before.translation || gameObject.transform.rotation != before.rotation;
     }
 }
\ No newline at end of file
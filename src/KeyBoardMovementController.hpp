@@ -19,7 +19,8 @@ namespace cvk {
             int lookDown = GLFW_KEY_DOWN;
         };
 
-        void moveInPlaneXZ(GLFWwindow* window, float dt, CvkGameObject& gameObject);
+        // Returns true when the object was moved or turned this frame.
+        bool moveInPlaneXZ(GLFWwindow* window, float dt, CvkGameObject& gameObject);
         
         KeyMappings keys{};
         float moveSpeed{3.f};
@@ -1,6 +1,20 @@
 #include "MainApp.hpp"
+#include "MasterRenderSystem.hpp"
 #include "CvkCamera.hpp"
 #include "SimpleRenderSystem.hpp"
+#include "IndirectRenderSystem.hpp"
+#include "CvkFrustumCuller.hpp"
+#include "CvkRenderQueue.hpp"
+#include "CvkParallelRecorder.hpp"
+#include "CvkThreadPool.hpp"
+#include "CvkPipelineBuilder.hpp"
+#include "CvkCommandCache.hpp"
+#include "CvkFrameLimiter.hpp"
+#include "CvkGpuTimer.hpp"
+#include "CvkSceneTarget.hpp"
+#include "CvkTexture.hpp"
+#include "CvkRenderGraph.hpp"
+#include "UpscaleRenderSystem.hpp"
 #include "KeyBoardMovementController.hpp"
 #include "CvkBuffer.hpp"
 #include "MouseController.hpp"
@@ -10,26 +24,24 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/euler_angles.hpp>
 
 // std
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
 #include <chrono>
+#include <cmath>
+#include <fstream>
 
 const float MAX_FRAME_TIME = 10.f;
+// Longest the on-demand loop sleeps without events, mostly a safety net since requestRedraw() wakes it anyway.
+const double ON_DEMAND_WAIT_TIMEOUT = .5;
 
 namespace cvk {
 
-struct GlobalUbo {
-    alignas(16) glm::mat4 projectionView{1.f};
-    alignas(16) glm::vec3 lightDirection = glm::normalize(glm::vec3{-1.f, 3.f, 1.f});
-    // now a lot more things can be passed to the shaders
-};
-
-MainApp::MainApp() {
-    globalPool = CvkDescriptorPool::Builder(cvkDevice)
-        .setMaxSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
-        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
-        .build();
+MainApp::MainApp(const AppSettings &settings) : settings{settings} {
     // loads the game objects IMMEDIATELY after App is opened.
     loadGameObjects();
 }
@@ -38,38 +50,197 @@ MainApp::~MainApp() { }
 // Main Application commands -
 void MainApp::run() {
     
-    std::vector<std::unique_ptr<CvkBuffer>> uboBuffers(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < uboBuffers.size(); i++) {
-        uboBuffers[i] = std::make_unique<CvkBuffer>(
+    // Owns the global UBO and descriptor sets, and runs the render systems registered below pass by pass.
+    if (settings.dynamicRendering && !cvkRenderer.usesDynamicRendering()) {
+        std::cout << "VK_KHR_dynamic_rendering is not supported, --dynamic-rendering falls back to render passes\n";
+        settings.dynamicRendering = false;
+    }
+    // A render pass, or just the swapchain's formats with dynamic rendering.
+    const PipelineRenderTarget swapChainTarget = cvkRenderer.getSwapChainRenderTarget();
+
+    MasterRenderSystem masterRenderSystem{cvkDevice, settings.bindless};
+    if (settings.bindless && !masterRenderSystem.isBindless()) {
+        std::cout << "Descriptor indexing is not supported, --bindless falls back to the vertex colors\n";
+        settings.bindless = false;
+    }
+    // Referenced by masterRenderSystem's descriptor sets, only destroyed after the loop waited for the device.
+    std::unique_ptr<CvkTexture> checkerTexture;
+    if (settings.bindless) {
+        checkerTexture = std::make_unique<CvkTexture>(
             cvkDevice,
-            sizeof(GlobalUbo),
-            1,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-            // We do not use HOST_COHERENT bit here, because we only want to flush the buffer so that we don't
-            // interfere with the previous frame that might still be rendering.
-            // ! this is no longer the case now, but we are demoing the flush function anyways
-        );
-        uboBuffers[i]->map();
-    }
-
-    // TODO : Might be better to set up a Master Render system that handles the global descriptors.
-    auto globalSetLayout = CvkDescriptorSetLayout::Builder(cvkDevice)
-        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
-        .build();
-
-    std::vector<VkDescriptorSet> globalDescriptorSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
-    for (int i = 0; i < globalDescriptorSets.size(); i++) {
-        auto bufferInfo = uboBuffers[i]->descriptorInfo();
-        CvkDescriptorWriter(*globalSetLayout, *globalPool)
-            .writeBuffer(0, &bufferInfo)
-            .build(globalDescriptorSets[i]);
+            64,
+            64,
+            CvkTexture::checkerPixels(64, 8, 0xFFFFFFFF, 0xFF404040)); // RGBA bytes, little endian
+        const uint32_t checker = masterRenderSystem.addTexture(checkerTexture->descriptorInfo());
+        // Material 0 (plain white) stays the default, the objects cycle through the rest.
+        const std::vector<MasterRenderSystem::MaterialData> materials = {
+            {{1.f, 1.f, 1.f, 1.f}, checker},
+            {{1.f, .4f, .4f, 1.f}, MasterRenderSystem::NO_TEXTURE},
+            {{.4f, 1.f, .4f, 1.f}, checker},
+            {{.5f, .6f, 1.f, 1.f}, MasterRenderSystem::NO_TEXTURE},
+        };
+        std::vector<uint32_t> materialIndices;
+        for (const auto &material : materials) {
+            materialIndices.push_back(masterRenderSystem.addMaterial(material));
+        }
+        for (size_t i = 0; i < gameObjects.size(); i++) {
+            gameObjects[i].materialIndex = materialIndices[i % materialIndices.size()];
+        }
+    }
+
+    // The render systems only submit their pipelines while they are constructed, all of them compile side by side
+    // here and each system waits for its own on its first draw. Has to outlive the systems.
+    CvkPipelineBuilder pipelineBuilder{cvkDevice, settings.pipelineThreads, settings.pipelineLibrary};
+    if (settings.pipelineLibrary && !pipelineBuilder.usesPipelineLibrary()) {
+        std::cout << "VK_EXT_graphics_pipeline_library with fast linking is not supported, --pipeline-library falls back to full pipelines\n";
+        settings.pipelineLibrary = false;
     }
 
     SimpleRenderSystem simpleRenderSystem(
         cvkDevice,
-        cvkRenderer.getSwapChainRenderPass(),
-        globalSetLayout->getDescriptorSetLayout());
+        swapChainTarget,
+        masterRenderSystem,
+        settings.depthPrepass,
+        puzzleSize > 0, // only the puzzle turns layers, everything else gets the variant without the layer loop
+        &pipelineBuilder);
+    if (settings.occlusionCulling && !cvkRenderer.isSwapChainDepthSampleable()) {
+        std::cout << "Depth format can't be sampled, --hiz falls back to frustum culling only\n";
+        settings.occlusionCulling = false;
+    }
+    std::unique_ptr<IndirectRenderSystem> indirectRenderSystem;
+    if (settings.indirectDraw) {
+        indirectRenderSystem = std::make_unique<IndirectRenderSystem>(
+            cvkDevice,
+            swapChainTarget,
+            masterRenderSystem,
+            gameObjects,
+            settings.gpuCulling,
+            settings.occlusionCulling,
+            &pipelineBuilder);
+    }
+    CvkFrustumCuller frustumCuller{};
+    std::vector<uint32_t> visibleObjects;
+    CvkRenderQueue renderQueue{};
+
+    std::unique_ptr<CvkThreadPool> threadPool;
+    std::unique_ptr<CvkParallelRecorder> parallelRecorder;
+    if (settings.parallelRecording) {
+        threadPool = std::make_unique<CvkThreadPool>(settings.workerThreads);
+        parallelRecorder = std::make_unique<CvkParallelRecorder>(cvkDevice, *threadPool);
+    }
+
+    // Bumped on anything that invalidates recorded commands: transforms, the visible set or the swapchain.
+    uint64_t sceneRevision = 0;
+    uint32_t swapChainGeneration = cvkRenderer.getSwapChainGeneration();
+    std::vector<uint32_t> cachedVisibleObjects;
+    std::unique_ptr<CvkCommandCache> commandCache;
+    if (settings.cacheCommands) {
+        commandCache = std::make_unique<CvkCommandCache>(cvkDevice);
+    }
+
+    // Declared again every frame, the render passes, framebuffers and transient images behind it are cached.
+    CvkRenderGraph renderGraph{cvkDevice, cvkRenderer.usesDynamicRendering()};
+
+    // Dynamic resolution renders the scene offscreen and stretches it over the swapchain image afterwards.
+    std::unique_ptr<CvkSceneTarget> sceneTarget;
+    std::unique_ptr<UpscaleRenderSystem> upscaleRenderSystem;
+    if (settings.dynamicResolution && indirectRenderSystem && indirectRenderSystem->isOcclusionCulling()) {
+        std::cout << "--dynamic-res doesn't work together with --hiz yet, rendering at full resolution\n";
+    } else if (settings.dynamicResolution) {
+        sceneTarget = std::make_unique<CvkSceneTarget>(
+            cvkDevice,
+            cvkRenderer.getSwapChainImageFormat(),
+            settings.minRenderScale,
+            settings.maxRenderScale,
+            settings.gpuTargetMilliseconds);
+        upscaleRenderSystem = std::make_unique<UpscaleRenderSystem>(
+            cvkDevice,
+            swapChainTarget,
+            masterRenderSystem,
+            sceneTarget->getDescriptorSetLayout(),
+            &pipelineBuilder);
+    }
+
+    std::unique_ptr<CvkGpuTimer> gpuTimer;
+    if (settings.printStats || settings.benchmarkFrames > 0 || sceneTarget) {
+        gpuTimer = std::make_unique<CvkGpuTimer>(cvkDevice);
+        if (!gpuTimer->isSupported()) {
+            std::cout << "Graphics queue has no timestamps, GPU times are not available";
+            std::cout << (sceneTarget ? " and the resolution stays at its upper bound\n" : "\n");
+        }
+    }
+    if (settings.depthPrepass && indirectRenderSystem) {
+        std::cout << "--depth-prepass only applies to SimpleRenderSystem, ignored with --indirect\n";
+    }
+    if (settings.printStats) {
+        std::cout << "CPU culling: " << (settings.cpuCulling ? CvkFrustumCuller::simdPath() : "off") << "\n";
+    }
+
+    // The scene systems for this run's settings. Which path draws is fixed at startup, so it is picked here once
+    // instead of every frame.
+    const bool replayCached = !indirectRenderSystem && commandCache;
+    const bool recordParallel = !indirectRenderSystem && !replayCached && parallelRecorder;
+    if (indirectRenderSystem) {
+        masterRenderSystem.addSystem("scene", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &) {
+            indirectRenderSystem->renderGameObjects(frameInfo);
+        });
+        masterRenderSystem.addSystem("sceneLate", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &) {
+            indirectRenderSystem->renderLateObjects(frameInfo);
+        });
+    } else if (replayCached) {
+        masterRenderSystem.addSystem("scene", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &pass) {
+            // No framebuffer, the cached buffers are per frame in flight and get replayed on any swapchain image.
+            VkCommandBufferInheritanceInfo inheritanceInfo{};
+            inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritanceInfo.pNext = pass.renderingInheritance; // dynamic rendering only
+            inheritanceInfo.renderPass = pass.renderPass;
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = VK_NULL_HANDLE;
+            simpleRenderSystem.renderGameObjectsCached(
+                frameInfo,
+                gameObjects,
+                visibleObjects,
+                *commandCache,
+                sceneRevision,
+                inheritanceInfo,
+                pass.renderArea);
+        });
+    } else if (recordParallel) {
+        masterRenderSystem.addSystem("scene", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &pass) {
+            VkCommandBufferInheritanceInfo inheritanceInfo{};
+            inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritanceInfo.pNext = pass.renderingInheritance; // dynamic rendering only
+            inheritanceInfo.renderPass = pass.renderPass;
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = pass.framebuffer;
+            simpleRenderSystem.renderGameObjectsParallel(
+                frameInfo,
+                gameObjects,
+                visibleObjects,
+                *parallelRecorder,
+                inheritanceInfo,
+                pass.renderArea);
+        });
+    } else if (settings.renderQueue) {
+        masterRenderSystem.addSystem("scene", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &) {
+            renderQueue.clear();
+            simpleRenderSystem.submitGameObjects(frameInfo, gameObjects, visibleObjects, renderQueue);
+            renderQueue.flush(
+                frameInfo.commandBuffer,
+                frameInfo.stats,
+                frameInfo.globalSetBound ? frameInfo.globalDescriptorSet : VK_NULL_HANDLE);
+        });
+    } else {
+        masterRenderSystem.addSystem("scene", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &) {
+            simpleRenderSystem.renderGameObjects(frameInfo, gameObjects, visibleObjects);
+        });
+    }
+    if (upscaleRenderSystem) {
+        masterRenderSystem.addSystem("upscale", 0, [&](FrameInfo &frameInfo, const CvkRenderGraph::PassContext &) {
+            upscaleRenderSystem->render(frameInfo, *sceneTarget);
+        });
+    }
+
     CvkCamera camera{};
     camera.setViewTarget(glm::vec3(-1.f, -2.f, 2.f), glm::vec3(0.f, 0.f, 2.5f));
     
@@ -84,23 +255,101 @@ void MainApp::run() {
     // TODO : In case you want to implement a custom cursor, this hides the default and locks it to the window.
     // glfwSetInputMode(cvkWindow.getGLFWWindow(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    glfwSetInputMode(cvkWindow.getGLFWWindow(),GLFW_STICKY_MOUSE_BUTTONS,GLFW_TRUE);
+    const bool headless = cvkWindow.isHeadless();
+    if (!headless) {
+        glfwSetInputMode(cvkWindow.getGLFWWindow(),GLFW_STICKY_MOUSE_BUTTONS,GLFW_TRUE);
+    }
+
+    std::unique_ptr<CvkFrameLimiter> frameLimiter;
+    if (settings.fpsLimit > 0.0) {
+        frameLimiter = std::make_unique<CvkFrameLimiter>(settings.fpsLimit);
+    }
+    bool presentModeKeyDown = false;
+    bool framesInFlightKeyDown = false;
+    uint32_t pipelineReplaceCount = CvkPipeline::getReplaceCount();
+    if (settings.benchmarkFrames > 0 && settings.benchmarkFramesInFlight) {
+        cvkRenderer.setFramesInFlight(1);
+    }
 
+    // On-demand mode only draws when something changed. Held keys move the camera every frame without sending
+    // new events, so after a change we keep polling until a frame goes by where nothing moved.
+    bool animating = true;
     while(!cvkWindow.shouldClose()) {
-        glfwPollEvents();
+        // Right before the input is read, so the time to spare isn't spent between reading it and drawing with it.
+        if (frameLimiter && !(settings.onDemand && !animating)) { frameLimiter->wait(); }
+        if (headless) {
+            // no events and no input, the camera stays where it starts
+        } else if (settings.onDemand && !animating) {
+            glfwWaitEventsTimeout(ON_DEMAND_WAIT_TIMEOUT);
+            // Time spent asleep isn't frame time, otherwise the first key press after idling teleports the camera.
+            currentTime = std::chrono::high_resolution_clock::now();
+        } else {
+            glfwPollEvents();
+        }
         // Calculating time difference so that the game doesn't stutter.
         auto newTime = std::chrono::high_resolution_clock::now();
         float frameTime = std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
         currentTime = newTime;
         frameTime = glm::min(frameTime, MAX_FRAME_TIME);
 
-        cameraController.moveInPlaneXZ(cvkWindow.getGLFWWindow(), frameTime, viewerObject);
+        bool changed = !headless && cameraController.moveInPlaneXZ(cvkWindow.getGLFWWindow(), frameTime, viewerObject);
+        // The swapchain is recreated with the new mode when the next frame begins.
+        const bool presentModeKey = !headless && glfwGetKey(cvkWindow.getGLFWWindow(), GLFW_KEY_P) == GLFW_PRESS;
+        if (presentModeKey && !presentModeKeyDown) {
+            cyclePresentMode();
+            changed = true;
+        }
+        presentModeKeyDown = presentModeKey;
+        const bool framesInFlightKey = !headless && glfwGetKey(cvkWindow.getGLFWWindow(), GLFW_KEY_F) == GLFW_PRESS;
+        if (framesInFlightKey && !framesInFlightKeyDown) {
+            const uint32_t count = cvkRenderer.getFramesInFlight() % CvkSwapchain::MAX_FRAMES_IN_FLIGHT + 1;
+            std::cout << "Frames in flight: " << count << "\n";
+            cvkRenderer.setFramesInFlight(count);
+            changed = true;
+        }
+        framesInFlightKeyDown = framesInFlightKey;
+        // The new pipelines are swapped in whenever the builder is done, nothing changes on screen before that.
+        if (settings.hotReload) { pipelineBuilder.reloadChangedShaders(); }
+        // A reloaded or link time optimized pipeline landed: cached commands still bind the old one, and in
+        // --on-demand nothing else would draw it.
+        const uint32_t replaceCount = CvkPipeline::getReplaceCount();
+        if (replaceCount != pipelineReplaceCount) {
+            pipelineReplaceCount = replaceCount;
+            sceneRevision++;
+            cvkWindow.requestRedraw();
+        }
+        // Same for the specialized variants replacing the generic ones SimpleRenderSystem starts with.
+        if (!indirectRenderSystem && simpleRenderSystem.selectPipelines()) {
+            sceneRevision++;
+            cvkWindow.requestRedraw();
+        }
         camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
         float aspect = cvkRenderer.getAspectRatio();\
         camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 10.f);
 
         // CONTROLLING ROTATION
-        rotationController.rotateObject(cvkWindow.getGLFWWindow(),frameTime,gameObjects[0]);
+        if (!headless && rotationController.rotateObject(cvkWindow.getGLFWWindow(),frameTime,gameObjects[0])) {
+            sceneRevision++;
+            changed = true;
+        }
+
+        // Turns only move the layer rotations in the global set, the transforms change once a turn is over.
+        if (puzzleSize > 0) {
+            if (!layerAnimation.isTurning()) { startNextPuzzleTurn(); }
+            if (layerAnimation.update(frameTime)) { changed = true; }
+            CvkLayerAnimation::FinishedTurn finishedTurn;
+            if (layerAnimation.consumeFinishedTurn(finishedTurn)) {
+                bakePuzzleTurn(finishedTurn);
+                sceneRevision++;
+            }
+        }
+
+        // resizes, uncovered windows and anything else that called requestRedraw()
+        if (cvkWindow.consumeRedrawRequest()) { changed = true; }
+        // a benchmark wants every frame, still scene or not
+        if (settings.benchmarkFrames > 0) { changed = true; }
+        animating = changed;
+        if (settings.onDemand && !changed) { continue; }
 
         if(auto commandBuffer = cvkRenderer.beginFrame()) {
             int frameIndex = cvkRenderer.getFrameIndex();
@@ -109,28 +358,264 @@ void MainApp::run() {
                 frameTime,
                 commandBuffer,
                 camera,
-                globalDescriptorSets[frameIndex]
+                masterRenderSystem.getGlobalDescriptorSet(frameIndex)
             };
 
             // update
-            GlobalUbo ubo{};
-            ubo.projectionView = camera.getProjection() * camera.getView();
-            uboBuffers[frameIndex]->writeToBuffer(&ubo);
-            uboBuffers[frameIndex]->flush(); // manually flushing since not HOST_COHERENT
+            masterRenderSystem.updateGlobals(frameIndex, camera, layerAnimation);
+
+            // Reallocated scene images leave stale views in the graph's framebuffers.
+            if (sceneTarget && sceneTarget->resize(cvkRenderer.getSwapChainExtent())) { renderGraph.clearFramebuffers(); }
+            if (gpuTimer) {
+                double milliseconds;
+                if (gpuTimer->collect(frameIndex, milliseconds)) {
+                    gpuMilliseconds = milliseconds;
+                    // A new render extent makes the viewports in cached command buffers stale.
+                    if (sceneTarget && sceneTarget->updateScale(milliseconds)) { sceneRevision++; }
+                }
+                gpuTimer->begin(commandBuffer, frameIndex);
+            }
+            if (sceneTarget) { renderScale = sceneTarget->getScale(); }
+
+            // compute work (culling) has to be recorded outside of the render pass
+            if (indirectRenderSystem) {
+                indirectRenderSystem->prepareFrame(frameInfo, gameObjects, cvkRenderer.getSwapChainExtent());
+            } else {
+                if (settings.cpuCulling) {
+                    frustumCuller.cull(camera, gameObjects, layerAnimation, visibleObjects);
+                } else {
+                    visibleObjects.clear();
+                    for (uint32_t i = 0; i < gameObjects.size(); i++) {
+                        if (gameObjects[i].model) { visibleObjects.push_back(i); }
+                    }
+                }
+                frameInfo.stats.visibleObjects = static_cast<uint32_t>(visibleObjects.size());
+                frameInfo.stats.culledObjects = static_cast<uint32_t>(gameObjects.size() - visibleObjects.size());
+
+                // Camera movement alone only touches the UBO, but it can change what survives culling.
+                if (commandCache && visibleObjects != cachedVisibleObjects) {
+                    cachedVisibleObjects = visibleObjects;
+                    sceneRevision++;
+                }
+            }
+            if (cvkRenderer.getSwapChainGeneration() != swapChainGeneration) {
+                swapChainGeneration = cvkRenderer.getSwapChainGeneration();
+                sceneRevision++;
+                // The old swapchain image views are gone, and with them the framebuffers built on them.
+                renderGraph.clearFramebuffers();
+            }
 
             // render
-            cvkRenderer.beginSwapChainRenderPass(commandBuffer);
-            simpleRenderSystem.renderGameObjects(frameInfo, gameObjects);
-            cvkRenderer.endSwapChainRenderPass(commandBuffer);
+            // Occlusion culling interrupts the pass after the early draws to build the depth pyramid from them.
+            // It samples the swapchain's own depth image in between, so it keeps the hand-written passes for now.
+            const bool splitPass = indirectRenderSystem && indirectRenderSystem->isOcclusionCulling();
+            if (splitPass) {
+                const CvkRenderGraph::PassContext swapChainPass{
+                    commandBuffer,
+                    cvkRenderer.getSwapChainRenderPass(),
+                    cvkRenderer.getCurrentFramebuffer(),
+                    cvkRenderer.getSwapChainExtent(),
+                    VK_SUBPASS_CONTENTS_INLINE};
+                cvkRenderer.beginSwapChainRenderPass(
+                    commandBuffer,
+                    VK_SUBPASS_CONTENTS_INLINE,
+                    CvkRenderer::SwapChainPass::DepthStore);
+                masterRenderSystem.render(frameInfo, "scene", swapChainPass);
+                cvkRenderer.endSwapChainRenderPass(commandBuffer);
+                indirectRenderSystem->prepareLatePhase(frameInfo, cvkRenderer.getCurrentDepthImageView());
+                cvkRenderer.beginSwapChainRenderPass(
+                    commandBuffer,
+                    VK_SUBPASS_CONTENTS_INLINE,
+                    CvkRenderer::SwapChainPass::Continue);
+                masterRenderSystem.render(frameInfo, "sceneLate", swapChainPass);
+                cvkRenderer.endSwapChainRenderPass(commandBuffer);
+            } else {
+                const VkExtent2D swapChainExtent = cvkRenderer.getSwapChainExtent();
+                const VkExtent2D sceneExtent = sceneTarget ? sceneTarget->getRenderExtent() : swapChainExtent;
+                renderGraph.reset();
+                const auto backbuffer = renderGraph.importImage(
+                    "backbuffer",
+                    cvkRenderer.getCurrentImage(),
+                    cvkRenderer.getCurrentImageView(),
+                    {cvkRenderer.getSwapChainImageFormat(), swapChainExtent},
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    cvkRenderer.getPresentLayout());
+                auto sceneColor = backbuffer;
+                if (sceneTarget) {
+                    // Only the upscale pass reads it, nothing has to survive the frame.
+                    sceneColor = renderGraph.importImage(
+                        "sceneColor",
+                        sceneTarget->getColorImage(frameIndex),
+                        sceneTarget->getColorImageView(frameIndex),
+                        {sceneTarget->getColorFormat(), sceneTarget->getImageExtent()},
+                        VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_UNDEFINED);
+                }
+                const auto sceneDepth = renderGraph.createImage(
+                    "sceneDepth",
+                    {cvkRenderer.getSwapChainDepthFormat(), sceneTarget ? sceneTarget->getImageExtent() : swapChainExtent});
+
+                // Same clear color as the swapchain pass.
+                const VkClearColorValue clearColor{{0.01f, 0.01f, 0.01f, 1.0f}};
+                const VkClearDepthStencilValue clearDepth{1.0f, 0};
+                auto scenePass = renderGraph.addGraphicsPass("scene")
+                    .writeColor(sceneColor, clearColor)
+                    .writeDepth(sceneDepth, clearDepth)
+                    .setRenderArea(sceneExtent);
+                if (replayCached || recordParallel) { scenePass.useSecondaryCommandBuffers(); }
+                // The graph's pass has the swapchain's formats, so it is compatible with every pipeline here.
+                scenePass.setRecord([&](const CvkRenderGraph::PassContext &pass) {
+                    masterRenderSystem.render(frameInfo, "scene", pass);
+                });
+
+                if (sceneTarget) {
+                    // Depth only keeps the pass compatible with the swapchain's, it shares memory with sceneDepth.
+                    const auto upscaleDepth = renderGraph.createImage(
+                        "upscaleDepth",
+                        {cvkRenderer.getSwapChainDepthFormat(), swapChainExtent});
+                    renderGraph.addGraphicsPass("upscale")
+                        .read(sceneColor, CvkRenderGraph::Usage::SampledFragment)
+                        .writeColor(backbuffer)
+                        .writeDepth(upscaleDepth)
+                        .setRecord([&](const CvkRenderGraph::PassContext &pass) {
+                            masterRenderSystem.render(frameInfo, "upscale", pass);
+                        });
+                }
+                renderGraph.compile();
+                renderGraph.execute(commandBuffer, frameIndex);
+            }
+            if (gpuTimer) { gpuTimer->end(commandBuffer, frameIndex); }
             cvkRenderer.endFrame();
+
+            if (settings.printStats) { printFrameStats(frameInfo.stats, frameTime); }
+            if (settings.benchmarkFrames > 0 && recordBenchmarkFrame(frameTime)) {
+                cvkWindow.requestClose();
+            }
+            // Nobody is watching, a headless run without --benchmark draws a single frame (e.g. for --capture).
+            if (headless && settings.benchmarkFrames == 0) { cvkWindow.requestClose(); }
+        } else if (settings.onDemand) {
+            // the swapchain was recreated instead, the change still has to reach the screen
+            cvkWindow.requestRedraw();
+        }
+    }
+    // Everything declared in here is destroyed on return, none of it may still be in use by the GPU.
+    vkDeviceWaitIdle(cvkDevice.device());
+    if (!settings.captureFile.empty()) { writeCapture(settings.captureFile); }
+}
+
+// Binary PPM, any image viewer or diff tool reads it and writing it needs no library.
+void MainApp::writeCapture(const std::string &path) {
+    if (!cvkWindow.isHeadless()) {
+        std::cout << "--capture only works together with --headless\n";
+        return;
+    }
+    std::vector<uint8_t> rgba;
+    cvkRenderer.readLastFrame(rgba);
+    VkExtent2D extent = cvkRenderer.getSwapChainExtent();
+
+    std::ofstream file{path, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error("Failed to open capture file: " + path);
+    }
+    file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        file.write(reinterpret_cast<const char *>(&rgba[i]), 3);
+    }
+    std::cout << "Captured " << extent.width << "x" << extent.height << " frame to " << path << "\n";
+}
+
+// Prints the counters of the latest frame once per second, along with the average frame rate.
+void MainApp::printFrameStats(const FrameStats &stats, float frameTime) {
+    statsTimer += frameTime;
+    statsFrameCount++;
+    if (statsTimer < 1.f) { return; }
+
+    std::cout << statsFrameCount / statsTimer << " fps"
+              << " | visible " << stats.visibleObjects
+              << " | culled " << stats.culledObjects;
+    if (stats.occludedObjects > 0) { std::cout << " (" << stats.occludedObjects << " occluded)"; }
+    std::cout << " | draws " << stats.drawCalls
+              << " | binds " << stats.totalBinds() << " (" << stats.requestedBinds << " requested)"
+              << " | recorded " << stats.recordedCommandBuffers;
+    if (gpuMilliseconds >= 0.0) { std::cout << " | gpu " << gpuMilliseconds << " ms"; }
+    if (renderScale > 0.f) { std::cout << " | scale " << renderScale; }
+    std::cout << "\n";
+    statsTimer = 0.f;
+    statsFrameCount = 0;
+}
+
+void MainApp::cyclePresentMode() {
+    static const VkPresentModeKHR MODES[] = {
+        VK_PRESENT_MODE_FIFO_KHR,
+        VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_IMMEDIATE_KHR};
+    const size_t modeCount = sizeof(MODES) / sizeof(MODES[0]);
+    const std::vector<VkPresentModeKHR> supported = cvkDevice.getSwapChainSupport().presentModes;
+    const size_t current = std::find(MODES, MODES + modeCount, cvkRenderer.getPresentMode()) - MODES;
+    for (size_t step = 1; step < modeCount; step++) {
+        const VkPresentModeKHR next = MODES[(current + step) % modeCount];
+        if (std::find(supported.begin(), supported.end(), next) != supported.end()) {
+            cvkRenderer.setPresentMode(next);
+            return;
         }
     }
 }
 
+// The first frames are skipped, they include pipeline warm-up and have no GPU time yet.
+bool MainApp::recordBenchmarkFrame(float frameTime) {
+    static constexpr uint32_t WARMUP_FRAMES = CvkSwapchain::MAX_FRAMES_IN_FLIGHT + 8;
+    benchmarkFrameCount++;
+    if (benchmarkFrameCount <= WARMUP_FRAMES) { return false; }
+
+    benchmarkCpuTime += frameTime;
+    benchmarkFenceWaitTime += cvkRenderer.getLastFenceWaitMilliseconds();
+    if (gpuMilliseconds >= 0.0) {
+        benchmarkGpuTime += gpuMilliseconds;
+        benchmarkGpuSamples++;
+    }
+    const uint32_t measuredFrames = benchmarkFrameCount - WARMUP_FRAMES;
+    if (measuredFrames < settings.benchmarkFrames) { return false; }
+
+    const uint32_t framesInFlight = cvkRenderer.getFramesInFlight();
+    const double frameMilliseconds = 1000.0 * benchmarkCpuTime / measuredFrames;
+    const double waitMilliseconds = benchmarkFenceWaitTime / measuredFrames;
+    std::cout << "Benchmark: " << measuredFrames << " frames, " << gameObjects.size() << " objects"
+              << (settings.depthPrepass ? ", depth pre-pass" : "")
+              << ", " << framesInFlight << " frames in flight\n"
+              << "  frame " << frameMilliseconds << " ms"
+              << " | waiting for gpu " << waitMilliseconds << " ms";
+    if (benchmarkGpuSamples > 0) {
+        const double gpuAverage = benchmarkGpuTime / benchmarkGpuSamples;
+        std::cout << " | gpu " << gpuAverage << " ms";
+        // The CPU's own work plus the GPU's, minus the frame both fit into, is the time they ran side by side.
+        // As a share of the shorter of the two: 0% means strictly one after the other, 100% fully hidden.
+        const double cpuBusy = frameMilliseconds - waitMilliseconds;
+        const double shorter = std::min(cpuBusy, gpuAverage);
+        if (shorter > 0.0) {
+            const double overlap = std::max(0.0, cpuBusy + gpuAverage - frameMilliseconds) / shorter;
+            std::cout << " | cpu/gpu overlap " << 100.0 * std::min(overlap, 1.0) << "%";
+        }
+    }
+    std::cout << "\n";
+
+    if (!settings.benchmarkFramesInFlight || framesInFlight == CvkSwapchain::MAX_FRAMES_IN_FLIGHT) { return true; }
+    // Next count, with a warm-up of its own since the first frames after the switch wait for nothing.
+    cvkRenderer.setFramesInFlight(framesInFlight + 1);
+    benchmarkFrameCount = 0;
+    benchmarkCpuTime = 0.0;
+    benchmarkGpuTime = 0.0;
+    benchmarkGpuSamples = 0;
+    benchmarkFenceWaitTime = 0.0;
+    return false;
+}
+
 void MainApp::loadGameObjects() {
     // ! Creation of game objects
     // std::shared_ptr<CvkModel> cvkModel = createCubeModel(cvkDevice, {.0f, .0f, .0f});
-    std::shared_ptr<CvkModel> cvkModel = CvkModel::createModelFromFile(cvkDevice, "models/smallCube.obj");
+    // Only SimpleRenderSystem's depth pre-pass draws from the position stream.
+    const bool positionStream = settings.depthPrepass && !settings.indirectDraw;
+    std::shared_ptr<CvkModel> cvkModel = CvkModel::createModelFromFile(cvkDevice, "models/smallCube.obj", positionStream);
     auto testCube = CvkGameObject::createGameObject();
     testCube.model = cvkModel;
     testCube.transform.translation = {-.5f, .5f, 2.5f};
@@ -145,6 +630,133 @@ void MainApp::loadGameObjects() {
     testCube2.transform.scale = glm::vec3(.2f); // uniform scaling
     // testCube2.transform.scale = {3.f, 1.5f, 3.f}; // non-uniform scaling
     gameObjects.push_back(std::move(testCube2));
+
+    if (settings.stressObjectCount > 0) {
+        loadStressObjects(cvkModel, settings.stressObjectCount);
+    }
+    if (settings.overlapLayers > 0) {
+        loadOverlapObjects(cvkModel, settings.overlapLayers);
+    }
+    if (settings.puzzleSize > 0) {
+        loadPuzzleObjects(cvkModel, settings.puzzleSize);
+    }
+}
+
+// Fills a cube shaped grid in front of the camera with small copies of the model.
+void MainApp::loadStressObjects(std::shared_ptr<CvkModel> model, uint32_t count) {
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<float>(count))));
+    const float spacing = 4.f / static_cast<float>(side);
+    const glm::vec3 origin{-2.f, -2.f, 3.f};
+    gameObjects.reserve(gameObjects.size() + count);
+    for (uint32_t i = 0; i < count; i++) {
+        auto cube = CvkGameObject::createGameObject();
+        cube.model = model;
+        cube.transform.translation = origin + spacing * glm::vec3{
+            static_cast<float>(i % side),
+            static_cast<float>((i / side) % side),
+            static_cast<float>(i / (side * side))};
+        cube.transform.scale = glm::vec3(spacing * .4f);
+        gameObjects.push_back(std::move(cube));
+    }
+}
+
+// Slabs of touching cubes straight in front of the starting camera, so the middle of the screen gets covered
+// once per layer. Added back to front, which is the worst case for early depth testing without a pre-pass
+// (run with --no-queue, the render queue would sort them front to back).
+void MainApp::loadOverlapObjects(std::shared_ptr<CvkModel> model, uint32_t layers) {
+    static constexpr uint32_t SIDE = 8;
+    const float spacing = .25f;
+    const float layerSpacing = glm::min(.3f, 8.f / static_cast<float>(layers));
+    gameObjects.reserve(gameObjects.size() + layers * SIDE * SIDE);
+    for (uint32_t layer = layers; layer-- > 0;) {
+        for (uint32_t i = 0; i < SIDE * SIDE; i++) {
+            auto cube = CvkGameObject::createGameObject();
+            cube.model = model;
+            cube.transform.translation = {
+                (static_cast<float>(i % SIDE) - (SIDE - 1) * .5f) * spacing,
+                (static_cast<float>(i / SIDE) - (SIDE - 1) * .5f) * spacing,
+                1.5f + layerSpacing * static_cast<float>(layer)};
+            cube.transform.scale = glm::vec3(spacing * .5f);
+            gameObjects.push_back(std::move(cube));
+        }
+    }
+}
+
+// An N x N x N block of cubies above the two test cubes. Every axis has N layers, layer (axis * N + slice),
+// so with 32 layer bits N can't go past 10.
+void MainApp::loadPuzzleObjects(std::shared_ptr<CvkModel> model, uint32_t size) {
+    const uint32_t maxSize = CvkLayerAnimation::MAX_LAYERS / 3;
+    if (size > maxSize) {
+        std::cout << "--puzzle " << size << " has more layers than CvkLayerAnimation supports, using " << maxSize << "\n";
+        size = maxSize;
+    }
+    puzzleSize = size;
+    puzzleCenter = {0.f, -.5f, 2.5f};
+    cubieSpacing = .9f / static_cast<float>(size);
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        glm::vec3 direction{0.f};
+        direction[axis] = 1.f;
+        for (uint32_t slice = 0; slice < size; slice++) {
+            layerAnimation.addLayer(puzzleCenter, direction);
+        }
+    }
+
+    firstCubie = gameObjects.size();
+    gameObjects.reserve(gameObjects.size() + size * size * size);
+    for (uint32_t i = 0; i < size * size * size; i++) {
+        const glm::vec3 cell{
+            static_cast<float>(i % size),
+            static_cast<float>((i / size) % size),
+            static_cast<float>(i / (size * size))};
+        auto cubie = CvkGameObject::createGameObject();
+        cubie.model = model;
+        cubie.transform.translation = puzzleCenter + (cell - .5f * static_cast<float>(size - 1)) * cubieSpacing;
+        cubie.transform.scale = glm::vec3(cubieSpacing * .45f);
+        // colored by where it started, so the turns scramble something visible
+        cubie.color = glm::vec3(.2f) + .8f * cell / glm::max(1.f, static_cast<float>(size - 1));
+        cubie.layerMask = puzzleLayerMask(cell);
+        gameObjects.push_back(std::move(cubie));
+    }
+}
+
+glm::vec3 MainApp::puzzleCell(const glm::vec3 &translation) const {
+    // rounded, so the float error of the baked turns never adds up
+    return glm::round((translation - puzzleCenter) / cubieSpacing + .5f * static_cast<float>(puzzleSize - 1));
+}
+
+uint32_t MainApp::puzzleLayerMask(const glm::vec3 &cell) const {
+    uint32_t mask = 0;
+    for (uint32_t axis = 0; axis < 3; axis++) {
+        mask |= 1u << (axis * puzzleSize + static_cast<uint32_t>(cell[axis]));
+    }
+    return mask;
+}
+
+// Same sequence on every run, benchmarks and captures have to be comparable.
+void MainApp::startNextPuzzleTurn() {
+    static constexpr float TURN_DURATION = .4f;
+    const uint32_t layerCount = layerAnimation.getLayerCount();
+    const uint32_t layer = (puzzleTurnCount * 7 + 3) % layerCount;
+    const float direction = (puzzleTurnCount / layerCount) % 2 == 0 ? 1.f : -1.f;
+    layerAnimation.startTurn(layer, direction * glm::half_pi<float>(), TURN_DURATION);
+    puzzleTurnCount++;
+}
+
+void MainApp::bakePuzzleTurn(const CvkLayerAnimation::FinishedTurn &turn) {
+    const glm::mat4 rotation = glm::mat4_cast(turn.rotation);
+    const uint32_t layerBit = 1u << turn.layer;
+    for (size_t i = firstCubie; i < firstCubie + puzzleSize * puzzleSize * puzzleSize; i++) {
+        auto &cubie = gameObjects[i];
+        if ((cubie.layerMask & layerBit) == 0) { continue; }
+        auto &transform = cubie.transform;
+        const glm::vec3 cell = puzzleCell(turn.pivot + turn.rotation * (transform.translation - turn.pivot));
+        transform.translation = puzzleCenter + (cell - .5f * static_cast<float>(puzzleSize - 1)) * cubieSpacing;
+        // TransformComponent::mat4() rotates Y, X, Z, so the turned orientation goes back into the same order.
+        const glm::mat4 orientation =
+            rotation * glm::eulerAngleYXZ(transform.rotation.y, transform.rotation.x, transform.rotation.z);
+        glm::extractEulerAngleYXZ(orientation, transform.rotation.y, transform.rotation.x, transform.rotation.z);
+        cubie.layerMask = puzzleLayerMask(cell);
+    }
 }
 
 } // namespace cvk
\ No newline at end of file
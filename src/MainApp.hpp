@@ -5,19 +5,56 @@
 #include "CvkWindow.hpp"
 #include "CvkRenderer.hpp"
 #include "CvkDescriptors.hpp"
+#include "CvkFrameInfo.hpp"
+#include "CvkLayerAnimation.hpp"
 
 // std
 #include <memory>
+#include <string>
 
 namespace cvk {
 
+// Runtime options, filled from the command line in main.cpp.
+struct AppSettings {
+    bool indirectDraw = false;       // --indirect : draw the whole scene with IndirectRenderSystem
+    bool gpuCulling = false;         // --gpu-cull : frustum cull in a compute pass (implies --indirect)
+    bool occlusionCulling = false;   // --hiz      : two-phase Hi-Z occlusion culling on top of --gpu-cull
+    bool cpuCulling = true;          // --no-cull  : turns off CvkFrustumCuller for SimpleRenderSystem
+    bool renderQueue = true;         // --no-queue : record draws in scene order instead of through CvkRenderQueue
+    bool parallelRecording = false;  // --parallel : record SimpleRenderSystem draws on worker threads (secondary command buffers)
+    uint32_t workerThreads = 0;      // --threads N : worker count for --parallel, 0 uses every hardware thread
+    bool cacheCommands = false;      // --cache    : replay pre-recorded draws until the scene changes
+    bool onDemand = false;           // --on-demand : sleep in glfwWaitEventsTimeout and only draw frames when something changed
+    bool depthPrepass = false;       // --depth-prepass : SimpleRenderSystem lays down depth first, then shades with an EQUAL test
+    bool dynamicResolution = false;  // --dynamic-res : render the scene into a CvkSceneTarget scaled to hold gpuTargetMilliseconds
+    float minRenderScale = .5f;      // --res-scale MIN MAX : bounds of the dynamic resolution scale (per axis)
+    float maxRenderScale = 1.f;
+    double gpuTargetMilliseconds = 1000.0 / 60.0; // --gpu-target MS : GPU frame time dynamic resolution aims for
+    bool printStats = false;         // --stats    : print FrameStats once per second
+    uint32_t benchmarkFrames = 0;    // --benchmark N : render N frames, print average CPU and GPU frame times and quit
+    bool benchmarkFramesInFlight = false; // --benchmark-fif : with --benchmark, measure N frames at every frames in flight count from 1 up
+    uint32_t stressObjectCount = 0;  // --stress N : add N extra cubes to the scene for performance testing
+    uint32_t overlapLayers = 0;      // --overlap N : add N overlapping slabs of cubes in front of the camera (overdraw test)
+    uint32_t puzzleSize = 0;         // --puzzle N : add an N x N x N puzzle of cubies that keeps turning its layers (N <= 10)
+    bool headless = false;           // --headless : no window, render into offscreen images (one frame unless --benchmark)
+    std::string captureFile;         // --capture FILE : write the last headless frame to FILE as a binary PPM
+    bool bindless = false;           // --bindless : materials and textures through descriptor indexing, picked per object by index
+    bool dynamicRendering = false;   // --dynamic-rendering : VK_KHR_dynamic_rendering instead of render passes and framebuffers
+    bool pipelineLibrary = false;    // --pipeline-library : link pipeline variants from VK_EXT_graphics_pipeline_library parts
+    uint32_t pipelineThreads = 0;    // --pipeline-threads N : threads compiling the pipelines at startup, 0 uses every hardware thread but one
+    bool hotReload = false;          // --hot-reload : rebuild the pipelines of edited shaders in the background and swap them in
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR; // --present-mode MODE : fifo, fifo-relaxed, mailbox or immediate, P cycles them while running
+    double fpsLimit = 0.0;           // --fps-limit N : sleep before sampling input so frames start N times a second, 0 (the default) is unlimited
+    uint32_t framesInFlight = CvkSwapchain::DEFAULT_FRAMES_IN_FLIGHT; // --frames-in-flight N : 1 (latency) to 4 (throughput), F cycles it while running
+};
+
 // Resource allocation is initialization, so any variable declaration will call the respective constructor.
 class MainApp {
 public:
     static constexpr int WIDTH = 800;
     static constexpr int HEIGHT = 600;
 
-    MainApp();
+    MainApp(const AppSettings &settings = AppSettings{});
     ~MainApp();
 
     // Remove copy constructors if you will only have object in this class (e.g. App class, Window class etc.)
@@ -27,14 +64,47 @@ public:
     void run();
 private:
     void loadGameObjects();
+    void loadStressObjects(std::shared_ptr<CvkModel> model, uint32_t count);
+    void loadOverlapObjects(std::shared_ptr<CvkModel> model, uint32_t layers);
+    void loadPuzzleObjects(std::shared_ptr<CvkModel> model, uint32_t size);
+    // Grid cell (0..puzzleSize-1 per axis) of a cubie position, and the layers that cell belongs to.
+    glm::vec3 puzzleCell(const glm::vec3 &translation) const;
+    uint32_t puzzleLayerMask(const glm::vec3 &cell) const;
+    void startNextPuzzleTurn();
+    // Moves the turned layer's cubies to where the shaders animated them to, once per turn.
+    void bakePuzzleTurn(const CvkLayerAnimation::FinishedTurn &turn);
+    void printFrameStats(const FrameStats &stats, float frameTime);
+    // Switches to the next present mode the surface supports.
+    void cyclePresentMode();
+    // Returns true once settings.benchmarkFrames frames were measured (and the results printed), with
+    // --benchmark-fif once that was done for every frames in flight count.
+    bool recordBenchmarkFrame(float frameTime);
+    void writeCapture(const std::string &path);
 
-    CvkWindow cvkWindow{WIDTH, HEIGHT, "My Puzzle Game"};
+    AppSettings settings;
+    CvkWindow cvkWindow{WIDTH, HEIGHT, "My Puzzle Game", settings.headless};
     CvkDevice cvkDevice{cvkWindow};
-    CvkRenderer cvkRenderer{cvkWindow,cvkDevice};
+    CvkRenderer cvkRenderer{cvkWindow, cvkDevice, settings.dynamicRendering, settings.presentMode, settings.framesInFlight};
 
-    // ! Order of declaration matters here
-    std::unique_ptr<CvkDescriptorPool> globalPool{}; // has to be created AFTER Device
     std::vector<CvkGameObject> gameObjects;
+
+    CvkLayerAnimation layerAnimation{};
+    uint32_t puzzleSize = 0;
+    size_t firstCubie = 0; // the cubies are gameObjects[firstCubie, firstCubie + puzzleSize^3)
+    glm::vec3 puzzleCenter{0.f};
+    float cubieSpacing = 0.f;
+    uint32_t puzzleTurnCount = 0;
+
+    float statsTimer = 0.f;
+    uint32_t statsFrameCount = 0;
+    double gpuMilliseconds = -1.0; // latest CvkGpuTimer result, negative while there is none
+    float renderScale = -1.f;      // current CvkSceneTarget scale, negative without dynamic resolution
+
+    uint32_t benchmarkFrameCount = 0;
+    double benchmarkCpuTime = 0.0;
+    double benchmarkGpuTime = 0.0;
+    uint32_t benchmarkGpuSamples = 0;
+    double benchmarkFenceWaitTime = 0.0; // milliseconds the CPU spent waiting for the GPU
 };
 
 } // namespace cvk
\ No newline at end of file
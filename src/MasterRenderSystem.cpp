@@ -0,0 +1,225 @@
+#include "MasterRenderSystem.hpp"
+#include "CvkSwapchain.hpp"
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+struct GlobalUbo {
+    alignas(16) glm::mat4 projectionView{1.f};
+    alignas(16) glm::vec3 lightDirection = glm::normalize(glm::vec3{-1.f, 3.f, 1.f});
+    // now a lot more things can be passed to the shaders
+};
+
+MasterRenderSystem::MasterRenderSystem(
+CvkDevice &device,
+bool bindless)
+: cvkDevice{device}, bindless{bindless && device.supportsBindless()} {
+    createGlobalDescriptors();
+    globalPipelineLayout = createPipelineLayout({});
+    if (this->bindless) { createMaterialBuffer(); }
+}
+MasterRenderSystem::~MasterRenderSystem() {
+    vkDestroyPipelineLayout(cvkDevice.device(), globalPipelineLayout, nullptr);
+}
+
+void MasterRenderSystem::createGlobalDescriptors() {
+    CvkDescriptorPool::Builder poolBuilder{cvkDevice};
+    poolBuilder
+        .setMaxSets(CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+        .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    CvkDescriptorSetLayout::Builder layoutBuilder{cvkDevice};
+    layoutBuilder
+        .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+        .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
+
+    if (bindless) {
+        // The update-after-bind limits are separate from (and usually far above) the regular ones.
+        const auto &limits = cvkDevice.descriptorIndexingProperties();
+        maxTextures = std::min({
+            MAX_BINDLESS_TEXTURES,
+            limits.maxDescriptorSetUpdateAfterBindSampledImages,
+            limits.maxDescriptorSetUpdateAfterBindSamplers,
+            limits.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            limits.maxPerStageDescriptorUpdateAfterBindSamplers});
+        // One less per stage, CvkObjectBuffer's storage buffer at set 1 counts against it as well.
+        maxStorageBuffers = std::min({
+            MAX_BINDLESS_STORAGE_BUFFERS,
+            limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers - 1});
+        const VkDescriptorBindingFlagsEXT bindlessFlags =
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+            VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+        poolBuilder
+            .setPoolFlags(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, maxTextures * CvkSwapchain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxStorageBuffers * CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+        layoutBuilder
+            .addBinding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, maxTextures, bindlessFlags)
+            .addBinding(
+                3,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                maxStorageBuffers,
+                bindlessFlags);
+    }
+    globalPool = poolBuilder.build();
+    globalSetLayout = layoutBuilder.build();
+
+    uboBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    layerBuffers.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    globalDescriptorSets.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    for (int i = 0; i < uboBuffers.size(); i++) {
+        uboBuffers[i] = std::make_unique<CvkBuffer>(
+            cvkDevice,
+            sizeof(GlobalUbo),
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            // We do not use HOST_COHERENT bit here, because we only want to flush the buffer so that we don't
+            // interfere with the previous frame that might still be rendering.
+            // ! this is no longer the case now, but we are demoing the flush function anyways
+        );
+        uboBuffers[i]->map();
+        layerBuffers[i] = std::make_unique<CvkBuffer>(
+            cvkDevice,
+            sizeof(CvkLayerAnimation::LayerUbo),
+            1,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        layerBuffers[i]->map();
+
+        auto bufferInfo = uboBuffers[i]->descriptorInfo();
+        auto layerInfo = layerBuffers[i]->descriptorInfo();
+        CvkDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(0, &bufferInfo)
+            .writeBuffer(1, &layerInfo)
+            .build(globalDescriptorSets[i]);
+    }
+}
+
+void MasterRenderSystem::createMaterialBuffer() {
+    // Host visible, materials are appended to it directly without any staging.
+    materialBuffer = std::make_unique<CvkBuffer>(
+        cvkDevice,
+        sizeof(MaterialData),
+        MAX_MATERIALS,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    materialBuffer->map();
+    auto bufferInfo = materialBuffer->descriptorInfo();
+    addStorageBuffer(bufferInfo);
+    addMaterial(MaterialData{});
+}
+
+uint32_t MasterRenderSystem::addTexture(const VkDescriptorImageInfo &imageInfo) {
+    assert(bindless && "Textures are only indexed in bindless mode!");
+    if (textureCount >= maxTextures) {
+        throw std::runtime_error("Too many bindless textures!");
+    }
+    auto info = imageInfo;
+    for (auto &set : globalDescriptorSets) {
+        CvkDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeImage(2, &info, textureCount)
+            .overwrite(set);
+    }
+    return textureCount++;
+}
+
+uint32_t MasterRenderSystem::addStorageBuffer(const VkDescriptorBufferInfo &bufferInfo) {
+    assert(bindless && "Storage buffers are only indexed in bindless mode!");
+    if (storageBufferCount >= maxStorageBuffers) {
+        throw std::runtime_error("Too many bindless storage buffers!");
+    }
+    auto info = bufferInfo;
+    for (auto &set : globalDescriptorSets) {
+        CvkDescriptorWriter(*globalSetLayout, *globalPool)
+            .writeBuffer(3, &info, storageBufferCount)
+            .overwrite(set);
+    }
+    return storageBufferCount++;
+}
+
+uint32_t MasterRenderSystem::addMaterial(const MaterialData &material) {
+    assert(bindless && "Materials are only used in bindless mode!");
+    if (materialCount >= MAX_MATERIALS) {
+        throw std::runtime_error("Too many materials!");
+    }
+    auto data = material;
+    materialBuffer->writeToIndex(&data, materialCount);
+    return materialCount++;
+}
+
+VkPipelineLayout MasterRenderSystem::createPipelineLayout(const std::vector<VkDescriptorSetLayout> &systemSetLayouts) const {
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout->getDescriptorSetLayout()};
+    descriptorSetLayouts.insert(descriptorSetLayouts.end(), systemSetLayouts.begin(), systemSetLayouts.end());
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = PUSH_CONSTANT_STAGES;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(cvkDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create Pipeline Layout!");
+    }
+    return pipelineLayout;
+}
+
+void MasterRenderSystem::addSystem(const std::string &pass, int order, RenderFunction render) {
+    auto position = std::upper_bound(systems.begin(), systems.end(), order, [](int order, const System &system) {
+        return order < system.order;
+    });
+    systems.insert(position, System{pass, order, std::move(render)});
+}
+
+void MasterRenderSystem::updateGlobals(int frameIndex, const CvkCamera &camera, const CvkLayerAnimation &layerAnimation) {
+    GlobalUbo ubo{};
+    ubo.projectionView = camera.getProjection() * camera.getView();
+    uboBuffers[frameIndex]->writeToBuffer(&ubo);
+    uboBuffers[frameIndex]->flush(); // manually flushing since not HOST_COHERENT
+
+    // All a layer turn costs per frame, the object buffers stay as they are.
+    CvkLayerAnimation::LayerUbo layers = layerAnimation.getUbo();
+    layerBuffers[frameIndex]->writeToBuffer(&layers);
+}
+
+void MasterRenderSystem::render(FrameInfo &frameInfo, const std::string &pass, const CvkRenderGraph::PassContext &context) {
+    // A pass that only takes vkCmdExecuteCommands can't bind anything, the secondary buffers bind set 0 themselves.
+    if (context.contents == VK_SUBPASS_CONTENTS_INLINE) {
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            globalPipelineLayout,
+            0,
+            1,
+            &frameInfo.globalDescriptorSet,
+            0,
+            nullptr);
+        frameInfo.globalSetBound = true;
+        frameInfo.stats.descriptorSetBinds++;
+        frameInfo.stats.requestedBinds++;
+    }
+    for (auto &system : systems) {
+        if (system.pass == pass) { system.render(frameInfo, context); }
+    }
+    frameInfo.globalSetBound = false;
+}
+
+} // namespace cvk
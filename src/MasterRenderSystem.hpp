@@ -0,0 +1,118 @@
+#pragma once
+
+#include "CvkBuffer.hpp"
+#include "CvkCamera.hpp"
+#include "CvkDescriptors.hpp"
+#include "CvkDevice.hpp"
+#include "CvkFrameInfo.hpp"
+#include "CvkLayerAnimation.hpp"
+#include "CvkRenderGraph.hpp"
+
+// std
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cvk {
+
+/*
+Owns everything the render systems share: the global UBO and the layer rotations (CvkLayerAnimation) of every
+frame in flight, their descriptor set (set 0)
+and the shape of the graphics pipeline layouts. The render systems register what they draw in which render
+graph pass, render() then runs them in order.
+
+Every graphics pipeline layout is created through createPipelineLayout(), so they all start with the global set
+layout and carry the same push constant range. That makes them compatible for set 0: it is bound once per pass
+and stays bound across the pipeline switches between systems, each system only binds its own sets from 1 on.
+
+In bindless mode (VK_EXT_descriptor_indexing) set 0 also holds an array of every texture (binding 2) and of every
+storage buffer (binding 3). Both are partially bound and update-after-bind, so new entries can be written while
+the sets are in use and only the ones added so far have to be valid. Storage buffer 0 is the material buffer,
+objects pick their material with ObjectData::materialIndex. A material change is then just a different index,
+draws with different materials share all their bindings.
+*/
+class MasterRenderSystem {
+public:
+    // Shared by every layout, vkCmdPushConstants has to name all of these stages.
+    static constexpr VkShaderStageFlags PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    // The minimum every device guarantees.
+    static constexpr uint32_t PUSH_CONSTANT_SIZE = 128;
+
+    // Element of the material buffer (std430), must match MaterialData in shaders/bindless_shader.frag.
+    struct MaterialData {
+        glm::vec4 baseColor{1.f};
+        uint32_t textureIndex = NO_TEXTURE;
+        uint32_t padding[3]{};
+    };
+    static constexpr uint32_t NO_TEXTURE = ~0u;
+    static constexpr uint32_t MAX_MATERIALS = 1024;
+    // Upper bounds of the bindless arrays, lowered to what the device allows.
+    static constexpr uint32_t MAX_BINDLESS_TEXTURES = 1024;
+    static constexpr uint32_t MAX_BINDLESS_STORAGE_BUFFERS = 256;
+
+    using RenderFunction = std::function<void(FrameInfo &frameInfo, const CvkRenderGraph::PassContext &pass)>;
+
+    // bindless is ignored when the device doesn't support it, check isBindless().
+    MasterRenderSystem(CvkDevice &device, bool bindless = false);
+    ~MasterRenderSystem();
+
+    MasterRenderSystem(const MasterRenderSystem &) = delete;
+    MasterRenderSystem &operator=(const MasterRenderSystem &) = delete;
+
+    // Set 0 is the global set, systemSetLayouts follow from set 1 on. The caller destroys the layout.
+    VkPipelineLayout createPipelineLayout(const std::vector<VkDescriptorSetLayout> &systemSetLayouts) const;
+
+    // Systems of a pass run in ascending order, equal orders in registration order.
+    void addSystem(const std::string &pass, int order, RenderFunction render);
+
+    // Uploads the global data of a frame, once per frame before anything of it is recorded.
+    void updateGlobals(int frameIndex, const CvkCamera &camera, const CvkLayerAnimation &layerAnimation);
+    // Binds set 0 (unless the pass only takes secondary command buffers) and runs the systems of the pass.
+    void render(FrameInfo &frameInfo, const std::string &pass, const CvkRenderGraph::PassContext &context);
+
+    bool isBindless() const { return bindless; }
+    // The following only work in bindless mode. They write the descriptor into every frame's set right away,
+    // which update-after-bind allows even while those sets are bound by a frame in flight. Entries are never
+    // removed, what is referenced has to stay alive as long as this does. Each returns the new index.
+    uint32_t addTexture(const VkDescriptorImageInfo &imageInfo);
+    uint32_t addStorageBuffer(const VkDescriptorBufferInfo &bufferInfo);
+    // Materials are only appended, so no frame in flight can be reading the slot that is written.
+    // Material 0 (white, untextured) always exists.
+    uint32_t addMaterial(const MaterialData &material);
+
+    VkDescriptorSetLayout getGlobalSetLayout() const { return globalSetLayout->getDescriptorSetLayout(); }
+    VkDescriptorSet getGlobalDescriptorSet(int frameIndex) const { return globalDescriptorSets[frameIndex]; }
+    // The CvkLayerAnimation::LayerUbo of a frame, for compute work that has to know where turning objects are.
+    VkDescriptorBufferInfo getLayerBufferInfo(int frameIndex) const { return layerBuffers[frameIndex]->descriptorInfo(); }
+private:
+    struct System {
+        std::string pass;
+        int order;
+        RenderFunction render;
+    };
+
+    void createGlobalDescriptors();
+    void createMaterialBuffer();
+
+    CvkDevice &cvkDevice;
+    bool bindless;
+    uint32_t maxTextures = 0;
+    uint32_t maxStorageBuffers = 0;
+    uint32_t textureCount = 0;
+    uint32_t storageBufferCount = 0;
+    uint32_t materialCount = 0;
+    std::unique_ptr<CvkBuffer> materialBuffer;
+
+    std::unique_ptr<CvkDescriptorPool> globalPool;
+    std::unique_ptr<CvkDescriptorSetLayout> globalSetLayout;
+    std::vector<std::unique_ptr<CvkBuffer>> uboBuffers;
+    std::vector<std::unique_ptr<CvkBuffer>> layerBuffers;
+    std::vector<VkDescriptorSet> globalDescriptorSets;
+    // Only the global set, used to bind set 0 before any system bound a pipeline.
+    VkPipelineLayout globalPipelineLayout = VK_NULL_HANDLE;
+
+    std::vector<System> systems; // kept sorted by order
+};
+
+} // namespace cvk
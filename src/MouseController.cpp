@@ -3,7 +3,7 @@
 #include <cmath>
 
 namespace cvk {
-    void MouseController::rotateObject(GLFWwindow* window, float dt, CvkGameObject& gameObject) {
+    bool MouseController::rotateObject(GLFWwindow* window, float dt, CvkGameObject& gameObject) {
         /*
         Logic
         This function will be called on every frame.
@@ -23,6 +23,7 @@ namespace cvk {
             Check if old Mp > 0, then proceed as if mouse is moving.
             2. If old Mp = 0, check for mouse press action. If mouse pressed, keep calculating old mouse pos and new one. 
         */
+        const glm::vec3 rotationBefore = gameObject.transform.rotation;
         double newMouseX;
         double newMouseY;
         bool rightSide;
@@ -95,6 +96,7 @@ namespace cvk {
             //std::cout<<"RELEASE ROTATION\n";
         }
         oldMousePosition = newMousePosition;
+        return gameObject.transform.rotation != rotationBefore;
         /*
 
 
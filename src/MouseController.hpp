@@ -6,7 +6,8 @@
 namespace cvk {
     class MouseController {
     public:
-        void rotateObject(GLFWwindow* window, float dt, CvkGameObject& gameObject);
+        // Returns true when the object's rotation changed this frame.
+        bool rotateObject(GLFWwindow* window, float dt, CvkGameObject& gameObject);
     private:
         glm::vec2 oldMousePosition{0};
         //glm::vec2 newMp{0};
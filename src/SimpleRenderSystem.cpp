@@ -1,4 +1,5 @@
 #include "SimpleRenderSystem.hpp"
+#include "CvkSwapchain.hpp"
 
 // libraries
 #define GLM_FORCE_RADIANS
@@ -11,86 +12,315 @@
 
 namespace cvk {
 
-struct SimplePushConstantData {
-    glm::mat4 modelMatrix{1.f};
-    glm::mat4 normalMatrix{1.f};
+// constant_id of the specialization constants in simple_shader.vert and depth_prepass.vert
+enum SpecializationId : uint32_t {
+    SPEC_ANIMATE_LAYERS = 0,
 };
 
 SimpleRenderSystem::SimpleRenderSystem(
 CvkDevice &device,
-VkRenderPass renderPass,
-VkDescriptorSetLayout globalSetLayout)
-: cvkDevice{device} {
-    createPipelineLayout(globalSetLayout);
-    createPipeline(renderPass);
+const PipelineRenderTarget &renderTarget,
+const MasterRenderSystem &masterRenderSystem,
+bool depthPrepass,
+bool animateLayers,
+CvkPipelineBuilder *pipelineBuilder)
+: cvkDevice{device},
+  objectBuffer{device},
+  depthPrepass{depthPrepass},
+  bindless{masterRenderSystem.isBindless()} {
+    createPipelineLayout(masterRenderSystem);
+    createPipeline(renderTarget, animateLayers, pipelineBuilder);
 }
 SimpleRenderSystem::~SimpleRenderSystem() {
     vkDestroyPipelineLayout(cvkDevice.device(),pipelineLayout, nullptr);
 }
 
-void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
+void SimpleRenderSystem::createPipelineLayout(const MasterRenderSystem &masterRenderSystem) {
+    // Per object data comes from the object buffer at set 1, the push constants are unused.
+    pipelineLayout = masterRenderSystem.createPipelineLayout({objectBuffer.getDescriptorSetLayout()});
+}
+void SimpleRenderSystem::createPipeline(
+const PipelineRenderTarget &renderTarget,
+bool animateLayers,
+CvkPipelineBuilder *pipelineBuilder) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before Pipeline Layout!");
+
+    // The render target is copied into the callbacks, variants may still be built after the constructor returned.
+    genericConstants.setBool(SPEC_ANIMATE_LAYERS, true);
+    specializedConstants.setBool(SPEC_ANIMATE_LAYERS, animateLayers);
 
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(SimplePushConstantData);
+    if (depthPrepass) {
+        depthPrepassVariants = std::make_unique<CvkPipelineVariants>(
+            cvkDevice,
+            "shaders/depth_prepass.vert",
+            "",
+            [renderTarget, layout = pipelineLayout](PipelineConfigInfo &depthConfig) {
+                CvkPipeline::depthOnlyPipelineConfigInfo(depthConfig);
+                renderTarget.apply(depthConfig);
+                depthConfig.pipelineLayout = layout;
+            },
+            pipelineBuilder);
+    }
 
-    // This will be expanded when we have more local descriptor sets
-    std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout}; 
+    // The bindless shader looks up the object's material in set 0, so one pipeline covers every material.
+    pipelineVariants = std::make_unique<CvkPipelineVariants>(
+        cvkDevice,
+        "shaders/simple_shader.vert",
+        bindless ? "shaders/bindless_shader.frag" : "shaders/simple_shader.frag",
+        [renderTarget, layout = pipelineLayout, depthPrepass = depthPrepass](PipelineConfigInfo &pipelineConfig) {
+            CvkPipeline::defaultPipelineConfigInfo(pipelineConfig);
+            if (depthPrepass) {
+                // Depth is final after the pre-pass, only the front most surface passes and nothing needs writing.
+                pipelineConfig.depthStencilInfo.depthWriteEnable = VK_FALSE;
+                pipelineConfig.depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+            }
+            // A render pass (or with dynamic rendering just the formats) describes the attachments the pipeline draws into
+            renderTarget.apply(pipelineConfig);
+            pipelineConfig.pipelineLayout = layout;
+        },
+        pipelineBuilder);
 
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
-    pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-    if (vkCreatePipelineLayout(cvkDevice.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create Pipeline Layout!");
+    // Pre-pass first on purpose, CvkRenderQueue sorts by pipeline id so the pre-pass draws end up in front.
+    // Without a builder this does nothing and selectPipelines() builds the specialized variants right away.
+    for (const auto *constants : {&genericConstants, &specializedConstants}) {
+        if (depthPrepass) { depthPrepassVariants->prefetch(*constants); }
+        pipelineVariants->prefetch(*constants);
     }
+    useFallback = pipelineBuilder != nullptr;
 }
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
-    assert(pipelineLayout != nullptr && "Cannot create pipeline before Pipeline Layout!");
 
-    PipelineConfigInfo pipelineConfig{};
-    CvkPipeline::defaultPipelineConfigInfo(pipelineConfig);
+// The generic variants draw any scene, so they stand in while the specialized ones are still compiling. Main and
+// pre-pass pipelines always switch together, the EQUAL depth test needs both to come from the same shader code.
+bool SimpleRenderSystem::selectPipelines() {
+    if (useFallback && cvkPipeline == nullptr) {
+        if (depthPrepass) { depthPrepassPipeline = &depthPrepassVariants->get(genericConstants); }
+        cvkPipeline = &pipelineVariants->get(genericConstants);
+    }
+    if (specializedSelected) { return false; }
 
-    //, wdth A render pass describes the structure and format of the framebuffer objects and their attachments
-    pipelineConfig.renderPass = renderPass;
-    pipelineConfig.pipelineLayout = pipelineLayout;
-    cvkPipeline = std::make_unique<CvkPipeline>(
-        cvkDevice,
-        "shaders/simple_shader.vert.spv",
-        "shaders/simple_shader.frag.spv",
-        pipelineConfig);
+    CvkPipeline *depth = depthPrepass ? depthPrepassVariants->tryGet(specializedConstants) : nullptr;
+    CvkPipeline *main = pipelineVariants->tryGet(specializedConstants);
+    if (main == nullptr || (depthPrepass && depth == nullptr)) { return false; }
+    depthPrepassPipeline = depth;
+    cvkPipeline = main;
+    specializedSelected = true;
+    return true;
 }
 
-void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<CvkGameObject>& game_Objects) {
+// Writes the objects into this frame's object buffer, an object's slot is its position in visibleObjects.
+void SimpleRenderSystem::writeObjects(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects) {
+    ObjectData *objectData = objectBuffer.map(frameInfo.frameIndex, static_cast<uint32_t>(visibleObjects.size()));
+    for (uint32_t slot = 0; slot < visibleObjects.size(); slot++) {
+        objectData[slot] = ObjectData::fromGameObject(game_Objects[visibleObjects[slot]]);
+    }
+}
+
+void SimpleRenderSystem::bindGlobals(FrameInfo& frameInfo) {
     cvkPipeline->bind(frameInfo.commandBuffer);
 
+    frameInfo.stats.pipelineBinds++;
+    bindDescriptorSets(frameInfo);
+}
+
+// Set 0 is left alone when MasterRenderSystem already bound it, all layouts agree on it.
+void SimpleRenderSystem::bindDescriptorSets(FrameInfo& frameInfo) {
+    VkDescriptorSet descriptorSets[] = {
+        frameInfo.globalDescriptorSet,
+        objectBuffer.getDescriptorSet(frameInfo.frameIndex)};
+    const uint32_t firstSet = frameInfo.globalSetBound ? 1 : 0;
     vkCmdBindDescriptorSets(
         frameInfo.commandBuffer,
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout,
-        0,
-        1,
-        &frameInfo.globalDescriptorSet,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
         0,
         nullptr);
+    frameInfo.stats.descriptorSetBinds++;
+    frameInfo.stats.requestedBinds += 2;
+}
+
+void SimpleRenderSystem::renderGameObject(FrameInfo& frameInfo, CvkGameObject& obj, uint32_t slot) {
+    obj.model->bind(frameInfo.commandBuffer);
+    obj.model->draw(frameInfo.commandBuffer, 1, slot);
+    frameInfo.stats.vertexBufferBinds++;
+    frameInfo.stats.requestedBinds++;
+    frameInfo.stats.drawCalls++;
+}
+
+void SimpleRenderSystem::renderDepthPrepass(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects,
+uint32_t begin,
+uint32_t end) {
+    depthPrepassPipeline->bind(frameInfo.commandBuffer);
+    frameInfo.stats.pipelineBinds++;
+    bindDescriptorSets(frameInfo);
+
+    for (uint32_t slot = begin; slot < end; slot++) {
+        auto& obj = game_Objects[visibleObjects[slot]];
+        obj.model->bindPositions(frameInfo.commandBuffer);
+        obj.model->draw(frameInfo.commandBuffer, 1, slot);
+        frameInfo.stats.vertexBufferBinds++;
+        frameInfo.stats.requestedBinds++;
+        frameInfo.stats.drawCalls++;
+    }
+}
+
+void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, std::vector<CvkGameObject>& game_Objects) {
+    allObjects.clear();
+    for (uint32_t i = 0; i < game_Objects.size(); i++) {
+        if (game_Objects[i].model) { allObjects.push_back(i); }
+    }
+    renderGameObjects(frameInfo, game_Objects, allObjects);
+}
+
+void SimpleRenderSystem::renderGameObjects(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects) {
+    selectPipelines();
+    writeObjects(frameInfo, game_Objects, visibleObjects);
+    if (depthPrepass) {
+        renderDepthPrepass(frameInfo, game_Objects, visibleObjects, 0, static_cast<uint32_t>(visibleObjects.size()));
+    }
+    bindGlobals(frameInfo);
+    for (uint32_t slot = 0; slot < visibleObjects.size(); slot++) {
+        renderGameObject(frameInfo, game_Objects[visibleObjects[slot]], slot);
+    }
+}
+
+// Dynamic state is not inherited from the primary buffer, so every secondary buffer sets its own.
+static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, extent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void SimpleRenderSystem::renderGameObjectsParallel(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects,
+CvkParallelRecorder& recorder,
+const VkCommandBufferInheritanceInfo& inheritanceInfo,
+VkExtent2D extent) {
+    selectPipelines();
+    const uint32_t objectCount = static_cast<uint32_t>(visibleObjects.size());
+    // Only the mapping (and possible growth) of the buffer happens up front, the workers fill their own slots.
+    ObjectData *objectData = objectBuffer.map(frameInfo.frameIndex, objectCount);
+    chunkStats.assign(recorder.getChunkCount(objectCount), FrameStats{});
+
+    const auto &commandBuffers = recorder.record(
+        frameInfo.frameIndex,
+        inheritanceInfo,
+        objectCount,
+        [&](VkCommandBuffer commandBuffer, uint32_t chunkIndex, uint32_t begin, uint32_t end) {
+            FrameInfo chunkInfo{
+                frameInfo.frameIndex,
+                frameInfo.frameTime,
+                commandBuffer,
+                frameInfo.camera,
+                frameInfo.globalDescriptorSet};
+            setViewportAndScissor(commandBuffer, extent);
+            for (uint32_t slot = begin; slot < end; slot++) {
+                objectData[slot] = ObjectData::fromGameObject(game_Objects[visibleObjects[slot]]);
+            }
+            // Per chunk, so overdraw between chunks still gets shaded. The result stays correct though: a later
+            // chunk's pre-pass only wins where it is closer, and its EQUAL pass then paints over.
+            if (depthPrepass) {
+                renderDepthPrepass(chunkInfo, game_Objects, visibleObjects, begin, end);
+            }
+            bindGlobals(chunkInfo);
+            for (uint32_t slot = begin; slot < end; slot++) {
+                renderGameObject(chunkInfo, game_Objects[visibleObjects[slot]], slot);
+            }
+            chunkStats[chunkIndex] = chunkInfo.stats;
+        });
+
+    vkCmdExecuteCommands(frameInfo.commandBuffer, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    for (const auto &stats : chunkStats) {
+        frameInfo.stats += stats;
+    }
+}
+
+void SimpleRenderSystem::renderGameObjectsCached(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects,
+CvkCommandCache& commandCache,
+uint64_t sceneRevision,
+const VkCommandBufferInheritanceInfo& inheritanceInfo,
+VkExtent2D extent) {
+    if (selectPipelines()) { commandCache.invalidate(); }
+    cachedStats.resize(CvkSwapchain::MAX_FRAMES_IN_FLIGHT);
+    bool recorded = false;
+    VkCommandBuffer commandBuffer = commandCache.get(
+        frameInfo.frameIndex,
+        sceneRevision,
+        inheritanceInfo,
+        [&](VkCommandBuffer secondary) {
+            // The object buffer of this frame is only written here, replays keep reading what is already in it.
+            writeObjects(frameInfo, game_Objects, visibleObjects);
+
+            FrameInfo cachedInfo{
+                frameInfo.frameIndex,
+                frameInfo.frameTime,
+                secondary,
+                frameInfo.camera,
+                frameInfo.globalDescriptorSet};
+            setViewportAndScissor(secondary, extent);
+            if (depthPrepass) {
+                renderDepthPrepass(cachedInfo, game_Objects, visibleObjects, 0, static_cast<uint32_t>(visibleObjects.size()));
+            }
+            bindGlobals(cachedInfo);
+            for (uint32_t slot = 0; slot < visibleObjects.size(); slot++) {
+                renderGameObject(cachedInfo, game_Objects[visibleObjects[slot]], slot);
+            }
+            cachedStats[frameInfo.frameIndex] = cachedInfo.stats;
+        },
+        &recorded);
+
+    vkCmdExecuteCommands(frameInfo.commandBuffer, 1, &commandBuffer);
+    frameInfo.stats += cachedStats[frameInfo.frameIndex];
+    if (recorded) { frameInfo.stats.recordedCommandBuffers++; }
+}
+
+void SimpleRenderSystem::submitGameObjects(
+FrameInfo& frameInfo,
+std::vector<CvkGameObject>& game_Objects,
+const std::vector<uint32_t>& visibleObjects,
+CvkRenderQueue& renderQueue) {
+    selectPipelines();
+    writeObjects(frameInfo, game_Objects, visibleObjects);
+    const glm::mat4 &view = frameInfo.camera.getView();
+    for (uint32_t slot = 0; slot < visibleObjects.size(); slot++) {
+        auto& obj = game_Objects[visibleObjects[slot]];
+
+        CvkRenderQueue::DrawPacket packet{};
+        packet.pipeline = cvkPipeline;
+        packet.pipelineLayout = pipelineLayout;
+        packet.descriptorSets[0] = frameInfo.globalDescriptorSet;
+        packet.descriptorSets[1] = objectBuffer.getDescriptorSet(frameInfo.frameIndex);
+        packet.model = obj.model.get();
+        packet.firstInstance = slot;
+        packet.depth = (view * glm::vec4(obj.transform.translation, 1.f)).z;
+        renderQueue.submit(packet);
 
-    for (auto& obj: game_Objects) {
-        SimplePushConstantData push{};
-        push.modelMatrix = obj.transform.mat4();
-        push.normalMatrix = obj.transform.normalMatrix();
-
-        vkCmdPushConstants(
-            frameInfo.commandBuffer,
-            pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-            0,
-            sizeof(SimplePushConstantData),
-            &push);
-        obj.model->bind(frameInfo.commandBuffer);
-        obj.model->draw(frameInfo.commandBuffer);
+        if (depthPrepass) {
+            packet.pipeline = depthPrepassPipeline;
+            packet.positionsOnly = true;
+            renderQueue.submit(packet);
+        }
     }
 }
 
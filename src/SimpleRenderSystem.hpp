@@ -1,35 +1,110 @@
 #pragma once
 
 #include "CvkCamera.hpp"
+#include "CvkCommandCache.hpp"
 #include "CvkDevice.hpp"
 #include "CvkGameObject.hpp"
 #include "CvkPipeline.hpp"
 #include "CvkFrameInfo.hpp"
+#include "MasterRenderSystem.hpp"
+#include "CvkObjectBuffer.hpp"
+#include "CvkParallelRecorder.hpp"
+#include "CvkRenderQueue.hpp"
 
 // std
 #include <memory>
+#include <vector>
 
 namespace cvk {
 
 class SimpleRenderSystem {
 public:
 
-    SimpleRenderSystem(CvkDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+    // With depthPrepass every path first lays down depth with a position-only, color-less pipeline and then
+    // shades with an EQUAL depth test, so each pixel runs the fragment shader once no matter the overdraw.
+    // Without animateLayers the vertex shaders are specialized to skip the layer rotations (see CvkLayerAnimation).
+    // With a pipelineBuilder the pipelines compile in the background, the first draw waits for the generic ones
+    // and the specialized ones replace them once they are done.
+    SimpleRenderSystem(
+        CvkDevice &device,
+        const PipelineRenderTarget &renderTarget,
+        const MasterRenderSystem &masterRenderSystem,
+        bool depthPrepass = false,
+        bool animateLayers = true,
+        CvkPipelineBuilder *pipelineBuilder = nullptr);
     ~SimpleRenderSystem();
 
     SimpleRenderSystem(const SimpleRenderSystem &) = delete;
     SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
     void renderGameObjects(FrameInfo& frameInfo, std::vector<CvkGameObject> &gameObjects);
+    // Only draws the objects at the given indices, e.g. the output of CvkFrustumCuller.
+    void renderGameObjects(FrameInfo& frameInfo, std::vector<CvkGameObject> &gameObjects, const std::vector<uint32_t> &visibleObjects);
+    // Same as above, but the objects are split across the recorder's worker threads, each recording a secondary
+    // command buffer that is then executed in frameInfo.commandBuffer. The render pass has to be begun with
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void renderGameObjectsParallel(
+        FrameInfo& frameInfo,
+        std::vector<CvkGameObject> &gameObjects,
+        const std::vector<uint32_t> &visibleObjects,
+        CvkParallelRecorder &recorder,
+        const VkCommandBufferInheritanceInfo &inheritanceInfo,
+        VkExtent2D extent);
+    // Replays this frame's cached secondary command buffer, and only re-records it (and rewrites the object
+    // buffer) when sceneRevision changed since. The render pass has to be begun with
+    // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void renderGameObjectsCached(
+        FrameInfo& frameInfo,
+        std::vector<CvkGameObject> &gameObjects,
+        const std::vector<uint32_t> &visibleObjects,
+        CvkCommandCache &commandCache,
+        uint64_t sceneRevision,
+        const VkCommandBufferInheritanceInfo &inheritanceInfo,
+        VkExtent2D extent);
+    // Same as renderGameObjects, but only submits draw packets, the queue records them later in sorted order.
+    void submitGameObjects(
+        FrameInfo& frameInfo,
+        std::vector<CvkGameObject> &gameObjects,
+        const std::vector<uint32_t> &visibleObjects,
+        CvkRenderQueue &renderQueue);
+    // Picks the variants to draw with, the render functions call it before anything gets recorded. Returns true
+    // when it switched to the specialized variants: commands recorded before still bind the generic ones.
+    bool selectPipelines();
 private:
-    void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-    void createPipeline(VkRenderPass renderPass);
+    void createPipelineLayout(const MasterRenderSystem &masterRenderSystem);
+    void createPipeline(const PipelineRenderTarget &renderTarget, bool animateLayers, CvkPipelineBuilder *pipelineBuilder);
+    void writeObjects(FrameInfo& frameInfo, std::vector<CvkGameObject> &gameObjects, const std::vector<uint32_t> &visibleObjects);
+    void bindGlobals(FrameInfo& frameInfo);
+    void bindDescriptorSets(FrameInfo& frameInfo);
+    void renderGameObject(FrameInfo& frameInfo, CvkGameObject &obj, uint32_t slot);
+    // Draws slots [begin, end) of visibleObjects with depthPrepassPipeline, the object buffer must already hold them.
+    void renderDepthPrepass(
+        FrameInfo& frameInfo,
+        std::vector<CvkGameObject> &gameObjects,
+        const std::vector<uint32_t> &visibleObjects,
+        uint32_t begin,
+        uint32_t end);
 
     CvkDevice &cvkDevice;
+    CvkObjectBuffer objectBuffer;
 
     // Smart pointer simulates a pointer with automatic memory management.
     // So we are no longer responsible for calling new() or delete()
-    std::unique_ptr<CvkPipeline> cvkPipeline;
+    std::unique_ptr<CvkPipelineVariants> pipelineVariants;
+    std::unique_ptr<CvkPipelineVariants> depthPrepassVariants; // only with depthPrepass, shares pipelineLayout
+    // The variants in use, owned by the ones above.
+    CvkPipeline *cvkPipeline = nullptr;
+    CvkPipeline *depthPrepassPipeline = nullptr;
+    SpecializationConstants genericConstants;     // animates layers, correct for every scene
+    SpecializationConstants specializedConstants; // what the scene actually needs
+    bool useFallback = false;                     // draw with the generic variants until the specialized are built
+    bool specializedSelected = false;
     VkPipelineLayout pipelineLayout;
+    bool depthPrepass;
+    bool bindless; // materials come from MasterRenderSystem's bindless arrays
+
+    std::vector<uint32_t> allObjects;
+    std::vector<FrameStats> chunkStats;
+    std::vector<FrameStats> cachedStats; // what each frame's cached buffer contains, reported on replay
 };
 
 } // namespace cvk
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "UpscaleRenderSystem.hpp"
+
+// libraries
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace cvk {
+
+// Must match Push in shaders/upscale.frag
+struct UpscalePushConstants {
+    glm::vec2 uvScale;
+    glm::vec2 uvMax;
+};
+
+UpscaleRenderSystem::UpscaleRenderSystem(
+CvkDevice &device,
+const PipelineRenderTarget &renderTarget,
+const MasterRenderSystem &masterRenderSystem,
+VkDescriptorSetLayout sceneSetLayout,
+CvkPipelineBuilder *pipelineBuilder)
+: cvkDevice{device} {
+    static_assert(sizeof(UpscalePushConstants) <= MasterRenderSystem::PUSH_CONSTANT_SIZE);
+    createPipelineLayout(masterRenderSystem, sceneSetLayout);
+    createPipeline(renderTarget, pipelineBuilder);
+}
+UpscaleRenderSystem::~UpscaleRenderSystem() {
+    vkDestroyPipelineLayout(cvkDevice.device(), pipelineLayout, nullptr);
+}
+
+void UpscaleRenderSystem::createPipelineLayout(const MasterRenderSystem &masterRenderSystem, VkDescriptorSetLayout sceneSetLayout) {
+    pipelineLayout = masterRenderSystem.createPipelineLayout({sceneSetLayout});
+}
+void UpscaleRenderSystem::createPipeline(const PipelineRenderTarget &renderTarget, CvkPipelineBuilder *pipelineBuilder) {
+    assert(pipelineLayout != nullptr && "Cannot create pipeline before Pipeline Layout!");
+
+    cvkPipeline = std::make_unique<CvkPipelineVariants>(
+        cvkDevice,
+        "shaders/upscale.vert",
+        "shaders/upscale.frag",
+        [renderTarget, layout = pipelineLayout](PipelineConfigInfo &pipelineConfig) {
+            CvkPipeline::fullscreenPipelineConfigInfo(pipelineConfig);
+            renderTarget.apply(pipelineConfig);
+            pipelineConfig.pipelineLayout = layout;
+        },
+        pipelineBuilder);
+    cvkPipeline->prefetch({});
+}
+
+void UpscaleRenderSystem::render(FrameInfo& frameInfo, const CvkSceneTarget &sceneTarget) {
+    cvkPipeline->get({}).bind(frameInfo.commandBuffer);
+    // Nothing here reads the global set, it only has to be there for the layout.
+    VkDescriptorSet descriptorSets[] = {
+        frameInfo.globalDescriptorSet,
+        sceneTarget.getDescriptorSet(frameInfo.frameIndex)};
+    const uint32_t firstSet = frameInfo.globalSetBound ? 1 : 0;
+    vkCmdBindDescriptorSets(
+        frameInfo.commandBuffer,
+        VK_PIPELINE_BIND_POINT_GRAPHICS,
+        pipelineLayout,
+        firstSet,
+        2 - firstSet,
+        descriptorSets + firstSet,
+        0,
+        nullptr);
+
+    const VkExtent2D renderExtent = sceneTarget.getRenderExtent();
+    const VkExtent2D imageExtent = sceneTarget.getImageExtent();
+    const glm::vec2 renderSize{static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height)};
+    const glm::vec2 imageSize{static_cast<float>(imageExtent.width), static_cast<float>(imageExtent.height)};
+    UpscalePushConstants push{};
+    push.uvScale = renderSize / imageSize;
+    push.uvMax = (renderSize - .5f) / imageSize;
+    vkCmdPushConstants(
+        frameInfo.commandBuffer,
+        pipelineLayout,
+        MasterRenderSystem::PUSH_CONSTANT_STAGES,
+        0,
+        sizeof(UpscalePushConstants),
+        &push);
+    vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+    frameInfo.stats.drawCalls++;
+}
+
+} // namespace cvk
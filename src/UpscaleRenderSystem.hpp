@@ -0,0 +1,41 @@
+#pragma once
+
+#include "CvkDevice.hpp"
+#include "CvkFrameInfo.hpp"
+#include "CvkPipeline.hpp"
+#include "CvkSceneTarget.hpp"
+#include "MasterRenderSystem.hpp"
+
+// std
+#include <memory>
+
+namespace cvk {
+
+// Draws the scene target's rendered part stretched over the whole swapchain image with one fullscreen triangle.
+// Goes into the swapchain render pass, after the scene target's pass has ended. The scene image is set 1.
+class UpscaleRenderSystem {
+public:
+
+    UpscaleRenderSystem(
+        CvkDevice &device,
+        const PipelineRenderTarget &renderTarget,
+        const MasterRenderSystem &masterRenderSystem,
+        VkDescriptorSetLayout sceneSetLayout,
+        CvkPipelineBuilder *pipelineBuilder = nullptr);
+    ~UpscaleRenderSystem();
+
+    UpscaleRenderSystem(const UpscaleRenderSystem &) = delete;
+    UpscaleRenderSystem &operator=(const UpscaleRenderSystem &) = delete;
+
+    void render(FrameInfo& frameInfo, const CvkSceneTarget &sceneTarget);
+private:
+    void createPipelineLayout(const MasterRenderSystem &masterRenderSystem, VkDescriptorSetLayout sceneSetLayout);
+    void createPipeline(const PipelineRenderTarget &renderTarget, CvkPipelineBuilder *pipelineBuilder);
+
+    CvkDevice &cvkDevice;
+
+    std::unique_ptr<CvkPipelineVariants> cvkPipeline; // one variant without constants, see IndirectRenderSystem
+    VkPipelineLayout pipelineLayout;
+};
+
+} // namespace cvk
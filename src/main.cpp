@@ -1,11 +1,135 @@
 #include "MainApp.hpp"
 
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
-int main() {
-    cvk::MainApp app{};
+static VkPresentModeKHR parsePresentMode(const char *name) {
+    if (strcmp(name, "fifo") == 0) { return VK_PRESENT_MODE_FIFO_KHR; }
+    if (strcmp(name, "fifo-relaxed") == 0) { return VK_PRESENT_MODE_FIFO_RELAXED_KHR; }
+    if (strcmp(name, "mailbox") == 0) { return VK_PRESENT_MODE_MAILBOX_KHR; }
+    if (strcmp(name, "immediate") == 0) { return VK_PRESENT_MODE_IMMEDIATE_KHR; }
+    std::cerr << "Unknown present mode: " << name << ", using mailbox\n";
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+}
+
+// Unlike std::stoul this names the option on bad input, and doesn't take "12abc" as 12 or "-1" as 4294967295.
+static uint32_t parseUnsigned(const char *option, const char *value) {
+    char *end;
+    errno = 0;
+    const unsigned long number = std::strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || number > UINT32_MAX || strchr(value, '-') != nullptr) {
+        throw std::invalid_argument(std::string{"Invalid value for "} + option + ": " + value);
+    }
+    return static_cast<uint32_t>(number);
+}
+
+// For times, rates and scales: nan, inf, 0 and negative values all make no sense and would trip asserts later.
+static double parsePositive(const char *option, const char *value) {
+    char *end;
+    const double number = std::strtod(value, &end);
+    if (end == value || *end != '\0' || !std::isfinite(number) || number <= 0.0) {
+        throw std::invalid_argument(std::string{"Invalid value for "} + option + ": " + value + ", needs a positive number");
+    }
+    return number;
+}
+
+// Throws std::invalid_argument if an option's value is out of range.
+static cvk::AppSettings parseArguments(int argc, char **argv) {
+    cvk::AppSettings settings{};
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        if (strcmp(argv[i], "--indirect") == 0) {
+            settings.indirectDraw = true;
+        } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+            settings.indirectDraw = true;
+            settings.gpuCulling = true;
+        } else if (strcmp(argv[i], "--hiz") == 0) {
+            settings.indirectDraw = true;
+            settings.gpuCulling = true;
+            settings.occlusionCulling = true;
+        } else if (strcmp(argv[i], "--no-cull") == 0) {
+            settings.cpuCulling = false;
+        } else if (strcmp(argv[i], "--no-queue") == 0) {
+            settings.renderQueue = false;
+        } else if (strcmp(argv[i], "--parallel") == 0) {
+            settings.parallelRecording = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.parallelRecording = true;
+            settings.workerThreads = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            settings.cacheCommands = true;
+        } else if (strcmp(argv[i], "--on-demand") == 0) {
+            settings.onDemand = true;
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            settings.depthPrepass = true;
+        } else if (strcmp(argv[i], "--dynamic-res") == 0) {
+            settings.dynamicResolution = true;
+        } else if (strcmp(argv[i], "--res-scale") == 0 && i + 2 < argc) {
+            settings.dynamicResolution = true;
+            settings.minRenderScale = static_cast<float>(parsePositive(option, argv[++i]));
+            settings.maxRenderScale = static_cast<float>(parsePositive(option, argv[++i]));
+        } else if (strcmp(argv[i], "--gpu-target") == 0 && i + 1 < argc) {
+            settings.dynamicResolution = true;
+            settings.gpuTargetMilliseconds = parsePositive(option, argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            settings.printStats = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            settings.benchmarkFrames = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc) {
+            settings.stressObjectCount = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--overlap") == 0 && i + 1 < argc) {
+            settings.overlapLayers = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--puzzle") == 0 && i + 1 < argc) {
+            settings.puzzleSize = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            settings.headless = true;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            settings.captureFile = argv[++i];
+        } else if (strcmp(argv[i], "--bindless") == 0) {
+            settings.bindless = true;
+        } else if (strcmp(argv[i], "--dynamic-rendering") == 0) {
+            settings.dynamicRendering = true;
+        } else if (strcmp(argv[i], "--pipeline-library") == 0) {
+            settings.pipelineLibrary = true;
+        } else if (strcmp(argv[i], "--pipeline-threads") == 0 && i + 1 < argc) {
+            settings.pipelineThreads = parseUnsigned(option, argv[++i]);
+        } else if (strcmp(argv[i], "--hot-reload") == 0) {
+            settings.hotReload = true;
+        } else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+            settings.presentMode = parsePresentMode(argv[++i]);
+        } else if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc) {
+            settings.fpsLimit = parsePositive(option, argv[++i]);
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            settings.framesInFlight = parseUnsigned(option, argv[++i]);
+            if (settings.framesInFlight < 1 || settings.framesInFlight > cvk::CvkSwapchain::MAX_FRAMES_IN_FLIGHT) {
+                throw std::invalid_argument(
+                    std::string{"Invalid value for "} + option + ": " + argv[i] + ", needs 1 to " +
+                    std::to_string(cvk::CvkSwapchain::MAX_FRAMES_IN_FLIGHT));
+            }
+        } else if (strcmp(argv[i], "--benchmark-fif") == 0) {
+            settings.benchmarkFramesInFlight = true;
+        } else {
+            std::cerr << "Unknown argument: " << argv[i] << "\n";
+        }
+    }
+    return settings;
+}
+
+int main(int argc, char **argv) {
+    cvk::AppSettings settings{};
+    try {
+        settings = parseArguments(argc, argv);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    cvk::MainApp app{settings};
     try {
         app.run();
     } catch (const std::exception &e) {